@@ -34,6 +34,8 @@
 
 // Local
 #include "surfel.hpp"
+#include "surfel_store.h"
+#include "ply_writer.h"
 
 class MyVertex;
 
@@ -85,6 +87,9 @@ public:
 
   typedef typename MyMesh::VertexIterator VertexIterator;
 
+  /// Surfels converted to arrays and written at a time when saving.
+  static const size_t save_block_size = 1 << 20;
+
   IOSurfels()
   {
 
@@ -94,37 +99,23 @@ public:
   static int SaveMesh (const char * filename,
 		       std::vector<Surfel<Real> >& pSurfel,vcg::CallBackPos *cb = 0)
   {
-    MyMesh mesh;
-    VertexIterator vi = vcg::tri::Allocator<MyMesh>::AddVertices(mesh,pSurfel.size());
-    int mask = 0;
-    vcg::tri::io::PlyInfo info;
-    bool binary = 0;
-    for (size_t i = 0; i < pSurfel.size();++i)
-      {
-
-	(*vi).P()[0] = pSurfel[i].Center().x;
-	(*vi).P()[1] = pSurfel[i].Center().y;
-	(*vi).P()[2] = pSurfel[i].Center().z;
-
-	(*vi).N()[0] = pSurfel[i].Normal().x;
-	(*vi).N()[1] = pSurfel[i].Normal().y;
-	(*vi).N()[2] = pSurfel[i].Normal().z;
-
-	(*vi).R()	 = pSurfel[i].MajorAxis().first;
-
+    // positions, normals and major axis sizes as radii, converted and written in blocks
+    PlyWriter writer;
+    const int attributes = SurfelStore::NORMAL | SurfelStore::RADIUS;
+    if (!writer.open(filename, pSurfel.size(), attributes, false))
+      return ::vcg::ply::E_CANTOPEN;
 
-	++vi;
+    SurfelStore block;
+    for (size_t first = 0; first < pSurfel.size(); first += save_block_size)
+      {
+	block.fromSurfels(pSurfel, attributes, first, save_block_size);
+	for (size_t i = 0; i < block.size(); ++i)
+	  block.radius[i] = pSurfel[first + i].MajorAxis().first;
+	if (!writer.write(block))
+	  return ::vcg::ply::E_CANTOPEN;
       }
 
-    mask |= vcg::tri::io::Mask::IOM_VERTNORMAL;
-    mask |= vcg::tri::io::Mask::IOM_VERTRADIUS;
-
-    info.mask = mask;
-
-    int result = vcg::tri::io::ExporterPLY<MyMesh>::Save(mesh,filename,binary,info,cb);
-
-    return result;
-
+    return writer.close() ? 0 : ::vcg::ply::E_CANTOPEN;
   }
   static int LoadMesh (
 		       const char * filename,
@@ -294,120 +285,22 @@ public:
 
   static int SaveSurfels(std::vector<Surfel<Real> >& pSurfel,  const char * filename,vcg::CallBackPos *cb = 0, bool binary=0)	// V1.0
   {
-    FILE * fpout;
-
-    const char * hbin = "binary_little_endian";
-    const char * hasc = "ascii";
-    const char * h;
-
-
-    if(binary) h=hbin;
-    else       h=hasc;
-
-    fpout = fopen(filename,"wb");
-    if(fpout==NULL)	{
+    // same "surfel" element layout as before, converted and written in blocks
+    PlyWriter writer;
+    const int attributes = SurfelStore::NORMAL | SurfelStore::COLOR | SurfelStore::RADIUS |
+      SurfelStore::AXES | SurfelStore::ERRORS;
+    if (!writer.open(filename, pSurfel.size(), attributes, binary))
       return ::vcg::ply::E_CANTOPEN;
-    }
-    fprintf(fpout,
-	    "ply\n"
-	    "format %s 1.0\n"
-	    "comment LSplat - VCGLIB generated\n"
-	    ,h
-	    );
-
-    fprintf(fpout,
-	    "element surfel %d\n"
-	    "property float cx\n"
-	    "property float cy\n"
-	    "property float cz\n"
-	    "property float nx\n"
-	    "property float ny\n"
-	    "property float nz\n"
-	    "property float major_axisx\n"
-	    "property float major_axisy\n"
-	    "property float major_axisz\n"
-	    "property float major_axis_size\n"
-	    "property float minor_axisx\n"
-	    "property float minor_axisy\n"
-	    "property float minor_axisz\n"
-	    "property float minor_axis_size\n"
-	    "property float r\n"
-	    "property float g\n"
-	    "property float b\n"
-	    "property float max_error\n"
-	    "property float min_error\n"
-	    ,pSurfel.size()
-	    );
-
-
-    fprintf(fpout, "end_header\n"	);
-
-    typename Surfel<Real>::LoadPlySurfel v;
-
-    if(binary)
-      {
-
-	float t[19];
-
-	for(std::size_t i = 0; i < pSurfel.size(); ++i)
-	  {
 
-	    t[ 0] = pSurfel[i].Center().x;
-	    t[ 1] = pSurfel[i].Center().y;
-	    t[ 2] = pSurfel[i].Center().z;
-	    t[ 3] = pSurfel[i].Normal().x;
-	    t[ 4] = pSurfel[i].Normal().y;
-	    t[ 5] = pSurfel[i].Normal().z;
-	    t[ 6] = pSurfel[i].MajorAxis().second.x;
-	    t[ 7] = pSurfel[i].MajorAxis().second.y;
-	    t[ 8] = pSurfel[i].MajorAxis().second.z;
-	    t[ 9] = pSurfel[i].MajorAxis().first;
-	    t[10] = pSurfel[i].MinorAxis().second.x;
-	    t[11] = pSurfel[i].MinorAxis().second.y;
-	    t[12] = pSurfel[i].MinorAxis().second.z;
-	    t[13] = pSurfel[i].MinorAxis().first;
-	    t[14] = pSurfel[i].Color()[0];
-	    t[15] = pSurfel[i].Color()[1];
-	    t[16] = pSurfel[i].Color()[2];
-	    t[17] = pSurfel[i].MaxError();
-	    t[18] = pSurfel[i].MinError();
-	    fwrite(t,sizeof(float),19,fpout);
-
-	  }
-      }
-    else
+    SurfelStore block;
+    for (size_t first = 0; first < pSurfel.size(); first += save_block_size)
       {
-
-	for(std::size_t i = 0; i < pSurfel.size(); ++i)
-	  {
-	    std::cout << pSurfel[i] << std::endl;
-	    std::cout << v.cx << std::endl;
-	    fprintf(fpout,"%g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g \n",
-		    pSurfel[i].Center().x,
-		    pSurfel[i].Center().y,
-		    pSurfel[i].Center().z,
-		    pSurfel[i].Normal().x,
-		    pSurfel[i].Normal().y,
-		    pSurfel[i].Normal().z,
-		    pSurfel[i].MajorAxis().second.x,
-		    pSurfel[i].MajorAxis().second.y,
-		    pSurfel[i].MajorAxis().second.z,
-		    pSurfel[i].MajorAxis().first,
-		    pSurfel[i].MinorAxis().second.x,
-		    pSurfel[i].MinorAxis().second.y,
-		    pSurfel[i].MinorAxis().second.z,
-		    pSurfel[i].MinorAxis().first,
-		    pSurfel[i].Color()[0],
-		    pSurfel[i].Color()[1],
-		    pSurfel[i].Color()[2],
-		    pSurfel[i].MaxError(),
-		    pSurfel[i].MinError()
-		    );
-	  }
+	block.fromSurfels(pSurfel, attributes, first, save_block_size);
+	if (!writer.write(block))
+	  return ::vcg::ply::E_CANTOPEN;
       }
 
-    fclose(fpout);
-    return 0;
+    return writer.close() ? 0 : ::vcg::ply::E_CANTOPEN;
   }
 
   template <class OpenMeshType>
@@ -38,10 +38,51 @@ Application::Application( GLint default_mode, int w, int h ) {
 
   fps_loop = 0;
 
+  partial_frames = 0;
+  partial_area = 0.0;
+
   rotating = 0;
   show_points = false;
   selected = 0;
 
+  preprocessing = false;
+  quantization = false;
+  quantization_tolerance = 1.0e-6f;
+
+  occlusion_culling = false;
+  adaptive_levels = false;
+
+  software_projection = false;
+  overdraw_mode = PointBasedRenderer::OVERDRAW_OFF;
+  overdraw_counters = false;
+
+  gpu_mask = 1;
+
+  stereo = PointBasedRenderer::STEREO_OFF;
+  stereo_gap = 0;
+
+  glGenQueries(4, &frame_queries[0][0]);
+  frame_query_pending[0] = frame_query_pending[1] = false;
+  frame_query_slot = 0;
+  frame_time = 0.0;
+
+  frame_budget = 0.0;
+  budget_time = 0.0;
+  sample_fraction = 1.0f;
+  refined_fraction = 0.0f;
+  radius_scale = 1.0f;
+  memset(last_camera, 0, sizeof(last_camera));
+  last_selected = 0;
+
+  partial_updates = false;
+  full_frame = true;
+  memset(region_state, 0, sizeof(region_state));
+  region_frame = false;
+
+  readback = false;
+  readback_callback = NULL;
+  readback_data = NULL;
+
   for (int i = 0; i < 8; ++i) {
     glActiveTexture(GL_TEXTURE0 + i);
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -59,6 +100,9 @@ Application::Application( GLint default_mode, int w, int h ) {
 }
 
 Application::~Application( void ) {
+  glDeleteQueries(4, &frame_queries[0][0]);
+  for (unsigned int i = 0; i < objects.size(); ++i)
+    delete objects[i];
   objects.clear();
   delete point_based_render;
 }
@@ -70,20 +114,35 @@ void Application::drawPoints(void) {
 
   glBegin(GL_POINTS);
   
-  for (surfelVectorIter it = objects[0].getSurfels()->begin(); it != objects[0].getSurfels()->end(); ++it) {
-    Color4b c = it->Color();
-    glColor4f(c[0], c[1], c[2], 1.0f);
-    Point3f p = it->Center();
-    glVertex3f(p[0], p[1], p[2]);
+  const SurfelStore *store = objects[0]->getStore();
+  for (size_t i = 0; i < store->size(); ++i) {
+    glColor4f(store->color[4*i], store->color[4*i+1], store->color[4*i+2], 1.0f);
+    glVertex3fv(&store->position[3*i]);
   }
   glEnd();
 }
 
 void Application::setView( void )
+{
+  setView(0, 0, windows_width, windows_height, windows_width, windows_height);
+}
+
+/**
+ * Sets the camera for a sub-window of a larger virtual viewport.
+ * The frustum is cropped so that the sub-window shows exactly the
+ * pixels [x, x+w) x [y, y+h) of a full_w x full_h image.
+ * @param x Left pixel of the sub-window in the full image.
+ * @param y Bottom pixel of the sub-window in the full image.
+ * @param w Sub-window width.
+ * @param h Sub-window height.
+ * @param full_w Full image width.
+ * @param full_h Full image height.
+ **/
+void Application::setView( int x, int y, int w, int h, int full_w, int full_h )
 {
 
-  glViewport(0, 0, windows_width, windows_height);
-  GLfloat fAspect = (GLfloat)windows_width/ (GLfloat)windows_height;
+  glViewport(0, 0, w, h);
+  GLfloat fAspect = (GLfloat)full_w/ (GLfloat)full_h;
   glMatrixMode(GL_PROJECTION);
   glLoadIdentity();
   // Si deve mettere la camera ad una distanza che inquadri la sfera unitaria bene.
@@ -96,10 +155,21 @@ void Application::setView( void )
 
   if(nearPlane<=objDist*.1f) nearPlane=objDist*.1f;
 
+  // crop window in normalized [-1, 1] coordinates of the full image
+  float left = -1.0f + 2.0f*x/(float)full_w;
+  float right = -1.0f + 2.0f*(x+w)/(float)full_w;
+  float bottom = -1.0f + 2.0f*y/(float)full_h;
+  float top = -1.0f + 2.0f*(y+h)/(float)full_h;
+
   if(fov==5)
-    glOrtho(-ratio*fAspect,ratio*fAspect,-ratio,ratio,objDist - 2.f*clipRatioNear, objDist+2.f*clipRatioFar);
-  else    		
-    gluPerspective(fov, fAspect, nearPlane, farPlane);
+    glOrtho(ratio*fAspect*left, ratio*fAspect*right, ratio*bottom, ratio*top,
+	    objDist - 2.f*clipRatioNear, objDist+2.f*clipRatioFar);
+  else {
+    // same frustum as gluPerspective(fov, fAspect, nearPlane, farPlane) when not cropped
+    float half_h = nearPlane * tanf(vcg::math::ToRad(fov*.5f));
+    float half_w = half_h * fAspect;
+    glFrustum(half_w*left, half_w*right, half_h*bottom, half_h*top, nearPlane, farPlane);
+  }
 
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
@@ -110,7 +180,8 @@ void Application::setView( void )
   // near plane, but since the viewport transformation already scales
   // accordingly, there is no need to multiple by N
   // Not 100% sure about this, but it is working better with scaling by N
-  scale_factor = 1.0 / (tanf(vcg::math::ToRad(fov*.5f)) * 2.0);
+  // Radii are relative to the canvas height, so a cropped window scales them up.
+  scale_factor = 1.0 / (tanf(vcg::math::ToRad(fov*.5f)) * 2.0) * (full_h / (float)h);
 }
 
 /** 
@@ -127,27 +198,427 @@ void Application::draw( void ) {
   if (objects.size() == 0)
     return;  
 
+  readFrameTimer();
+  bool timed = !frame_query_pending[frame_query_slot];
+  if (timed)
+    glQueryCounter(frame_queries[frame_query_slot][0], GL_TIMESTAMP);
+
+  if (frame_budget > 0.0)
+    updateSampleRange();
+
+  updateRegion();
+
   // Clear all buffers including pyramid algorithm buffers
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   point_based_render->clearBuffers();
 
-  // initializes matrices, perspective and look at
-  setView();
+  if (stereo == PointBasedRenderer::STEREO_OFF) {
+    // initializes matrices, perspective and look at
+    setView();
+
+    renderView();
+  }
+  else
+    renderStereo();
+
+  if (timed) {
+    glQueryCounter(frame_queries[frame_query_slot][1], GL_TIMESTAMP);
+    frame_query_pending[frame_query_slot] = true;
+  }
+
+  if (frame == 10) {
+    frame = 0;
+    int endtime = glutGet(GLUT_ELAPSED_TIME);
+    double analysis, synthesis;
+    point_based_render->getPyramidTimes(analysis, synthesis);
+    cout << "FPS : " << 10*1000.0/(endtime-time) << "  (gpu " << frame_time << " ms, analysis " << analysis
+	 << " ms, synthesis " << synthesis << " ms, kernel " << point_based_render->getKernelSize();
+    if (frame_budget > 0.0)
+      cout << ", " << 100.0 * sample_fraction << "% per frame, " << 100.0 * refined_fraction << "% refined";
+    double points, fragments;
+    point_based_render->getOverdraw(points, fragments);
+    if (points > 0.0)
+      cout << ", " << points / 1.0e6 << " Mpoints projected, " << fragments / points << " fragments written per point";
+    if (partial_frames > 0)
+      cout << ", " << partial_frames << " partial frames covering " << 100.0 * partial_area / partial_frames << "% of the canvas";
+    partial_frames = 0;
+    partial_area = 0.0;
+    if (stereo == PointBasedRenderer::STEREO_SHARED)
+      cout << ", stereo shared pyramid";
+    else if (stereo == PointBasedRenderer::STEREO_TWO_PASS)
+      cout << ", stereo two passes, pyramid times per eye";
+    cout << ")" << endl; 
+  }
+
+  /// uncomment this to flush frames every time, so you can better compute the true time to compute one frame,
+  /// but of course, this will slow down a little the rendering since the graphics board must wait for everything
+  /// to finish before continuing with the next frame
+  //glFinish();
+}
+
+/**
+ * Renders the objects with the projection already set by setView.
+ * Applies light and trackball transformations, then runs projection,
+ * interpolation and shading of the point based renderer.
+ **/
+void Application::renderView( void ) {
+
+  // Apply trackball transformation
+  glPushMatrix();
+
+  projectView();
+
+  // Interpolates projected surfels using pyramid algorithm (pull-push)
+  point_based_render->interpolate();
+
+  // Computes per pixel color with deferred shading
+  point_based_render->draw();
+
+  if (show_points)
+    drawPoints();
+
+  glPopMatrix();
+}
+
+/**
+ * Sets the light, applies the trackball transformation to the current
+ * modelview and projects the objects into the pyramid.
+ **/
+void Application::projectView( void ) {
 
   /** Set light direction **/
   glPushMatrix();
   trackball_light.GetView();
   trackball_light.Apply();
-  glEnable (GL_LIGHTING);
-  glEnable (GL_LIGHT0);
-  static float lightPosF[]={0.0, 0.0, 1.0, 0.0};
-  glLightfv(GL_LIGHT0, GL_POSITION, lightPosF);
+  Matrix44f light;
+  glGetv(GL_MODELVIEW_MATRIX, light);
   glPopMatrix();
+  // direction (0, 0, 1) rotated by the light trackball, in eye space
+  Point3f light_direction (light.ElementAt(0, 2), light.ElementAt(1, 2), light.ElementAt(2, 2));
+  point_based_render->setLightDirection( light_direction.Normalize() );
   /** ******************** **/
 
-  // Apply trackball transformation
+  applyModelTransform();
+
+  /// Get eye position rotated in inverse direction for backface culling
+  Matrix44f model;
+  glGetv(GL_MODELVIEW_MATRIX,model);
+  Invert(model);
+  vcg::Point3f vp = model* Point3f(0., 0., 0.);
+ 
+  // Set eye for back face culling in vertex shader of projection phase
+  point_based_render->setEye( Point3f(vp[0], vp[1], vp[2]) );
+
+  // the renderer takes its camera from here, not from the matrix stacks
+  GLdouble modelview[16], projection[16];
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+  glGetDoublev(GL_PROJECTION_MATRIX, projection);
+  point_based_render->setCamera( modelview, projection );
+
+  // Set factor for scaling projected radii of samples in projection phase,
+  // enlarged when only part of the surfels is projected
+  point_based_render->setScaleFactor( scale_factor * radius_scale );
+
+  // project all objects, in partial frames those reaching into the region
+  if (selected == 0) {
+    for (unsigned int i = 0; i < objects.size(); ++i)
+      if (inRegion(i))
+	point_based_render->projectSamples( objects[i] );
+  }
+  // project only selected part
+  else if (inRegion(selected-1))
+    point_based_render->projectSamples( objects[selected-1] );
+}
+
+/**
+ * Sets the off-axis camera of one eye, with parallel view directions
+ * converging at the model center. The viewport is set by the renderer.
+ * @param eye 0 for the left eye, 1 for the right eye.
+ **/
+void Application::setStereoView( int eye )
+{
+  int eye_width = (canvas_width - stereo_gap) / 2;
+  GLfloat fAspect = (GLfloat)eye_width / (GLfloat)canvas_height;
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+
+  float ratio = 1.75f;
+  float objDist = ratio / tanf(vcg::math::ToRad(fov*.5f));
+  
+  float nearPlane = objDist - 2.f*clipRatioNear;
+  float farPlane =  objDist + 10.f*clipRatioFar;
+
+  if(nearPlane<=objDist*.1f) nearPlane=objDist*.1f;
+
+  // eyes one thirtieth of the viewing distance apart
+  float shift = (eye == 0 ? -0.5f : 0.5f) * objDist / 30.0f;
+
+  if(fov==5)
+    glOrtho(-ratio*fAspect, ratio*fAspect, -ratio, ratio,
+	    objDist - 2.f*clipRatioNear, objDist+2.f*clipRatioFar);
+  else {
+    float half_h = nearPlane * tanf(vcg::math::ToRad(fov*.5f));
+    float half_w = half_h * fAspect;
+    float offset = shift * nearPlane / objDist;
+    glFrustum(-half_w - offset, half_w - offset, -half_h, half_h, nearPlane, farPlane);
+  }
+
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  gluLookAt(shift, 0, objDist, shift, 0, 0, 0, 1, 0);
+
+  scale_factor = 1.0 / (tanf(vcg::math::ToRad(fov*.5f)) * 2.0);
+}
+
+/**
+ * Renders both eyes side by side. In shared mode both eyes are projected
+ * first and the pyramid is reconstructed and shaded once for the two;
+ * in two pass mode every eye is reconstructed and shaded on its own.
+ **/
+void Application::renderStereo( void ) {
+
+  for (int eye = 0; eye < 2; ++eye) {
+    point_based_render->beginEye(eye);
+    setStereoView(eye);
+
+    glPushMatrix();
+    projectView();
+    glPopMatrix();
+
+    if (stereo == PointBasedRenderer::STEREO_TWO_PASS) {
+      point_based_render->interpolate();
+      point_based_render->draw();
+    }
+  }
+
+  if (stereo == PointBasedRenderer::STEREO_SHARED) {
+    point_based_render->interpolate();
+    point_based_render->draw();
+  }
+}
+
+/**
+ * Chooses the surfels projected in this frame for the frame budget.
+ * While the camera moves, the fraction of every cluster that fits the
+ * budget is projected, with radii enlarged by 1/sqrt(fraction) to keep
+ * the surface closed. Once the camera stops, every frame adds the next
+ * range of all clusters to the accumulated samples, until the whole
+ * model has been projected. Earlier ranges keep the larger radii they
+ * were projected with.
+ **/
+void Application::updateSampleRange( void ) {
+
+  // scale the fraction by the measured GPU time, damped since part of the time is fixed
+  if (frame_time > 0.0 && frame_time != budget_time) {
+    budget_time = frame_time;
+    sample_fraction = min(1.0, max(0.01, sample_fraction * sqrt(frame_budget / frame_time)));
+  }
+
+  GLdouble camera[32];
+  readCamera(camera);
+
+  // samples from different eyes cannot be accumulated
+  if (stereo != PointBasedRenderer::STEREO_OFF || selected != last_selected ||
+      memcmp(camera, last_camera, sizeof(camera)) != 0)
+    refined_fraction = 0.0f;
+  memcpy(last_camera, camera, sizeof(camera));
+  last_selected = selected;
+
+  float begin = refined_fraction;
+  float end = min(1.0f, begin + sample_fraction);
+  point_based_render->setKeepSamples( begin > 0.0f );
+  point_based_render->setSampleRange( begin, end );
+  radius_scale = 1.0f / sqrtf(end);
+  refined_fraction = end;
+}
+
+/**
+ * Reads the camera of this frame, as applied by setView and renderView.
+ * @param camera Modelview matrix followed by the projection matrix.
+ **/
+void Application::readCamera( GLdouble camera[32] ) {
+  setView();
+  glGetDoublev(GL_PROJECTION_MATRIX, camera + 16);
   glPushMatrix();
+  applyModelTransform();
+  glGetDoublev(GL_MODELVIEW_MATRIX, camera);
+  glPopMatrix();
+}
+
+/**
+ * Chooses the part of the canvas redone in this frame. While camera and
+ * light stand still, only the screen rectangles of the objects shown,
+ * hidden or changed since the last frame are redone, grown by the
+ * support radius so that the surface reconstructed around them is
+ * complete; every object reaching into the region is projected again.
+ * The renderer decides if the frame can be partial at all.
+ **/
+void Application::updateRegion( void ) {
+
+  region_frame = false;
+  if (!partial_updates)
+    return;
+
+  // camera and light of this frame, as applied by renderView and projectView
+  GLdouble state[48];
+  readCamera(state);
+  glPushMatrix();
+  trackball_light.GetView();
+  trackball_light.Apply();
+  glGetDoublev(GL_MODELVIEW_MATRIX, state + 32);
+  glPopMatrix();
+
+  bool whole = full_frame || object_shown.size() > objects.size() ||
+    memcmp(state, region_state, sizeof(state)) != 0;
+  memcpy(region_state, state, sizeof(state));
+  full_frame = false;
+
+  // objects added since the last frame were not shown
+  object_rects.resize(4 * objects.size(), 0);
+  object_shown.resize(objects.size(), 0);
+  object_changed.resize(objects.size(), 1);
+
+  int region[4] = {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+  for (unsigned int i = 0; i < objects.size(); ++i) {
+    bool shown = selected == 0 || selected - 1 == (int)i;
+    int rect[4];
+    if (shown)
+      screenRect(*objects[i], state, rect);
+    if (shown != (bool)object_shown[i] || object_changed[i]) {
+      for (int k = 0; k < 2; ++k) {
+	const int *r = k == 0 ? &object_rects[4*i] : rect;
+	if (k == 0 ? !object_shown[i] : !shown)
+	  continue;
+	region[0] = min(region[0], r[0]);
+	region[1] = min(region[1], r[1]);
+	region[2] = max(region[2], r[2]);
+	region[3] = max(region[3], r[3]);
+      }
+    }
+    object_shown[i] = shown;
+    object_changed[i] = 0;
+    if (shown)
+      for (int k = 0; k < 4; ++k)
+	object_rects[4*i + k] = rect[k];
+  }
+
+  if (whole) {
+    point_based_render->setUpdateRegion( NULL );
+    return;
+  }
+
+  // nothing changed: an empty region keeps the whole last frame
+  if (region[0] > region[2])
+    region[0] = region[1] = region[2] = region[3] = 0;
+  else {
+    // plus the gather kernel footprint, as the tile overlap of renderTiled
+    int support = supportRadius(state, windows_height) + 4;
+    region[0] -= support;
+    region[1] -= support;
+    region[2] += support;
+    region[3] += support;
+  }
+
+  update_region[0] = region[0];
+  update_region[1] = region[1];
+  update_region[2] = region[2] - region[0];
+  update_region[3] = region[3] - region[1];
+  region_frame = point_based_render->setUpdateRegion( update_region );
+
+  if (region_frame) {
+    int w = min(region[2], windows_width) - max(region[0], 0);
+    int h = min(region[3], windows_height) - max(region[1], 0);
+    ++partial_frames;
+    if (w > 0 && h > 0)
+      partial_area += (double)w * h / ((double)windows_width * windows_height);
+  }
+}
+
+/**
+ * Screen rectangle of the splats of an object, from the corners of its
+ * bounding box grown by its largest radius.
+ * @param object Object.
+ * @param camera Modelview and projection matrices, as read by readCamera.
+ * @param rect x0, y0, x1, y1 in pixels, the whole window if the box reaches behind the eye.
+ **/
+void Application::screenRect( const Object &object, const GLdouble camera[32], int rect[4] ) const {
+
+  rect[0] = rect[1] = 0;
+  rect[2] = windows_width;
+  rect[3] = windows_height;
+
+  const SurfelBounds &bounds = object.getBounds();
+  if (bounds.empty())
+    return;
+
+  float corners[8][3];
+  bounds.corners(bounds.max_radius, corners);
+
+  const GLdouble *modelview = camera, *projection = camera + 16;
+  double x0 = DBL_MAX, y0 = DBL_MAX, x1 = -DBL_MAX, y1 = -DBL_MAX;
+  for (int i = 0; i < 8; ++i) {
+    double eye[4], clip[4];
+    for (int r = 0; r < 4; ++r)
+      eye[r] = modelview[r]*corners[i][0] + modelview[4 + r]*corners[i][1] +
+	modelview[8 + r]*corners[i][2] + modelview[12 + r];
+    for (int r = 0; r < 4; ++r)
+      clip[r] = projection[r]*eye[0] + projection[4 + r]*eye[1] +
+	projection[8 + r]*eye[2] + projection[12 + r]*eye[3];
+    if (clip[3] <= 0.0)
+      return;
+    double x = (0.5 * clip[0] / clip[3] + 0.5) * windows_width;
+    double y = (0.5 * clip[1] / clip[3] + 0.5) * windows_height;
+    x0 = min(x0, x); x1 = max(x1, x);
+    y0 = min(y0, y); y1 = max(y1, y);
+  }
+
+  rect[0] = (int)floor(max(x0, -1.0));
+  rect[1] = (int)floor(max(y0, -1.0));
+  rect[2] = (int)ceil(min(x1, windows_width + 1.0));
+  rect[3] = (int)ceil(min(y1, windows_height + 1.0));
+}
+
+/**
+ * Tests if an object reaches into the region of a partial frame.
+ * Every object is in the region of a whole frame.
+ * @param i Object index.
+ **/
+bool Application::inRegion( int i ) const {
+  if (!region_frame)
+    return true;
+  const int *r = &object_rects[4*i];
+  return r[0] < update_region[0] + update_region[2] && r[2] > update_region[0] &&
+    r[1] < update_region[1] + update_region[3] && r[3] > update_region[1];
+}
+
+/**
+ * Collects the GPU time of an earlier frame if it is available,
+ * without waiting, and switches to the other pair of timestamps.
+ **/
+void Application::readFrameTimer( void ) {
+
+  frame_query_slot = 1 - frame_query_slot;
+  if (!frame_query_pending[frame_query_slot])
+    return;
+
+  GLuint available = 0;
+  glGetQueryObjectuiv(frame_queries[frame_query_slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  GLuint64 start, end;
+  glGetQueryObjectui64v(frame_queries[frame_query_slot][0], GL_QUERY_RESULT, &start);
+  glGetQueryObjectui64v(frame_queries[frame_query_slot][1], GL_QUERY_RESULT, &end);
+  frame_time = (end - start) * 1.0e-6;
+  frame_query_pending[frame_query_slot] = false;
+}
+
+/**
+ * Multiplies the modelview matrix by the trackball and by the
+ * normalization that centers the model in the unit sphere.
+ **/
+void Application::applyModelTransform( void ) {
 
   // Loads current OpenGl state matrices into trackball matrices
   trackball.GetView();  
@@ -159,52 +630,373 @@ void Application::draw( void ) {
   float diag = 2.0f/FullBBox.Diag();
   glScalef(diag, diag, diag);
   glTranslatef(-FullBBox.Center()[0], -FullBBox.Center()[1], -FullBBox.Center()[2]);
+}
 
-  /// Get eye position rotated in inverse direction for backface culling
-  Matrix44f model;
-  glGetv(GL_MODELVIEW_MATRIX,model);
-  Invert(model);
-  vcg::Point3f vp = model* Point3f(0., 0., 0.);
- 
-  // Set eye for back face culling in vertex shader of projection phase
-  point_based_render->setEye( Point3f(vp[0], vp[1], vp[2]) );
+/**
+ * Computes how many pixels a reconstructed surface may reach beyond
+ * the samples that produced it, for the current camera and an image
+ * of the given height.
+ * This is the largest projected ellipse (twice the radius, grown by the
+ * reconstruction filter) for the model point closest to the eye.
+ * @param width Full image width.
+ * @param height Full image height.
+ * @return Support radius in pixels.
+ **/
+int Application::supportRadius( int width, int height ) {
 
-  // Set factor for scaling projected radii of samples in projection phase
-  point_based_render->setScaleFactor( scale_factor );
+  setView(0, 0, width, height, width, height);
 
-  // project all objects
-  if (selected == 0)
-    for (unsigned int i = 0; i < objects.size(); ++i)
-      point_based_render->projectSamples( &objects[i] );
-  // project only selected part
-  else
-    point_based_render->projectSamples( &objects[selected-1] );
+  glPushMatrix();
+  applyModelTransform();
+  GLdouble modelview[16];
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+  glPopMatrix();
 
-  // Interpolates projected surfels using pyramid algorithm (pull-push)
-  point_based_render->interpolate();
+  return supportRadius(modelview, height);
+}
 
-  // Computes per pixel color with deferred shading
-  point_based_render->draw();
+/**
+ * Support radius for a camera already read, see supportRadius above.
+ * @param modelview Column major modelview, including the model transformation.
+ * @param height Full image height.
+ * @return Support radius in pixels.
+ **/
+int Application::supportRadius( const GLdouble modelview[16], int height ) const {
 
-  glDisable (GL_LIGHTING);
-  glDisable (GL_LIGHT0);
-  glDisable (GL_COLOR_MATERIAL);
+  double max_radius = maxSurfelRadius();
 
-  if (show_points)
-    drawPoints();
+  // uniform scale from model to eye space and closest model point to the eye
+  const GLdouble *m = modelview;
+  float scale = sqrt(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+  Point3f center = FullBBox.Center();
+  float center_z = m[2]*center[0] + m[6]*center[1] + m[10]*center[2] + m[14];
+  float nearest = -center_z - 0.5f * scale * FullBBox.Diag();
 
-  glPopMatrix();
+  float ratio = 1.75f;
+  float objDist = ratio / tanf(vcg::math::ToRad(fov*.5f));
+  nearest = max(nearest, 0.1f * objDist);
 
-  if (frame == 10) {
-    frame = 0;
-    int endtime = glutGet(GLUT_ELAPSED_TIME);
-    cout << "FPS : " << 10*1000.0/(endtime-time) << endl; 
+  double filter = sqrt(max(point_based_render->getReconstructionFilterSize(), 1.0));
+  return (int)ceil(2.0 * max_radius * scale / nearest * scale_factor * height * filter);
+}
+
+/**
+ * Largest surfel radius of all objects, in model coordinates.
+ **/
+double Application::maxSurfelRadius( void ) const {
+  double max_radius = 0.0;
+  for (unsigned int i = 0; i < objects.size(); ++i)
+    max_radius = max(max_radius, (double)objects[i]->getBounds().max_radius);
+  return max_radius;
+}
+
+/**
+ * Width in pixels of the largest splat of the normalized model, seen
+ * from a camera at the given distance from the model center.
+ * @param focal Focal length in pixels.
+ * @param distance Distance from the camera to the center of the unit sphere.
+ **/
+int Application::splatMargin( double focal, double distance ) const {
+  double max_radius = maxSurfelRadius() * 2.0 / FullBBox.Diag();
+  double filter = sqrt(max(point_based_render->getReconstructionFilterSize(), 1.0));
+  double nearest = max(distance - 1.0, 0.1);
+  return max(2, (int)ceil(2.0 * max_radius / nearest * focal * filter));
+}
+
+/// Smallest core of a tile, when the overlap cannot cover the splat support.
+static const int min_tile_core = 16;
+
+/**
+ * Renders an image of arbitrary size by splitting the view into tiles.
+ * Each tile is an overlapping sub-frustum rendered through its own pyramid,
+ * the overlap covers the pull-push support so that the tile cores match
+ * the full image exactly and can be stitched without seams.
+ * Tiles come back through the asynchronous readback, so the readback of
+ * one tile overlaps with the rendering of the next ones.
+ * The image is written as a PAM file one band of tiles at a time.
+ * @param filename Output file name.
+ * @param width Image width.
+ * @param height Image height.
+ * @param tile_size Size of the square tiles (pyramid base level).
+ * @return 0 on success, -1 if the file could not be created.
+ **/
+int Application::renderTiled( const char * filename, int width, int height, int tile_size ) {
+
+  if (objects.size() == 0)
+    return -1;
+
+  GLint max_size, max_rb_size;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE_EXT, &max_rb_size);
+  int max_tile = min(max_size, max_rb_size);
+  tile_size = min(tile_size, max_tile);
+
+  // overlap covers the support radius plus the gather kernel footprint;
+  // tiles grow, up to the largest pyramid, to keep at least half of them as core
+  int overlap = max(supportRadius(width, height) + 4, 4);
+  if (tile_size < 4*overlap)
+    tile_size = min(4*overlap, max_tile);
+  if (tile_size - 2*overlap < min_tile_core) {
+    overlap = (tile_size - min_tile_core) / 2;
+    cout << "Warning: splat support exceeds the overlap of tiles of " << tile_size
+	 << ", seams may appear between tiles" << endl;
   }
 
-  /// uncomment this to flush frames every time, so you can better compute the true time to compute one frame,
-  /// but of course, this will slow down a little the rendering since the graphics board must wait for everything
-  /// to finish before continuing with the next frame
-  //glFinish();
+  TileStitch stitch;
+  stitch.fp = fopen(filename, "wb");
+  if (stitch.fp == NULL)
+    return -1;
+
+  fprintf(stitch.fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+	  width, height);
+
+  stitch.width = width;
+  stitch.height = height;
+  stitch.tile_size = tile_size;
+  stitch.overlap = overlap;
+  stitch.core = tile_size - 2*overlap;
+  stitch.columns = (width + stitch.core - 1) / stitch.core;
+  stitch.band.resize(stitch.core * width * 4);
+
+  int bands = (height + stitch.core - 1) / stitch.core;
+
+  cout << "tiled rendering " << width << "x" << height << " : " << stitch.columns << "x" << bands
+       << " tiles of " << tile_size << " (overlap " << overlap << ")" << endl;
+
+  // render tiles offscreen, readback delivers them to stitchTile
+  int old_width = canvas_width, old_height = canvas_height;
+  canvas_width = canvas_height = tile_size;
+  createPointRenderer();
+  // levels probed on one tile would be used for the next one
+  point_based_render->setAdaptiveLevels(false);
+  point_based_render->setPartialUpdates(false);
+  point_based_render->setOffscreen(true);
+  point_based_render->setReadback(false);
+  point_based_render->setReadbackOutput("");
+  point_based_render->setReadbackCallback(stitchTile, &stitch);
+  // tiles only need color
+  point_based_render->setReadback(true, false);
+
+  // bands from top to bottom, so rows can be written as soon as a band is complete
+  for (int b = 0; b < bands; ++b) {
+    int y0 = max(0, height - (b+1)*stitch.core);
+    for (int c = 0; c < stitch.columns; ++c) {
+      int x0 = c * stitch.core;
+      point_based_render->clearBuffers();
+      setView(x0 - overlap, y0 - overlap, tile_size, tile_size, width, height);
+      renderView();
+    }
+  }
+  point_based_render->flushReadback();
+  point_based_render->setReadback(false);
+
+  fclose(stitch.fp);
+
+  canvas_width = old_width;
+  canvas_height = old_height;
+  createPointRenderer();
+
+  return 0;
+}
+
+/**
+ * Renders many views of the scene in batches, e.g. for light field displays.
+ * The views of a batch are laid out side by side in one atlas canvas:
+ * each view is projected into its own cell, then analysis, synthesis and
+ * shading run once for the whole atlas and the atlas is read back
+ * asynchronously while the next batch is rendered.
+ * Cells are separated by a margin wider than the largest projected splat,
+ * so that no reconstructed surface reaches a neighbouring view.
+ * Geometry is drawn from the objects' buffers, which all views share.
+ * @param views Camera of each view.
+ * @param width View width.
+ * @param height View height.
+ * @param callback Called once per view, in order, with frame set to the view index.
+ * @param user_data Pointer handed back to the callback.
+ * @param atlas_size Largest atlas side.
+ * @return 0 on success, -1 if a view does not fit in the atlas.
+ **/
+int Application::renderViews( const vector<ViewCamera> &views, int width, int height,
+			      ReadbackCallback callback, void * user_data, int atlas_size ) {
+
+  if (objects.size() == 0 || views.empty())
+    return -1;
+
+  GLint max_size, max_rb_size;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE_EXT, &max_rb_size);
+  atlas_size = min(atlas_size, (int)min(max_size, max_rb_size));
+
+  // model normalized to the unit sphere, as in applyModelTransform
+  float diag = 2.0f/FullBBox.Diag();
+
+  // largest projected splat over all views bounds the margin between cells
+  double focal = 0.0, distance = 0.0;
+  for (unsigned int v = 0; v < views.size(); ++v) {
+    const GLdouble *m = views[v].modelview;
+    double d = sqrt(m[12]*m[12] + m[13]*m[13] + m[14]*m[14]);
+    double f = views[v].projection[5] * 0.5 * height;
+    // the ratio focal / (distance - 1) decides the splat size
+    if (v == 0 || f / max(d - 1.0, 0.1) > focal / max(distance - 1.0, 0.1)) {
+      focal = f;
+      distance = d;
+    }
+  }
+  int margin = splatMargin(focal, distance);
+
+  ViewAtlas atlas;
+  atlas.callback = callback;
+  atlas.user_data = user_data;
+  atlas.width = width;
+  atlas.height = height;
+  atlas.margin = margin;
+  // cells aligned to 16 pixels keep views aligned in the first pyramid levels
+  atlas.cell_width = (width + 2*margin + 15) / 16 * 16;
+  atlas.cell_height = (height + 2*margin + 15) / 16 * 16;
+  if (atlas.cell_width > atlas_size || atlas.cell_height > atlas_size)
+    return -1;
+
+  atlas.columns = atlas_size / atlas.cell_width;
+  int rows = atlas_size / atlas.cell_height;
+  atlas.views_per_atlas = min((int)views.size(), atlas.columns * rows);
+  atlas.columns = min(atlas.columns, atlas.views_per_atlas);
+  rows = (atlas.views_per_atlas + atlas.columns - 1) / atlas.columns;
+  atlas.views_count = views.size();
+  atlas.color.resize(width * height * 4);
+  atlas.normal.resize(width * height * 3);
+  atlas.depth.resize(width * height);
+
+  cout << "rendering " << views.size() << " views of " << width << "x" << height << " : "
+       << atlas.views_per_atlas << " per atlas of " << atlas.columns << "x" << rows
+       << " cells (margin " << margin << ")" << endl;
+
+  int old_width = canvas_width, old_height = canvas_height;
+  canvas_width = atlas.columns * atlas.cell_width;
+  canvas_height = rows * atlas.cell_height;
+  createPointRenderer();
+  // culling reads a single camera per frame, levels are probed on the previous batch
+  point_based_render->setOcclusionCulling(false);
+  point_based_render->setAdaptiveLevels(false);
+  point_based_render->setPartialUpdates(false);
+  point_based_render->setOffscreen(true);
+  point_based_render->setReadback(false);
+  point_based_render->setReadbackOutput("");
+  point_based_render->setReadbackCallback(splitAtlas, &atlas);
+  point_based_render->setReadback(true);
+
+  for (unsigned int first = 0; first < views.size(); first += atlas.views_per_atlas) {
+
+    point_based_render->clearBuffers();
+
+    // head light
+    point_based_render->setLightDirection( Point3f(0.0, 0.0, 1.0) );
+
+    unsigned int last = min((unsigned int)views.size(), first + atlas.views_per_atlas);
+    for (unsigned int v = first; v < last; ++v) {
+      int cell = v - first;
+      glViewport((cell % atlas.columns) * atlas.cell_width + margin,
+		 (cell / atlas.columns) * atlas.cell_height + margin, width, height);
+
+      glMatrixMode(GL_PROJECTION);
+      glLoadMatrixd(views[v].projection);
+      glMatrixMode(GL_MODELVIEW);
+      glLoadMatrixd(views[v].modelview);
+      glScalef(diag, diag, diag);
+      glTranslatef(-FullBBox.Center()[0], -FullBBox.Center()[1], -FullBBox.Center()[2]);
+
+      Matrix44f model;
+      glGetv(GL_MODELVIEW_MATRIX, model);
+      Invert(model);
+      point_based_render->setEye( model * Point3f(0., 0., 0.) );
+
+      GLdouble modelview[16];
+      glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+      point_based_render->setCamera( modelview, views[v].projection );
+
+      // radii are relative to the canvas height
+      point_based_render->setScaleFactor( views[v].projection[5] * 0.5 * height / (double)canvas_height );
+
+      for (unsigned int i = 0; i < objects.size(); ++i)
+	point_based_render->projectSamples( objects[i] );
+    }
+
+    point_based_render->interpolate();
+    point_based_render->draw();
+  }
+  point_based_render->flushReadback();
+  point_based_render->setReadback(false);
+
+  canvas_width = old_width;
+  canvas_height = old_height;
+  createPointRenderer();
+
+  return 0;
+}
+
+/**
+ * Readback callback of renderViews, copies every view of the atlas
+ * into contiguous buffers and hands it to the user callback.
+ * @param frame Captured atlas, frames are numbered in rendering order.
+ * @param user_data Pointer to the ViewAtlas state.
+ **/
+void Application::splitAtlas( const ReadbackFrame &frame, void * user_data ) {
+
+  ViewAtlas *atlas = (ViewAtlas*)user_data;
+
+  int first = frame.frame * atlas->views_per_atlas;
+  int last = min(atlas->views_count, first + atlas->views_per_atlas);
+
+  for (int v = first; v < last; ++v) {
+    int x0 = ((v - first) % atlas->columns) * atlas->cell_width + atlas->margin;
+    int y0 = ((v - first) / atlas->columns) * atlas->cell_height + atlas->margin;
+
+    for (int j = 0; j < atlas->height; ++j) {
+      size_t src = (size_t)(y0 + j) * frame.width + x0;
+      size_t dst = (size_t)j * atlas->width;
+      memcpy(&atlas->color[dst*4], frame.color + src*4, atlas->width*4);
+      memcpy(&atlas->normal[dst*3], frame.normal + src*3, atlas->width*3*sizeof(GLfloat));
+      memcpy(&atlas->depth[dst], frame.depth + src, atlas->width*sizeof(GLfloat));
+    }
+
+    ReadbackFrame view;
+    view.frame = v;
+    view.width = atlas->width;
+    view.height = atlas->height;
+    view.color = &atlas->color[0];
+    view.normal = &atlas->normal[0];
+    view.depth = &atlas->depth[0];
+    if (atlas->callback)
+      atlas->callback(view, atlas->user_data);
+  }
+}
+
+/**
+ * Readback callback of tiled rendering, copies the tile core into
+ * the current band and writes the band once its last tile arrives.
+ * @param frame Captured tile, frames are numbered in rendering order.
+ * @param user_data Pointer to the TileStitch state.
+ **/
+void Application::stitchTile( const ReadbackFrame &frame, void * user_data ) {
+
+  TileStitch *stitch = (TileStitch*)user_data;
+
+  int b = frame.frame / stitch->columns;
+  int c = frame.frame % stitch->columns;
+
+  int y1 = stitch->height - b*stitch->core;
+  int y0 = max(0, y1 - stitch->core);
+  int x0 = c * stitch->core;
+  int core_w = min(stitch->core, stitch->width - x0);
+
+  // band rows are bottom-up like the frame rows
+  for (int j = 0; j < y1 - y0; ++j)
+    memcpy(&stitch->band[(j*stitch->width + x0)*4],
+	   frame.color + ((stitch->overlap + j)*frame.width + stitch->overlap)*4,
+	   core_w*4);
+
+  if (c == stitch->columns - 1)
+    for (int j = y1 - y0 - 1; j >= 0; --j)
+      fwrite(&stitch->band[j*stitch->width*4], 4, stitch->width, stitch->fp);
 }
 
 /// Reshape func
@@ -227,7 +1019,7 @@ void Application::reshape(int w, int h) {
  **/
 void Application::changeRendererType( int type ) {
   for (unsigned int i = 0; i < objects.size(); ++i)
-    objects[i].setRendererType((point_render_type_enum) type);
+    objects[i]->setRendererType((point_render_type_enum) type);
   render_mode = type;
   createPointRenderer( );
 }
@@ -239,22 +1031,47 @@ void Application::changeRendererType( int type ) {
  **/
 void Application::createPointRenderer( void ) {  
 
-  if (point_based_render)
-    delete point_based_render;
+  PointBasedRenderer *previous = point_based_render;
 
   if (render_mode == PYRAMID_POINTS)
     point_based_render = new PyramidPointRenderer(canvas_width, canvas_height);
   else if (render_mode == PYRAMID_POINTS_COLOR)
     point_based_render = new PyramidPointRendererColor(canvas_width, canvas_height);
-  // else if (render_mode == PYRAMID_ELLIPSES)
-  // 	point_based_render = new PyramidPointRendererElipse(canvas_width, canvas_height);
-  // else if (render_mode == PYRAMID_TEMPLATES)
-  //   point_based_render = new PyramidPointRendererER(canvas_width, canvas_height);
+  else if (render_mode == PYRAMID_ELLIPSES)
+    point_based_render = new PyramidPointRendererElipse(canvas_width, canvas_height);
+  else if (render_mode == PYRAMID_TEMPLATES)
+    point_based_render = new PyramidPointRendererER(canvas_width, canvas_height);
 
   assert (point_based_render);
 
-  ((PyramidPointRendererBase*)point_based_render)->createShaders();  
+  // keep filter sizes, material and flags of the renderer being replaced
+  if (previous) {
+    point_based_render->copyParameters(*previous);
+    delete previous;
+  }
+
+  ((PyramidPointRendererBase*)point_based_render)->loadShaders();
+
+  point_based_render->setGpuMaskSize( gpu_mask );
+
+  point_based_render->setReadbackOutput( readback_prefix );
+  point_based_render->setReadbackCallback( readback_callback, readback_data );
+  point_based_render->setReadback( readback );
+
+  updateStereoGap();
+  point_based_render->setStereo( stereo, stereo_gap );
 
+  // the new buffers hold no samples yet, all surfels are projected until the next frame
+  point_based_render->setAccumulation( frame_budget > 0.0 );
+  point_based_render->setSoftwareProjection( software_projection );
+  point_based_render->setOverdrawMode( overdraw_mode );
+  point_based_render->setOverdrawCounters( overdraw_counters );
+  refined_fraction = 0.0f;
+  radius_scale = 1.0f;
+
+  point_based_render->setOcclusionCulling( occlusion_culling );
+  point_based_render->setPartialUpdates( partial_updates );
+  point_based_render->setAdaptiveLevels( adaptive_levels );
 }
 
 /**
@@ -287,10 +1104,6 @@ int Application::readSurfelFile ( const char * filename, vector<Surfeld>& surfel
   cout << "has color per vertex : " << color_per_vertex << endl;
   cout << "has radius per vertex : " << radius_per_vertex << endl;
 
-  /// Compute BBox
-  vcg::tri::UpdateBounding<CMesh>::Box(mesh);
-  FullBBox.Add(mesh.bbox);
-
   // vcg::tri::UpdateNormals<CMesh>::PerVertex(mesh);
 
   // Load vertex arrays in primitive class
@@ -316,6 +1129,76 @@ int Application::readSurfelFile ( const char * filename, vector<Surfeld>& surfel
   return mesh.vn;
 }
 
+/**
+ * Reads a surfel cache or a ply file straight into the surfel arrays of an object.
+ * @param filename Given file name.
+ * @param object Object to be filled.
+ * @return False if the file could not be read, the VCG based loaders should be used instead.
+ **/
+bool Application::readStoreFile ( const char * filename, Object &object ) {
+
+  int start = glutGet(GLUT_ELAPSED_TIME);
+  double megabytes;
+
+  if (SurfelCache::isCache(filename)) {
+    SurfelBounds bounds;
+    if (SurfelCache::read(filename, *object.getStore(), &bounds) < 0) {
+      cout << "invalid surfel cache " << filename << endl;
+      return false;
+    }
+    object.setBounds(bounds);
+    megabytes = 0.0;
+  }
+  else {
+    PlyReader reader;
+    if (!reader.open(filename) || reader.read(*object.getStore()) < 0) {
+      cout << "ply reader : " << reader.error() << ", using vcg importer" << endl;
+      return false;
+    }
+    megabytes = reader.bodySize() / (1024.0 * 1024.0);
+  }
+
+  double seconds = max(glutGet(GLUT_ELAPSED_TIME) - start, 1) / 1000.0;
+  cout << "points : " << object.getStore()->size() << " read in " << seconds << " s (";
+  if (megabytes > 0.0)
+    cout << megabytes / seconds << " MB/s, ";
+  cout << object.getStore()->size() / (seconds * 1.0e6) << " Mpoints/s)" << endl;
+
+  return true;
+}
+
+/**
+ * Computes the bounds of the objects that have none yet (read from PLY
+ * files) and rebuilds the scene box from the bounds of all objects.
+ **/
+void Application::updateSceneBounds ( void ) {
+  FullBBox.SetNull();
+  for (unsigned int i = 0; i < objects.size(); ++i) {
+    if (objects[i]->getBounds().empty())
+      objects[i]->updateBounds();
+    FullBBox.Add(objects[i]->getBounds().box);
+  }
+}
+
+/**
+ * Removes outliers and orients the normals of an object just read,
+ * its bounds are computed again without the outliers.
+ * @param object Object to be cleaned.
+ **/
+void Application::preprocess ( Object &object ) {
+
+  int start = glutGet(GLUT_ELAPSED_TIME);
+
+  object.fillStore();
+  size_t removed = SurfelPreprocessor::removeOutliers(*object.getStore());
+  size_t flipped = SurfelPreprocessor::orientNormals(*object.getStore());
+  object.setBounds(SurfelBounds());
+
+  double seconds = max(glutGet(GLUT_ELAPSED_TIME) - start, 1) / 1000.0;
+  cout << "preprocessing : " << removed << " outliers removed, " << flipped
+       << " normals flipped in " << seconds << " s" << endl;
+}
+
 /**
  * Reads a ply file, and loads the vertices and triangles in the associated primitive.
  * @param filename Given file name.
@@ -323,19 +1206,28 @@ int Application::readSurfelFile ( const char * filename, vector<Surfeld>& surfel
 void Application::readFile ( const char * filename, bool eliptical ) {
 
   // Create a new primitive from given file
-  objects.push_back( Object( objects.size() ) );
+  objects.push_back( new Object( objects.size() ) );
 
-  if(eliptical) {
-    IOSurfels<double>::LoadSurfels(filename, *(objects.back()).getSurfels());
-  }
-  else {
-    IOSurfels<double>::LoadMesh(filename, *(objects.back()).getSurfels());
+  if (!readStoreFile(filename, *objects.back())) {
+    if(eliptical) {
+      IOSurfels<double>::LoadSurfels(filename, *objects.back()->getSurfels());
+      objects.back()->fillStore(SurfelStore::NORMAL | SurfelStore::COLOR | SurfelStore::RADIUS |
+				SurfelStore::AXES | SurfelStore::ERRORS);
+    }
+    else {
+      IOSurfels<double>::LoadMesh(filename, *objects.back()->getSurfels());
+      objects.back()->fillStore();
+    }
   }
+  if (preprocessing)
+    preprocess(*objects.back());
+  updateSceneBounds();
 
   //readSurfelFile ( filename, (objects.back()).getSurfels() );
 
   // Sets the default rendering algorithm
-  objects[0].setRendererType( render_mode );
+  objects[0]->setRendererType( render_mode );
+  chooseStorage( );
 
   createPointRenderer( );
 }
@@ -349,22 +1241,278 @@ void Application::readFile ( const char * filename, bool eliptical ) {
 /// @return Number of points read from ply file.
 int Application::appendFile ( const char * filename ) { 
   // Create a new primitive from given file
-  objects.push_back( Object( objects.size() ) );
-  int pts = readSurfelFile ( filename, *(objects.back()).getSurfels() );
+  objects.push_back( new Object( objects.size() ) );
+  if (readStoreFile(filename, *objects.back()))
+    return objects.back()->getStore()->size();
+  int pts = readSurfelFile ( filename, *objects.back()->getSurfels() );
   return pts;
 }
 
+/**
+ * Saves the surfels of all objects into a single file.
+ * Files ending in ".ppc" are written as surfel caches, others as PLY.
+ * @param filename Given file name.
+ * @param binary Binary or ASCII body for PLY files.
+ * @return False on errors.
+ **/
+bool Application::saveFile ( const char * filename, bool binary ) {
+
+  int start = glutGet(GLUT_ELAPSED_TIME);
+
+  // only attributes present in every object are written
+  size_t count = 0;
+  int attributes = ~0;
+  for (unsigned int i = 0; i < objects.size(); ++i) {
+    count += objects[i]->getStore()->size();
+    attributes &= objects[i]->getStore()->attributes();
+  }
+  if (objects.empty())
+    attributes = 0;
+
+  string name (filename);
+  bool cache = name.size() > 4 && name.compare(name.size() - 4, 4, ".ppc") == 0;
+  bool ok = true;
+
+  if (cache) {
+    SurfelCache writer;
+    ok = writer.open(filename, attributes);
+    for (unsigned int i = 0; i < objects.size() && ok; ++i) {
+      const SurfelBounds &bounds = objects[i]->getBounds();
+      ok = writer.write(*objects[i]->getStore(), bounds.empty() ? NULL : &bounds);
+    }
+    ok = writer.close() && ok;
+  }
+  else {
+    PlyWriter writer;
+    ok = writer.open(filename, count, attributes, binary);
+    for (unsigned int i = 0; i < objects.size() && ok; ++i)
+      ok = writer.write(*objects[i]->getStore());
+    ok = writer.close() && ok;
+  }
+
+  if (!ok) {
+    cerr << "could not write " << filename << endl;
+    return false;
+  }
+
+  double seconds = max(glutGet(GLUT_ELAPSED_TIME) - start, 1) / 1000.0;
+  cout << "points : " << count << " written in " << seconds << " s ("
+       << count / (seconds * 1.0e6) << " Mpoints/s)" << endl;
+  return true;
+}
+
+/**
+ * Saves simplified versions of all objects as surfel caches, from fine to
+ * coarse, named <prefix>_<level>.ppc. Each level holds elliptical surfels
+ * with error bounds and about a fourth of the surfels of the previous one
+ * (see SurfelSimplifier).
+ * @param prefix Output file name prefix.
+ * @param count Number of levels.
+ * @return False on errors.
+ **/
+bool Application::saveLevels ( const char * prefix, int count ) {
+
+  int start = glutGet(GLUT_ELAPSED_TIME);
+
+  vector< vector<SurfelStore> > levels (objects.size());
+  for (unsigned int i = 0; i < objects.size(); ++i)
+    SurfelSimplifier::buildLevels(*objects[i]->getStore(), count, levels[i]);
+
+  for (int l = 0; l < count; ++l) {
+    ostringstream name;
+    name << prefix << "_" << l + 1 << ".ppc";
+
+    size_t points = 0;
+    float max_error = 0.0f;
+    SurfelCache writer;
+    bool ok = writer.open(name.str().c_str(), SurfelStore::NORMAL | SurfelStore::COLOR | SurfelStore::RADIUS |
+			  SurfelStore::AXES | SurfelStore::ERRORS);
+    for (unsigned int i = 0; i < objects.size() && ok; ++i) {
+      const SurfelStore &level = levels[i][l];
+      ok = writer.write(level);
+      points += level.size();
+      for (size_t j = 0; j < level.size(); ++j)
+	max_error = max(max_error, max(level.error[2*j], -level.error[2*j+1]));
+    }
+    ok = writer.close() && ok;
+
+    if (!ok) {
+      cerr << "could not write " << name.str() << endl;
+      return false;
+    }
+    cout << name.str() << " : " << points << " surfels, max error " << max_error
+	 << " (" << max_error / FullBBox.Diag() << " of the diagonal)" << endl;
+  }
+
+  double seconds = max(glutGet(GLUT_ELAPSED_TIME) - start, 1) / 1000.0;
+  cout << count << " levels written in " << seconds << " s" << endl;
+  return true;
+}
+
 /// Finalizes the multiple files reading routine.
 /// Creates all objects arrays.
 int Application::finishFileReading ( void ) {
 
+  updateSceneBounds();
+
   for (unsigned int i = 0; i < objects.size(); ++i)
-    objects[i].setRendererType( render_mode );
+    objects[i]->setRendererType( render_mode );
+  chooseStorage();
   createPointRenderer();
 
   return 0;
 }
 
+/**
+ * Switches to compressed storage when the full precision arrays
+ * would not fit comfortably in video memory.
+ **/
+void Application::chooseStorage ( void ) {
+
+  // position, radius and normal as floats plus color
+  const double bytes_per_point = 32.0;
+  const double full_precision_budget = 1024.0 * 1024.0 * 1024.0;
+
+  if (getNumberPoints() * bytes_per_point > full_precision_budget) {
+    cout << "model exceeds " << full_precision_budget / (1024.0 * 1024.0) << " MB, using quantized storage" << endl;
+    setQuantization(true);
+  }
+}
+
+/**
+ * Turns compressed surfel storage on or off for all objects.
+ * The quantization grid is derived from the scene bounding box.
+ * @param q Quantization flag.
+ **/
+void Application::setQuantization ( bool q ) {
+  if (q == quantization)
+    return;
+  quantization = q;
+  // clusters are rebuilt, the accumulated ranges do not match them anymore
+  refined_fraction = 0.0f;
+  for (unsigned int i = 0; i < objects.size(); ++i)
+    if (q)
+      objects[i]->quantize(FullBBox, quantization_tolerance);
+    else
+      objects[i]->clearQuantization();
+}
+
+/**
+ * Turns occlusion culling of surfel clusters on/off.
+ * @param c Occlusion culling state.
+ **/
+void Application::setOcclusionCulling ( bool c ) {
+  occlusion_culling = c;
+  if (point_based_render)
+    point_based_render->setOcclusionCulling(c);
+}
+
+/**
+ * Sets side by side stereo rendering, see PointBasedRenderer::setStereo.
+ * Occlusion culling is suspended while stereo is on.
+ * @param s Stereo mode (PointBasedRenderer::STEREO_*).
+ **/
+void Application::setStereo ( int s ) {
+  stereo = s;
+  if (point_based_render) {
+    updateStereoGap();
+    point_based_render->setStereo(stereo, stereo_gap);
+    point_based_render->setOcclusionCulling(occlusion_culling);
+  }
+}
+
+/**
+ * Turns projection of the samples on the CPU on/off, for machines
+ * without a fast GPU; the pyramid still runs on OpenGL.
+ * @param s Software projection state.
+ **/
+void Application::setSoftwareProjection ( bool s ) {
+  software_projection = s;
+  if (point_based_render)
+    point_based_render->setSoftwareProjection(s);
+}
+
+/**
+ * Sets how the projection avoids writing hidden surfels
+ * (see PointBasedRenderer::setOverdrawMode).
+ * @param m Overdraw mode.
+ **/
+void Application::setOverdrawMode ( int m ) {
+  overdraw_mode = m;
+  if (point_based_render)
+    point_based_render->setOverdrawMode(m);
+}
+
+/**
+ * Counts projected points and written fragments without reducing the
+ * overdraw (see PointBasedRenderer::setOverdrawCounters).
+ * @param c Counters state.
+ **/
+void Application::setOverdrawCounters ( bool c ) {
+  overdraw_counters = c;
+  if (point_based_render)
+    point_based_render->setOverdrawCounters(c);
+}
+
+/**
+ * Sets the time budget of interactive frames. Surfels are then projected
+ * in ranges of every cluster sized to the budget, and the model is
+ * refined progressively while the camera stands still.
+ * Occlusion culling is suspended while a budget is set.
+ * @param ms Budget in milliseconds of GPU time, 0 projects all surfels every frame.
+ **/
+void Application::setFrameBudget ( double ms ) {
+  frame_budget = max(ms, 0.0);
+  sample_fraction = 1.0f;
+  refined_fraction = 0.0f;
+  radius_scale = 1.0f;
+  if (point_based_render) {
+    point_based_render->setAccumulation(frame_budget > 0.0);
+    point_based_render->setSampleRange(0.0f, 1.0f);
+    point_based_render->setOcclusionCulling(occlusion_culling);
+  }
+}
+
+/**
+ * Turns partial updates on/off: while camera and light stand still, a
+ * frame only redoes the part of the canvas reached by objects shown,
+ * hidden or changed since the last frame (see updateRegion), and keeps
+ * the rest of the last frame.
+ * @param p Partial updates state.
+ **/
+void Application::setPartialUpdates ( bool p ) {
+  partial_updates = p;
+  full_frame = true;
+  if (point_based_render)
+    point_based_render->setPartialUpdates(p);
+}
+
+/**
+ * Marks an object whose surfels or bounds changed, e.g. a streamed tile
+ * refined in place; the next frame redoes its old and new rectangles.
+ * @param i Object index.
+ **/
+void Application::markObjectChanged ( int i ) {
+  if (i >= 0 && i < (int)object_changed.size())
+    object_changed[i] = 1;
+}
+
+/**
+ * Sizes the gap between the eyes so that no splat of one eye
+ * reaches into the other.
+ **/
+void Application::updateStereoGap ( void ) {
+  stereo_gap = 0;
+  if (stereo == PointBasedRenderer::STEREO_OFF || objects.size() == 0)
+    return;
+  float objDist = 1.75f / tanf(vcg::math::ToRad(fov*.5f));
+  double focal = canvas_height / (tanf(vcg::math::ToRad(fov*.5f)) * 2.0);
+  stereo_gap = splatMargin(focal, objDist);
+  // keep both eyes equally wide
+  if ((canvas_width - stereo_gap) % 2)
+    ++stereo_gap;
+}
+
 /// Mouse Left Button Function, starts rotation
 /// @param x X coordinate of mouse click
 /// @param y Y coordinate of mouse click
@@ -500,7 +1648,7 @@ int Application::getNumberPoints ( void ) {
   
   int num_pts = 0;
   for (unsigned int i = 0; i < objects.size(); ++i)
-    num_pts += objects[i].numberPoints();
+    num_pts += objects[i]->numberPoints();
 
   return num_pts;
 }
@@ -539,6 +1687,7 @@ void Application::setPrefilter ( double s ) {
  * @param m Kernel size mxm.
  **/
 void Application::setGpuMask ( int m ) {
+  gpu_mask = m;
   point_based_render->setGpuMaskSize( m );
 }
 
@@ -550,7 +1699,7 @@ void Application::setGpuMask ( int m ) {
 void Application::setPerVertexColor ( bool c ) {
   for (unsigned int i = 0; i < objects.size(); ++i) {
     // Reset renderer type to load per vertex color or default color in vertex array
-    objects[i].setRendererType( objects[i].getRendererType() );
+    objects[i]->setRendererType( objects[i]->getRendererType() );
   }
 }
 
@@ -572,6 +1721,78 @@ void Application::setDepthTest ( bool d ) {
     point_based_render->setDepthTest(d);
 }
 
+/**
+ * Changes the number of pixels gathered by the pyramid passes.
+ * The renderer is recreated so that its shaders are compiled for the new size.
+ * @param k Kernel size: 4, 12 or 20.
+ **/
+void Application::setKernelSize ( int k ) {
+  if (point_based_render) {
+    point_based_render->setKernelSize(k);
+    createPointRenderer();
+  }
+}
+
+/**
+ * Returns the number of pixels gathered by the pyramid passes.
+ **/
+int Application::getKernelSize ( void ) const {
+  return point_based_render ? point_based_render->getKernelSize() : 0;
+}
+
+/**
+ * Turns the adaptive number of pyramid levels on/off.
+ * @param a Adaptive levels state.
+ **/
+void Application::setAdaptiveLevels ( bool a ) {
+  adaptive_levels = a;
+  if (point_based_render)
+    point_based_render->setAdaptiveLevels(a);
+}
+
+/**
+ * Turns asynchronous readback of rendered frames on/off.
+ * @param r Readback state.
+ **/
+void Application::setReadback ( bool r ) {
+  readback = r;
+  if (point_based_render)
+    point_based_render->setReadback(r);
+}
+
+/**
+ * Sets the file prefix for writing captured frames to disk.
+ * @param prefix File name prefix, empty string disables writing.
+ **/
+void Application::setReadbackOutput ( const char * prefix ) {
+  readback_prefix = prefix;
+  if (point_based_render)
+    point_based_render->setReadbackOutput(readback_prefix);
+}
+
+/**
+ * Sets the function called with every captured frame.
+ * @param cb Callback, NULL to remove it.
+ * @param user_data Pointer handed back to the callback.
+ **/
+void Application::setReadbackCallback ( ReadbackCallback cb, void * user_data ) {
+  readback_callback = cb;
+  readback_data = user_data;
+  if (point_based_render)
+    point_based_render->setReadbackCallback(cb, user_data);
+}
+
+/**
+ * Fetches the oldest captured frame, if queueing is on.
+ * @param image Receives the frame.
+ * @return False if no frame is available.
+ **/
+bool Application::popReadbackFrame ( ReadbackImage & image ) {
+  if (point_based_render)
+    return point_based_render->popReadbackFrame(image);
+  return false;
+}
+
 /**
  * Change model material properties.
  * @param mat Id of material (see materials.h for list)
@@ -585,6 +1806,7 @@ void Application::changeMaterial( int mat ) {
  * @param b Backface culling state.
  **/
 void Application::setBackFaceCulling ( bool c ) {
+  refined_fraction = 0.0f;
   if (point_based_render)
     point_based_render->setBackFaceCulling(c);
 }
@@ -27,6 +27,8 @@ using namespace std;
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <climits>
+#include <cfloat>
 
 #include <list>
 #include <vector>
@@ -34,8 +36,8 @@ using namespace std;
 #include "pyramid_point_renderer_base.h"
 #include "pyramid_point_renderer.h"
 #include "pyramid_point_renderer_color.h"
-//#include "pyramid_point_renderer_elipse.h"
-//#include "pyramid_point_renderer_er.h"
+#include "pyramid_point_renderer_elipse.h"
+#include "pyramid_point_renderer_er.h"
 
 #include <vcg/simplex/vertex/base.h>
 #include <vcg/simplex/vertex/component.h>
@@ -56,6 +58,11 @@ using namespace std;
 #include <vcg/math/matrix44.h>
 
 #include "IOSurfels.hpp"
+#include "ply_reader.h"
+#include "ply_writer.h"
+#include "surfel_cache.h"
+#include "surfel_simplifier.h"
+#include "surfel_preprocessor.h"
 
 using namespace vcg;
 
@@ -74,6 +81,17 @@ class CMesh : public vcg::tri::TriMesh< std::vector<CVertex>, std::vector<CFace>
 /* class CFace    : public FaceSimp2< CVertex, CEdge, CFace, face::VertexRef > {}; */
 /* class CMesh    : public vcg::tri::TriMesh< vector<CVertex>, vector<CFace> > {}; */
 
+/**
+ * Camera of one view rendered by Application::renderViews.
+ * Column major OpenGL matrices; the modelview is applied to the model
+ * normalized to the unit sphere at the origin (no trackball).
+ **/
+struct ViewCamera
+{
+  GLdouble modelview[16];
+  GLdouble projection[16];
+};
+
 class Application
 {
  private :
@@ -82,6 +100,56 @@ class Application
 
   void drawPoints ( void );
 
+  void renderView ( void );
+  void applyModelTransform ( void );
+
+  int supportRadius ( int width, int height );
+  int supportRadius ( const GLdouble modelview[16], int height ) const;
+
+  void readCamera ( GLdouble camera[32] );
+  void updateRegion ( void );
+  void screenRect ( const Object &object, const GLdouble camera[32], int rect[4] ) const;
+  bool inRegion ( int i ) const;
+
+  /// State of the tile stitching while a tiled image is being read back
+  struct TileStitch {
+    FILE *fp;
+    int width, height;
+    int tile_size, overlap, core;
+    int columns;
+    /// One band of tile cores, full image width
+    vector<GLubyte> band;
+  };
+
+  static void stitchTile ( const ReadbackFrame &frame, void * user_data );
+
+  /// Placement of the views of renderViews in the atlas canvas
+  struct ViewAtlas {
+    ReadbackCallback callback;
+    void *user_data;
+    int width, height;
+    int cell_width, cell_height, margin;
+    int columns;
+    int views_per_atlas;
+    int views_count;
+    /// Host copy of one view, handed to the callback
+    vector<GLubyte> color;
+    vector<GLfloat> normal;
+    vector<GLfloat> depth;
+  };
+
+  static void splitAtlas ( const ReadbackFrame &frame, void * user_data );
+
+  double maxSurfelRadius ( void ) const;
+  int splatMargin ( double focal, double distance ) const;
+
+  void projectView ( void );
+  void setStereoView ( int eye );
+  void renderStereo ( void );
+  void updateStereoGap ( void );
+  void readFrameTimer ( void );
+  void updateSampleRange ( void );
+
  public :
 
   Application( GLint default_mode = PYRAMID_POINTS, int w = 512, int h = 512);
@@ -92,17 +160,54 @@ class Application
 
   int startFileReading ( void );
   int finishFileReading ( void );
+  bool saveFile ( const char * filename, bool binary = true );
+  bool saveLevels ( const char * prefix, int count );
 
   void draw ( void );
   void reshape ( int w, int h );
 
   void setView( void );
+  void setView( int x, int y, int w, int h, int full_w, int full_h );
+
+  int renderTiled ( const char * filename, int width, int height, int tile_size = 1024 );
+  int renderViews ( const vector<ViewCamera> &views, int width, int height,
+		    ReadbackCallback callback, void * user_data, int atlas_size = 2048 );
 
   void changeRendererType ( int type );
   void changeMaterial( int mat );
 
   int getNumberPoints ( void );
 
+  void setQuantization ( bool q );
+  bool getQuantization ( void ) const { return quantization; }
+
+  /// Clean files read from now on (see SurfelPreprocessor).
+  void setPreprocessing ( bool p ) { preprocessing = p; }
+
+  void setOcclusionCulling ( bool c );
+  bool getOcclusionCulling ( void ) const { return occlusion_culling; }
+
+  void setStereo ( int s );
+  int getStereo ( void ) const { return stereo; }
+
+  void setSoftwareProjection ( bool s );
+  bool getSoftwareProjection ( void ) const { return software_projection; }
+
+  void setOverdrawMode ( int m );
+  int getOverdrawMode ( void ) const { return overdraw_mode; }
+
+  void setOverdrawCounters ( bool c );
+  bool getOverdrawCounters ( void ) const { return overdraw_counters; }
+
+  void setFrameBudget ( double ms );
+  double getFrameBudget ( void ) const { return frame_budget; }
+
+  void setPartialUpdates ( bool p );
+  bool getPartialUpdates ( void ) const { return partial_updates; }
+  void markObjectChanged ( int i );
+  /// Renders the next frame whole, after changes that affect every pixel.
+  void invalidateFrame ( void ) { full_frame = true; }
+
   void setGpuMask ( int m );
   void setPerVertexColor ( bool b );
   void setAutoRotate ( bool r );
@@ -114,6 +219,14 @@ class Application
   void setMinimumRadius ( double r );
   void setPrefilter ( double s );
   void setDepthTest ( bool d );
+  void setAdaptiveLevels ( bool a );
+  void setKernelSize ( int k );
+  int getKernelSize ( void ) const;
+
+  void setReadback ( bool r );
+  void setReadbackOutput ( const char * prefix );
+  void setReadbackCallback ( ReadbackCallback cb, void * user_data );
+  bool popReadbackFrame ( ReadbackImage & image );
   
   void mouseLeftButton( int x, int y, bool shift, bool ctrl, bool alt );
   void mouseMiddleButton(int x, int y, bool shift, bool ctrl, bool alt );
@@ -135,6 +248,10 @@ class Application
  private :
 
   int readSurfelFile ( const char * filename, vector<Surfeld>& surfels, bool eliptical = 0 );
+  bool readStoreFile ( const char * filename, Object &object );
+  void updateSceneBounds ( void );
+  void chooseStorage ( void );
+  void preprocess ( Object &object );
 
   Trackball trackball;
   Trackball trackball_light;
@@ -151,8 +268,9 @@ class Application
   float fov;
   float scale_factor;
 
-  // Lists of objects (usually one ply file is associated to one object in list)
-  vector<Object> objects;
+  // Lists of objects (usually one ply file is associated to one object in list),
+  // owned by the application; objects are never copied
+  vector<Object*> objects;
 
   // Determines which rendering class to use (Pyramid points, with color per vertex, templates version ...)
   // see objects.h for the complete list (point_render_type_enum).
@@ -164,6 +282,76 @@ class Application
 
   int selected;
 
+  // Outlier removal and normal orientation of loaded files
+  bool preprocessing;
+
+  // Compressed surfel storage, chosen automatically after loading
+  bool quantization;
+  float quantization_tolerance;
+
+  // Skip surfel clusters hidden in previous frames
+  bool occlusion_culling;
+
+  // Climb only the pyramid levels needed by previous frames
+  bool adaptive_levels;
+
+  // Project samples on the CPU
+  bool software_projection;
+
+  // Overdraw reduction of the projection (PointBasedRenderer::OVERDRAW_*)
+  int overdraw_mode;
+
+  // Count points and fragments of the projection in every mode
+  bool overdraw_counters;
+
+  // Gather window of the template renderer
+  int gpu_mask;
+
+  // Side by side stereo mode (PointBasedRenderer::STEREO_*) and columns between the eyes
+  int stereo;
+  int stereo_gap;
+
+  // GPU timestamps at the start and end of two frames, used alternately
+  GLuint frame_queries[2][2];
+  bool frame_query_pending[2];
+  int frame_query_slot;
+  double frame_time;
+
+  // Frame budget in milliseconds (0 renders all surfels), fraction of every
+  // cluster projected per frame, fraction accumulated since the camera
+  // stopped, and the camera of the previous frame
+  double frame_budget;
+  double budget_time;
+  float sample_fraction;
+  float refined_fraction;
+  float radius_scale;
+  GLdouble last_camera[32];
+  int last_selected;
+
+  // Redo only the part of the canvas reached by objects shown, hidden or
+  // changed since the last frame; camera and light of the last frame, and
+  // its screen rectangle (x0, y0, x1, y1) and visibility per object
+  bool partial_updates;
+  bool full_frame;
+  GLdouble region_state[48];
+  vector<int> object_rects;
+  vector<unsigned char> object_shown;
+  vector<unsigned char> object_changed;
+
+  // Region (x, y, width, height) redone in the current frame, if region_frame
+  bool region_frame;
+  int update_region[4];
+
+  // Partial frames since the last report, and their summed share of the window
+  int partial_frames;
+  double partial_area;
+
+  // Readback state, reapplied every time the renderer is recreated
+  bool readback;
+  string readback_prefix;
+  ReadbackCallback readback_callback;
+  void * readback_data;
+
   /***** Frames per second and Surfels per second vars ******/
   double sps, fps;
   int fps_loop;
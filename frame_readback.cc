@@ -0,0 +1,233 @@
+/*
+** frame_readback.cc Asynchronous frame readback.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "frame_readback.h"
+
+#include <cstdio>
+#include <iostream>
+
+/**
+ * Creates the pixel buffer ring.
+ * @param w Frame width.
+ * @param h Frame height.
+ * @param a Capture normal and depth along with color.
+ * @param slots Number of frames that may be in flight.
+ **/
+FrameReadback::FrameReadback(int w, int h, bool a, int slots) : width(w), height(h), attributes(a),
+								 next_slot(0), pending(0), frame_count(0),
+								 callback(NULL), callback_data(NULL),
+								 queueing(false) {
+
+  // bytes per pixel of color (RGBA8), normal (RGB32F) and depth (R32F)
+  const int pixel_size[3] = {4, 3*sizeof(GLfloat), sizeof(GLfloat)};
+  const int buffers = attributes ? 3 : 1;
+
+  ring.resize(slots);
+  for (int s = 0; s < slots; ++s) {
+    ring[s].pbo[1] = ring[s].pbo[2] = 0;
+    glGenBuffers(buffers, ring[s].pbo);
+    for (int i = 0; i < buffers; ++i) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[s].pbo[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, width*height*pixel_size[i], NULL, GL_STREAM_READ);
+    }
+    ring[s].fence = 0;
+    ring[s].frame = -1;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameReadback::~FrameReadback() {
+  flush();
+  for (unsigned int s = 0; s < ring.size(); ++s)
+    glDeleteBuffers(3, ring[s].pbo);
+}
+
+/**
+ * Issues the asynchronous readback of the current frame.
+ * Color is read from the shaded output, normal and depth, if captured,
+ * from level 0 of the given framebuffer object.
+ * If all slots are in flight the oldest one is retired first,
+ * which is the only case where this call blocks.
+ * @param color_fbo Framebuffer holding the shaded image (0 for the window).
+ * @param color_buffer Buffer of color_fbo to read from (e.g. GL_BACK).
+ * @param fbo Framebuffer object holding the reconstructed level 0.
+ * @param normal_buffer Attachment with (n.x, n.y, n.z, radius).
+ * @param depth_buffer Attachment with (depth, depth range, x, y).
+ **/
+void FrameReadback::capture ( GLuint color_fbo, GLenum color_buffer,
+			      GLuint fbo, GLenum normal_buffer, GLenum depth_buffer ) {
+
+  poll();
+
+  if (pending == (int)ring.size())
+    retire(ring[(next_slot + ring.size() - pending) % ring.size()]);
+
+  Slot &slot = ring[next_slot];
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[0]);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, color_fbo);
+  glReadBuffer(color_buffer);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+  if (attributes) {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[1]);
+    glReadBuffer(normal_buffer);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_FLOAT, 0);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[2]);
+    glReadBuffer(depth_buffer);
+    glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, 0);
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glReadBuffer(GL_BACK);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frame = frame_count++;
+
+  next_slot = (next_slot + 1) % ring.size();
+  ++pending;
+}
+
+/**
+ * Delivers, in order, every in flight frame whose fence has already signaled.
+ * Never blocks.
+ **/
+void FrameReadback::poll ( void ) {
+  while (pending > 0) {
+    Slot &oldest = ring[(next_slot + ring.size() - pending) % ring.size()];
+    GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    retire(oldest);
+  }
+}
+
+/**
+ * Blocks until all in flight frames have been delivered.
+ **/
+void FrameReadback::flush ( void ) {
+  while (pending > 0)
+    retire(ring[(next_slot + ring.size() - pending) % ring.size()]);
+}
+
+/**
+ * Waits for the slot's fence, maps its buffers and hands the frame
+ * to the callback, the output files and the queue.
+ * @param slot Oldest in flight slot.
+ **/
+void FrameReadback::retire ( Slot &slot ) {
+
+  glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+  glDeleteSync(slot.fence);
+  slot.fence = 0;
+  --pending;
+
+  ReadbackFrame frame;
+  frame.frame = slot.frame;
+  frame.width = width;
+  frame.height = height;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[0]);
+  frame.color = (const GLubyte*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+  frame.normal = frame.depth = NULL;
+  if (attributes) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[1]);
+    frame.normal = (const GLfloat*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[2]);
+    frame.depth = (const GLfloat*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+  }
+
+  if (frame.color && (!attributes || (frame.normal && frame.depth))) {
+    if (callback)
+      callback(frame, callback_data);
+
+    if (!output_prefix.empty())
+      writeFiles(frame);
+
+    if (queueing) {
+      queue.push_back(ReadbackImage());
+      ReadbackImage &image = queue.back();
+      image.frame = frame.frame;
+      image.width = width;
+      image.height = height;
+      image.color.assign(frame.color, frame.color + width*height*4);
+      if (attributes) {
+	image.normal.assign(frame.normal, frame.normal + width*height*3);
+	image.depth.assign(frame.depth, frame.depth + width*height);
+      }
+    }
+  }
+  else
+    std::cerr << "FrameReadback: could not map pixel buffers of frame " << slot.frame << std::endl;
+
+  for (int i = attributes ? 2 : 0; i >= 0; --i) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo[i]);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * Writes the frame directly from mapped memory.
+ * PFM stores rows bottom-up like OpenGL, so normal and depth are written
+ * with a single call; the PAM color image is written row by row in reverse.
+ * @param frame Mapped frame.
+ **/
+void FrameReadback::writeFiles ( const ReadbackFrame &frame ) const {
+  char name[1024];
+  FILE *fp;
+
+  snprintf(name, sizeof(name), "%s_%05d.pam", output_prefix.c_str(), frame.frame);
+  if ((fp = fopen(name, "wb")) != NULL) {
+    fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+	    frame.width, frame.height);
+    for (int y = frame.height - 1; y >= 0; --y)
+      fwrite(frame.color + y*frame.width*4, 4, frame.width, fp);
+    fclose(fp);
+  }
+
+  if (!attributes)
+    return;
+
+  // negative scale marks little endian data
+  snprintf(name, sizeof(name), "%s_%05d_normal.pfm", output_prefix.c_str(), frame.frame);
+  if ((fp = fopen(name, "wb")) != NULL) {
+    fprintf(fp, "PF\n%d %d\n-1.0\n", frame.width, frame.height);
+    fwrite(frame.normal, 3*sizeof(GLfloat), frame.width*frame.height, fp);
+    fclose(fp);
+  }
+
+  snprintf(name, sizeof(name), "%s_%05d_depth.pfm", output_prefix.c_str(), frame.frame);
+  if ((fp = fopen(name, "wb")) != NULL) {
+    fprintf(fp, "Pf\n%d %d\n-1.0\n", frame.width, frame.height);
+    fwrite(frame.depth, sizeof(GLfloat), frame.width*frame.height, fp);
+    fclose(fp);
+  }
+}
+
+/**
+ * Pops the oldest queued frame.
+ * @param image Receives the frame.
+ * @return False if the queue is empty.
+ **/
+bool FrameReadback::pop ( ReadbackImage &image ) {
+  if (queue.empty())
+    return false;
+  image.frame = queue.front().frame;
+  image.width = queue.front().width;
+  image.height = queue.front().height;
+  image.color.swap(queue.front().color);
+  image.normal.swap(queue.front().normal);
+  image.depth.swap(queue.front().depth);
+  queue.pop_front();
+  return true;
+}
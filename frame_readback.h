@@ -0,0 +1,128 @@
+/*
+** frame_readback.h Asynchronous frame readback header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __FRAME_READBACK_H__
+#define __FRAME_READBACK_H__
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+
+/**
+ * View of one captured frame as handed to the readback callback.
+ * Pointers reference mapped pixel buffer memory and are only valid
+ * during the callback. All rows are stored bottom-up (OpenGL order).
+ **/
+struct ReadbackFrame
+{
+  /// Frame number, counted from the first captured frame.
+  int frame;
+  int width;
+  int height;
+  /// Shaded image, RGBA 8 bits per channel.
+  const GLubyte *color;
+  /// Reconstructed level 0 normals, RGB floats; NULL if not captured.
+  const GLfloat *normal;
+  /// Reconstructed level 0 eye space depth, one float (0 = background);
+  /// NULL if not captured.
+  const GLfloat *depth;
+};
+
+/**
+ * Host copy of a captured frame, as returned by the readback queue.
+ **/
+struct ReadbackImage
+{
+  int frame;
+  int width;
+  int height;
+  /// Normal and depth are empty if not captured.
+  std::vector<GLubyte> color;
+  std::vector<GLfloat> normal;
+  std::vector<GLfloat> depth;
+};
+
+typedef void (*ReadbackCallback) ( const ReadbackFrame &frame, void *user_data );
+
+/**
+ * Ring of pixel buffer objects used to bring rendered frames back to
+ * host memory without stalling the pipeline.
+ * Each captured frame issues asynchronous glReadPixels into its own
+ * slot and a fence; a slot is only mapped once its fence has signaled,
+ * so frame N is read while frames N+1 and N+2 are still being rendered.
+ * Color is always captured, normal and depth only if requested.
+ **/
+class FrameReadback
+{
+ public:
+
+  FrameReadback(int w, int h, bool attributes = true, int slots = 3);
+  ~FrameReadback();
+
+  /// Normal and depth are captured along with color.
+  bool hasAttributes ( void ) const { return attributes; }
+
+  void capture ( GLuint color_fbo, GLenum color_buffer,
+		 GLuint fbo, GLenum normal_buffer, GLenum depth_buffer );
+  void poll ( void );
+  void flush ( void );
+
+  void setCallback ( ReadbackCallback cb, void *user_data ) {
+    callback = cb;
+    callback_data = user_data;
+  }
+
+  /**
+   * Writes every delivered frame to disk straight from the mapped buffers.
+   * Color goes to <prefix>_<frame>.pam, normal and depth, if captured, to .pfm files.
+   * @param prefix File name prefix, empty string disables writing.
+   **/
+  void setOutputPrefix ( const std::string &prefix ) { output_prefix = prefix; }
+
+  /// Keeps a host copy of each delivered frame in the queue.
+  void setQueueing ( bool q ) { queueing = q; }
+
+  bool pop ( ReadbackImage &image );
+
+  int pendingFrames ( void ) const { return pending; }
+
+ private:
+
+  struct Slot {
+    GLuint pbo[3];
+    GLsync fence;
+    int frame;
+  };
+
+  void retire ( Slot &slot );
+  void writeFiles ( const ReadbackFrame &frame ) const;
+
+  int width, height;
+
+  /// Capture normal and depth, otherwise their buffers are not allocated.
+  bool attributes;
+
+  /// Ring of pixel buffer slots, next_slot is the one to be filled next.
+  std::vector<Slot> ring;
+  int next_slot;
+  int pending;
+
+  int frame_count;
+
+  ReadbackCallback callback;
+  void *callback_data;
+
+  std::string output_prefix;
+
+  bool queueing;
+  std::deque<ReadbackImage> queue;
+};
+
+#endif
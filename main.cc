@@ -18,6 +18,7 @@ static int windows_width = 1024;
 static int windows_height = 1024;
 
 bool depth_test;
+bool adaptive_levels;
 bool back_face_culling;
 int button_pressed;
 bool active_shift;
@@ -30,6 +31,7 @@ int material;
 bool auto_rotate;
 bool elliptical_weight;
 double minimum_radius_size;
+bool capture_frames;
 
 Application *application;
 
@@ -120,10 +122,68 @@ void keyboard(unsigned char key_pressed, int x, int y) {
     application->setEllipticalWeight( elliptical_weight );
     cout << "Elliptical weight : " << elliptical_weight << endl;
     break;
+  case 'c' :
+    capture_frames = !capture_frames;
+    application->setReadbackOutput ( "capture" );
+    application->setReadback ( capture_frames );
+    cout << "Capture frames : " << capture_frames << endl;
+    break;
+  case 'z' :
+    application->setQuantization ( !application->getQuantization() );
+    cout << "Quantized storage : " << application->getQuantization() << endl;
+    break;
+  case 'o' :
+    application->setOcclusionCulling ( !application->getOcclusionCulling() );
+    cout << "Occlusion culling : " << application->getOcclusionCulling() << endl;
+    break;
+  case 's' :
+    // cycles through mono, stereo with a shared pyramid and stereo in two passes
+    application->setStereo ( (application->getStereo() + 1) % 3 );
+    cout << "Stereo : " << application->getStereo() << endl;
+    break;
+  case 'x' :
+    application->setSoftwareProjection ( !application->getSoftwareProjection() );
+    cout << "Software projection : " << application->getSoftwareProjection() << endl;
+    break;
+  case 'v' :
+    // cycles through unordered, front to back clusters and depth pre-pass
+    application->setOverdrawMode ( (application->getOverdrawMode() + 1) % 3 );
+    cout << "Overdraw mode : " << application->getOverdrawMode() << endl;
+    break;
+  case 'V' :
+    application->setOverdrawCounters ( !application->getOverdrawCounters() );
+    cout << "Overdraw counters : " << application->getOverdrawCounters() << endl;
+    break;
+  case 'u' :
+    // redo only what changed while the camera stands still
+    application->setPartialUpdates ( !application->getPartialUpdates() );
+    cout << "Partial updates : " << application->getPartialUpdates() << endl;
+    break;
+  case 'g' :
+    // 33 ms budget while navigating, refined when the camera stops
+    application->setFrameBudget ( application->getFrameBudget() > 0.0 ? 0.0 : 33.0 );
+    cout << "Frame budget : " << application->getFrameBudget() << " ms" << endl;
+    break;
+  case 'p' :
+    // poster at four times the window resolution
+    application->renderTiled ( "poster.pam", 4*windows_width, 4*windows_height );
+    cout << "Poster written to poster.pam" << endl;
+    break;
   case 'd' :
     depth_test = !depth_test;
     application->setDepthTest ( depth_test );
     break;
+  case 'l' :
+    adaptive_levels = !adaptive_levels;
+    application->setAdaptiveLevels ( adaptive_levels );
+    cout << "Adaptive levels : " << adaptive_levels << endl;
+    break;
+  case 'k' :
+    // cycles through the 4, 12 and 20 pixel kernels
+    application->setKernelSize ( application->getKernelSize() == 4 ? 12 :
+				 (application->getKernelSize() == 12 ? 20 : 4) );
+    cout << "Kernel size : " << application->getKernelSize() << endl;
+    break;
   case 'b' :
     back_face_culling = !back_face_culling;
     application->setBackFaceCulling ( back_face_culling );
@@ -186,6 +246,10 @@ void keyboard(unsigned char key_pressed, int x, int y) {
     application->changeMaterial ( material );
   }
 
+  // changing the selection is the only key that keeps the rest of the frame
+  if (key_pressed != '.' && key_pressed != ',')
+    application->invalidateFrame();
+
   glutPostRedisplay();
 }
 
@@ -204,12 +268,12 @@ void keyboardSpecial(int key_pressed, int x, int y) {
     cout << "PYRAMID POINTS WITH COLOR" << endl;
     break;
   case GLUT_KEY_F3 :
-    //    application->changeRendererType ( 2 );
-    cout << "PYRAMID TEMPLATES WITH COLOR NOT READY" << endl;
+    application->changeRendererType ( 2 );
+    cout << "PYRAMID TEMPLATES WITH COLOR" << endl;
     break;
   case GLUT_KEY_F4 :
-    //    application->changeRendererType ( 3 );
-    cout << "PYRAMID ELIPSES NOT READY" << endl;
+    application->changeRendererType ( 3 );
+    cout << "PYRAMID ELIPSES" << endl;
     break;
   }
 
@@ -217,18 +281,21 @@ void keyboardSpecial(int key_pressed, int x, int y) {
   switch (key_pressed) {
   case GLUT_KEY_F1 :
   case GLUT_KEY_F2 :
-  // case GLUT_KEY_F3 :
-  // case GLUT_KEY_F4 :
+  case GLUT_KEY_F3 :
+  case GLUT_KEY_F4 :
     application->setGpuMask ( mask_size );
     application->changeMaterial ( material );
     application->setReconstructionFilter ( reconstruction_filter_size );
     application->setPrefilter ( prefilter_size );
     application->setDepthTest( depth_test );
+    application->setAdaptiveLevels( adaptive_levels );
     application->setBackFaceCulling( back_face_culling );
     application->setEllipticalWeight( elliptical_weight );
     break;
   }
 
+  application->invalidateFrame();
+
   glutPostRedisplay();
 }
 
@@ -352,7 +419,9 @@ int main(int argc, char * argv []) {
   auto_rotate = false;
   elliptical_weight = true;
   depth_test = true;
+  adaptive_levels = false;
   back_face_culling = true;
+  capture_frames = false;
 
   GLenum err = glewInit();
   if (GLEW_OK != err)
@@ -370,6 +439,26 @@ int main(int argc, char * argv []) {
     exit(0);
   }
 
+  // conversion to a surfel cache (.ppc) or binary ply, then exit
+  if (strcmp (argv[1], "-w") == 0) {
+    if (argc < 4) {
+      cerr << "    Usage :" << endl << " pyramid-point-renderer -w <ply_file> <output_file>" << endl;
+      exit(0);
+    }
+    application->readFile( argv[2] );
+    exit( application->saveFile( argv[3] ) ? 0 : 1 );
+  }
+
+  // simplified levels as surfel caches (<prefix>_1.ppc ...), then exit
+  if (strcmp (argv[1], "-s") == 0) {
+    if (argc < 4) {
+      cerr << "    Usage :" << endl << " pyramid-point-renderer -s <ply_file> <output_prefix> [levels]" << endl;
+      exit(0);
+    }
+    application->readFile( argv[2] );
+    exit( application->saveLevels( argv[3], argc > 4 ? atoi(argv[4]) : 3 ) ? 0 : 1 );
+  }
+
   // directory
   if (strcmp (argv[1], "-d") == 0) {
     string dir = string(argv[2]);
@@ -396,9 +485,20 @@ int main(int argc, char * argv []) {
     material = 5;
     back_face_culling = true;
   }
+  // raw scan, cleaned at load or written out cleaned when an output file is given
+  else if (strcmp (argv[1], "-p") == 0) {
+    application->setPreprocessing( true );
+    application->readFile( argv[2] );
+    if (argc > 3)
+      exit( application->saveFile( argv[3] ) ? 0 : 1 );
+    cout << "points : " << application->getNumberPoints() << endl; 
+    // normals are consistent, back faces can be dropped
+    back_face_culling = true;
+  }
   // eliptical surfel file
   else if (strcmp (argv[1], "-l") == 0) {
     application->readFile( argv[2], true );
+    application->changeRendererType ( 3 );
     cout << "elipses : " << application->getNumberPoints() << endl; 
   }
   // single file
@@ -412,6 +512,7 @@ int main(int argc, char * argv []) {
   application->setPrefilter ( prefilter_size );
   application->setMinimumRadius( minimum_radius_size );
   application->setDepthTest( depth_test );
+  application->setAdaptiveLevels( adaptive_levels );
   application->changeMaterial(material);
   application->setBackFaceCulling ( back_face_culling );
   application->setEllipticalWeight( elliptical_weight );
@@ -4,33 +4,103 @@
 
 Object::~Object() {
 
-  glDeleteLists(pointsDisplayList, 1);
+  deletePointBuffers();
+  if (quantized_buffers[0])
+    glDeleteBuffers(2, quantized_buffers);
 }
 
 /**
  * Render object using designed rendering system.
+ * Surfels are drawn cluster by cluster from buffer objects, fed to the
+ * generic vertex attributes of the projection shaders (see the attribute
+ * enum); for quantized storage the cluster grid and radius range are
+ * passed as the current values of the cluster attributes.
+ * Surfels are shuffled inside each cluster (see SurfelQuantizer), so a
+ * range of every cluster is a spatially stratified random subset.
+ * @param skip Per cluster flags, clusters with a nonzero entry are not drawn (NULL draws all).
+ * @param begin Start of the drawn range of each cluster, as a fraction of its size.
+ * @param end End of the drawn range of each cluster, as a fraction of its size.
+ * @param order Clusters in drawing order, from sortClusters (NULL keeps their order).
  **/
-void Object::render ( void ) const{
+void Object::render ( const vector<unsigned char> *skip, float begin, float end, const ClusterOrder *order ) const{
 
-  glCallList(pointsDisplayList);
-  
+  glEnableVertexAttribArray(POSITION_ATTRIBUTE);
+  glEnableVertexAttribArray(COLOR_ATTRIBUTE);
 
-  /// for rendering directly without display-lists uncomment the code below and comment line above
-  /// but performance drops drastically in many cases, for the asian dragon it is around 4 times slower for example
+  if (quantized_storage) {
+    glBindBuffer(GL_ARRAY_BUFFER, quantized_buffers[0]);
+    glVertexAttribPointer(POSITION_ATTRIBUTE, 4, GL_SHORT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, quantized_buffers[1]);
+    glVertexAttribPointer(COLOR_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+  }
+  else {
+    glEnableVertexAttribArray(NORMAL_ATTRIBUTE);
+    glBindBuffer(GL_ARRAY_BUFFER, point_buffers[0]);
+    glVertexAttribPointer(POSITION_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, point_buffers[1]);
+    glVertexAttribPointer(NORMAL_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    if (point_buffers[2]) {
+      glBindBuffer(GL_ARRAY_BUFFER, point_buffers[2]);
+      glVertexAttribPointer(COLOR_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+    }
+    else {
+      glDisableVertexAttribArray(COLOR_ATTRIBUTE);
+      glVertexAttrib4f(COLOR_ATTRIBUTE, 1.0f, 1.0f, 1.0f, 1.0f);
+    }
+  }
+  if (point_buffers[3]) {
+    glEnableVertexAttribArray(AXES_ATTRIBUTE);
+    glBindBuffer(GL_ARRAY_BUFFER, point_buffers[3]);
+    glVertexAttribPointer(AXES_ATTRIBUTE, 4, GL_SHORT, GL_FALSE, 0, 0);
+  }
+  else
+    // no axes, the ellipse projection shader draws circles
+    glVertexAttrib4f(AXES_ATTRIBUTE, 0.0f, 0.0f, 0.0f, 0.0f);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  // glBegin(GL_POINTS);
+  for (unsigned int j = 0; j < clusters.size(); ++j) {
+    unsigned int i = order ? (*order)[j].second : j;
+    if (skip && (*skip)[i])
+      continue;
+    const SurfelCluster &c = clusters[i];
+    if (quantized_storage) {
+      glVertexAttrib4f(CLUSTER_ORIGIN_ATTRIBUTE, c.origin[0], c.origin[1], c.origin[2], c.log_radius_min);
+      glVertexAttrib4f(CLUSTER_STEP_ATTRIBUTE, c.step[0], c.step[1], c.step[2], c.log_radius_step);
+    }
+    size_t first = (size_t)(begin * c.count), last = (size_t)(end * c.count);
+    if (last > first)
+      glDrawArrays(GL_POINTS, c.first + first, last - first);
+  }
 
-  // for (surfelVectorIterConst it = surfels.begin(); it != surfels.end(); ++it) {
-  // 	glColor4f((GLfloat)(it->Color()[0] / 255.0), (GLfloat)(it->Color()[1] / 255.0), (GLfloat)(it->Color()[2] / 255.0), (GLfloat)(1.0));
-  //   glNormal3f((GLfloat)it->Normal()[0], (GLfloat)it->Normal()[1], (GLfloat)it->Normal()[2]);
-  //   glVertex4f((GLfloat)it->Center()[0], (GLfloat)it->Center()[1], (GLfloat)it->Center()[2], (GLfloat)it->Radius());
-  // }
-  // glEnd();
+  glDisableVertexAttribArray(AXES_ATTRIBUTE);
+  glDisableVertexAttribArray(NORMAL_ATTRIBUTE);
+  glDisableVertexAttribArray(COLOR_ATTRIBUTE);
+  glDisableVertexAttribArray(POSITION_ATTRIBUTE);
 
   check_for_ogl_error("Primitives render");
 
 }
 
+/**
+ * Sorts the clusters front to back by the distance of their box center
+ * to the eye, once per frame for all passes that draw them.
+ * @param eye Eye position, in object coordinates.
+ * @param order Sorted clusters, reusing its storage.
+ **/
+void Object::sortClusters ( const Point3f &eye, ClusterOrder &order ) const {
+
+  order.resize(clusters.size());
+  for (unsigned int i = 0; i < clusters.size(); ++i) {
+    float d = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+      float x = 0.5f * (clusters[i].box_min[k] + clusters[i].box_max[k]) - eye[k];
+      d += x*x;
+    }
+    order[i] = make_pair(d, i);
+  }
+  sort(order.begin(), order.end());
+}
+
 /**
  * Changes the renderer type.
  * @param rtype Given renderer type.
@@ -39,51 +109,201 @@ void Object::setRendererType ( int rtype ) {
 
   renderer_type = rtype;
 
+  // objects read by the VCG based loaders only have the surfel vector
+  fillStore();
+  number_points = store.size();
+
+  deletePointBuffers();
+
+  // quantized surfels are drawn from their own buffer objects for every renderer
+  if (quantized_storage)
+    return;
+
+  // clusters only bounded by size, the store keeps full precision
+  if (clusters.empty() && store.size() > 0) {
+    Box3f box;
+    for (size_t i = 0; i < store.size(); ++i)
+      box.Add(Point3f(store.position[3*i], store.position[3*i+1], store.position[3*i+2]));
+    SurfelQuantizer::buildClusters(store, box, 1.0, clusters);
+  }
+
   if (rtype == PYRAMID_POINTS) {
-    setPyramidPointsDisplayList();
+    setPyramidPointsArrays();
+  }
+  else if (rtype == PYRAMID_POINTS_COLOR || rtype == PYRAMID_TEMPLATES) {
+    setPyramidPointsArraysColor();
   }
-  else if (rtype == PYRAMID_POINTS_COLOR) {
-    setPyramidPointsColorDisplayList();
+  else if (rtype == PYRAMID_ELLIPSES) {
+    setPyramidPointsArraysElipse();
   }
 
 }
 
-void Object::setPyramidPointsDisplayList ( void ) {
+/**
+ * Uploads positions (with the radius as fourth coordinate) and normals.
+ **/
+void Object::setPyramidPointsArrays ( void ) {
+
+  vector<GLfloat> vertices (4 * store.size());
+  for (size_t i = 0; i < store.size(); ++i) {
+    vertices[4*i] = store.position[3*i];
+    vertices[4*i+1] = store.position[3*i+1];
+    vertices[4*i+2] = store.position[3*i+2];
+    vertices[4*i+3] = store.radius[i];
+  }
+
+  glGenBuffers(2, point_buffers);
+  glBindBuffer(GL_ARRAY_BUFFER, point_buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
+	       vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, point_buffers[1]);
+  glBufferData(GL_ARRAY_BUFFER, store.normal.size() * sizeof(GLfloat),
+	       store.normal.empty() ? NULL : &store.normal[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  check_for_ogl_error("points arrays");
+}
+
+/**
+ * Uploads positions, normals and per surfel colors.
+ **/
+void Object::setPyramidPointsArraysColor ( void ) {
+
+  setPyramidPointsArrays();
 
-  pointsDisplayList = glGenLists(1);
+  glGenBuffers(1, &point_buffers[2]);
+  glBindBuffer(GL_ARRAY_BUFFER, point_buffers[2]);
+  glBufferData(GL_ARRAY_BUFFER, store.color.size(),
+	       store.color.empty() ? NULL : &store.color[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  glNewList(pointsDisplayList, GL_COMPILE);
+  check_for_ogl_error("points arrays color");
+}
+
+/**
+ * Uploads positions, normals and the surfel axes, if loaded.
+ * Axes take 8 bytes per surfel: the unit major axis direction and the
+ * minor to major length ratio as shorts scaled by 32767 (the major
+ * length is the radius).
+ **/
+void Object::setPyramidPointsArraysElipse ( void ) {
 
-  glPointSize(1.0);
+  setPyramidPointsArrays();
 
-  glBegin(GL_POINTS);
-  
-  for (surfelVectorIter it = surfels.begin(); it != surfels.end(); ++it) {
-    glNormal3f((GLfloat)it->Normal()[0], (GLfloat)it->Normal()[1], (GLfloat)it->Normal()[2]);
-    glVertex4f((GLfloat)it->Center()[0], (GLfloat)it->Center()[1], (GLfloat)it->Center()[2], (GLfloat)it->Radius());
+  if (!store.has(SurfelStore::AXES))
+    return;
+
+  vector<GLshort> axes (4 * store.size());
+#pragma omp parallel for
+  for (long i = 0; i < (long)store.size(); ++i) {
+    const float *major = &store.major_axis[4*i];
+    float length = sqrtf(major[0]*major[0] + major[1]*major[1] + major[2]*major[2]);
+    float ratio = major[3] > 0.0f ? store.minor_axis[4*i+3] / major[3] : 1.0f;
+    for (int k = 0; k < 3; ++k)
+      axes[4*i+k] = (GLshort)(length > 0.0f ? floorf(major[k] / length * 32767.0f + 0.5f) : 0);
+    axes[4*i+3] = (GLshort)floorf(std::min(std::max(ratio, 0.0f), 1.0f) * 32767.0f + 0.5f);
   }
-  glEnd();
 
-  glEndList();
+  glGenBuffers(1, &point_buffers[3]);
+  glBindBuffer(GL_ARRAY_BUFFER, point_buffers[3]);
+  glBufferData(GL_ARRAY_BUFFER, axes.size() * sizeof(GLshort),
+	       axes.empty() ? NULL : &axes[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  check_for_ogl_error("points arrays elipse");
 }
 
-void Object::setPyramidPointsColorDisplayList ( void ) {
+void Object::deletePointBuffers ( void ) {
+  for (int i = 0; i < 4; ++i)
+    if (point_buffers[i])
+      glDeleteBuffers(1, &point_buffers[i]);
+  point_buffers[0] = point_buffers[1] = point_buffers[2] = point_buffers[3] = 0;
+}
 
-  pointsDisplayList = glGenLists(1);
-  glNewList(pointsDisplayList, GL_COMPILE);
+/**
+ * Replaces the full precision arrays by the compressed surfel format (12 bytes per surfel),
+ * decoded by the projection vertex shaders.
+ * The store is reordered into spatial clusters whose quantization grid is
+ * derived from the scene bounding box; the resulting errors are reported.
+ * @param full_box Bounding box of the whole scene.
+ * @param tolerance Largest quantization step relative to the scene diagonal.
+ **/
+void Object::quantize ( const Box3f &full_box, float tolerance ) {
 
-  glBegin(GL_POINTS);
+  fillStore();
 
-  for (surfelVectorIter it = surfels.begin(); it != surfels.end(); ++it) {
-	glColor4f((GLfloat)(it->Color()[0] / 255.0), (GLfloat)(it->Color()[1] / 255.0), (GLfloat)(it->Color()[2] / 255.0), (GLfloat)(1.0));
-    glNormal3f((GLfloat)it->Normal()[0], (GLfloat)it->Normal()[1], (GLfloat)it->Normal()[2]);
-    glVertex4f((GLfloat)it->Center()[0], (GLfloat)it->Center()[1], (GLfloat)it->Center()[2], (GLfloat)it->Radius());
+  // the compressed format has no room for the axes, ellipses stay at full precision
+  if (store.has(SurfelStore::AXES)) {
+    cout << "elliptical surfels are not quantized" << endl;
+    return;
   }
-  glEnd();
 
-  glEndList();
+  SurfelQuantizer::buildClusters(store, full_box, tolerance, clusters);
+  SurfelQuantizer::quantize(store, clusters, quantized);
+
+  cout << "quantized " << quantized.size() << " surfels in " << clusters.size() << " clusters" << endl;
+  cout << "  max position error : " << quantized.max_position_error
+       << " (" << quantized.max_position_error / full_box.Diag() << " of the diagonal)" << endl;
+  cout << "  max normal error : " << quantized.max_normal_error << " degrees" << endl;
+  cout << "  max radius error : " << quantized.max_radius_error * 100.0 << " %" << endl;
+  cout << "  max color error : " << quantized.max_color_error << " / 255" << endl;
+
+  if (quantized_buffers[0] == 0)
+    glGenBuffers(2, quantized_buffers);
+
+  glBindBuffer(GL_ARRAY_BUFFER, quantized_buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, quantized.position.size() * sizeof(GLshort),
+	       quantized.position.empty() ? NULL : &quantized.position[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, quantized_buffers[1]);
+  glBufferData(GL_ARRAY_BUFFER, quantized.attributes.size(),
+	       quantized.attributes.empty() ? NULL : &quantized.attributes[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // the arrays now live on the GPU, only cluster parameters are kept
+  vector<GLshort>().swap(quantized.position);
+  vector<GLubyte>().swap(quantized.attributes);
+
+  deletePointBuffers();
+  number_points = store.size();
+  quantized_storage = true;
+
+  check_for_ogl_error("quantize");
+}
+
+/**
+ * Goes back to full precision arrays, keeping the quantization clusters.
+ **/
+void Object::clearQuantization ( void ) {
+  if (quantized_buffers[0])
+    glDeleteBuffers(2, quantized_buffers);
+  quantized_buffers[0] = quantized_buffers[1] = 0;
+  quantized.clusters.clear();
+  quantized_storage = false;
+  setRendererType(renderer_type);
 }
 
 void Object::clearSurfels ( void ) {  
   surfels.clear();
+  store.clear();
+  clusters.clear();
+  bounds = SurfelBounds();
+}
+
+/**
+ * Converts the surfels read by the VCG based loaders to the store,
+ * then releases them so that the points are held only once.
+ * @param attributes Attributes kept in the store, AXES for elliptical surfels.
+ **/
+void Object::fillStore ( int attributes ) {
+  if (store.size() == 0 && !surfels.empty())
+    store.fromSurfels(surfels, attributes);
+  vector<Surfeld>().swap(surfels);
+}
+
+/**
+ * Computes the bounding volumes of the surfels, including the oriented box.
+ **/
+void Object::updateBounds ( void ) {
+  fillStore();
+  bounds.compute(store);
 }
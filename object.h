@@ -10,6 +10,9 @@
 #define __OBJECT_H__
 
 #include "surfel.hpp"
+#include "surfel_store.h"
+#include "surfel_quantizer.h"
+#include "surfel_bounds.h"
 
 #include <iostream>
 #include <fstream>
@@ -34,21 +37,53 @@ typedef Surfel<double> Surfeld;
 typedef vector<Surfeld>::iterator surfelVectorIter;
 typedef vector<Surfeld>::const_iterator surfelVectorIterConst;
 
+/**
+ * Group of surfels rendered together, usually the contents of one file.
+ * An object owns its point arrays and the buffer objects they are
+ * uploaded to, and deletes them when destroyed; it cannot be copied,
+ * so objects are created with new and handled by pointer.
+ **/
 class Object
 {
  public:
   
-  Object() { }
+  Object() : quantized_storage(false) {
+    point_buffers[0] = point_buffers[1] = point_buffers[2] = point_buffers[3] = 0;
+    quantized_buffers[0] = quantized_buffers[1] = 0;
+  }
    
-  Object(int id_num) : id(id_num)  {}
+  Object(int id_num) : id(id_num), quantized_storage(false) {
+    point_buffers[0] = point_buffers[1] = point_buffers[2] = point_buffers[3] = 0;
+    quantized_buffers[0] = quantized_buffers[1] = 0;
+  }
       
   ~Object();
 
-  void render ( void ) const;
+  /**
+   * Generic vertex attributes the surfels are drawn with, bound by the
+   * projection shaders to surfel_position (position and radius, or the
+   * quantized position and normal), surfel_normal, surfel_color,
+   * surfel_axes (see setPyramidPointsArraysElipse), and cluster_origin and
+   * cluster_step (grid and radius range of quantized clusters).
+   **/
+  enum { POSITION_ATTRIBUTE = 0, NORMAL_ATTRIBUTE = 1, COLOR_ATTRIBUTE = 2, AXES_ATTRIBUTE = 3,
+	 CLUSTER_ORIGIN_ATTRIBUTE = 4, CLUSTER_STEP_ATTRIBUTE = 5 };
+
+  /// Clusters by squared distance to a point, with their indices.
+  typedef vector< pair<float, unsigned int> > ClusterOrder;
+
+  void render ( const vector<unsigned char> *skip = NULL, float begin = 0.0f, float end = 1.0f,
+	       const ClusterOrder *order = NULL ) const;
+
+  void sortClusters ( const Point3f &eye, ClusterOrder &order ) const;
 
   vector<Surfeld> * getSurfels ( void ) { return &surfels; }
 
+  SurfelStore * getStore ( void ) { return &store; }
+  const SurfelStore * getStore ( void ) const { return &store; }
+
   void clearSurfels ( void );
+  void fillStore ( int attributes = SurfelStore::NORMAL | SurfelStore::COLOR | SurfelStore::RADIUS );
 
   int getRendererType ( void ) { return renderer_type; }
   void setRendererType ( int type );
@@ -58,14 +93,28 @@ class Object
 
   int numberPoints ( void ) const { return number_points; }
 
+  void quantize ( const Box3f &full_box, float tolerance );
+  void clearQuantization ( void );
+  bool isQuantized ( void ) const { return quantized_storage; }
+
+  const vector<SurfelCluster>& getClusters ( void ) const { return clusters; }
+
+  const SurfelBounds& getBounds ( void ) const { return bounds; }
+  void setBounds ( const SurfelBounds &b ) { bounds = b; }
+  void updateBounds ( void );
+
   Point3f eye;
 
  private:
 
-  void setPyramidPointsDisplayList ( void );
-  void setPyramidPointsColorDisplayList ( void );
+  // not copyable: copies would duplicate the point sets and share the buffer objects
+  Object ( const Object & );
+  Object& operator= ( const Object & );
+
   void setPyramidPointsArrays( void );
   void setPyramidPointsArraysColor( void );
+  void setPyramidPointsArraysElipse( void );
+  void deletePointBuffers ( void );
 
   void normalizeQuality( void );
 
@@ -80,11 +129,29 @@ class Object
   /// Number of samples.
   int number_points;
 
-  GLuint pointsDisplayList;
+  // Full precision arrays: position with radius, normal, color
+  // and, for elliptical surfels, the packed axes.
+  GLuint point_buffers[4];
 
-  // Vector of surfels belonging to this object.
+  // Vector of surfels belonging to this object, filled by the VCG based loaders
+  // and released once converted to the store.
   vector<Surfeld> surfels;
 
+  // Surfel arrays used for rendering.
+  SurfelStore store;
+
+  // Bounding volumes of the store, computed once after loading.
+  SurfelBounds bounds;
+
+  // Spatially coherent ranges of the store, drawn one by one.
+  vector<SurfelCluster> clusters;
+
+  // Compressed copy of the store, uploaded to quantized_buffers
+  // (positions with normals, colors with radii).
+  QuantizedSurfels quantized;
+  GLuint quantized_buffers[2];
+  bool quantized_storage;
+
 };
 
 #endif
@@ -0,0 +1,504 @@
+/*
+** occlusion_culler.cc Occlusion culling of surfel clusters.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "occlusion_culler.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+#include "point_based_renderer.h"
+
+/**
+ * Creates the reduction target and the readback ring.
+ * @param w Canvas width.
+ * @param h Canvas height.
+ * @param texture_w Width of the level 0 textures.
+ * @param texture_h Height of the level 0 textures.
+ * @param block Level 0 pixels per grid cell side.
+ * @param slots Number of grids that may be in flight.
+ **/
+OcclusionCuller::OcclusionCuller(int w, int h, int texture_w, int texture_h, int block, int slots) :
+  width(w), height(h), texture_width(texture_w), texture_height(texture_h), block(block),
+								       grid_valid(false), frame(0), grid_frame(0), camera_set(false),
+								       next_slot(0), pending(0) {
+
+  grid_width = (width + block - 1) / block;
+  grid_height = (height + block - 1) / block;
+  grid.resize(grid_width * grid_height);
+
+  glGenTextures(1, &reduce_texture);
+  glBindTexture(GL_TEXTURE_2D, reduce_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, grid_width, grid_height, 0, GL_RGBA, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffersEXT(1, &reduce_fbo);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, reduce_fbo);
+  glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, reduce_texture, 0);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+  ring.resize(slots);
+  for (int s = 0; s < slots; ++s) {
+    glGenBuffers(1, &ring[s].pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[s].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, grid.size() * sizeof(GLfloat), NULL, GL_STREAM_READ);
+    ring[s].fence = 0;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  bool link;
+
+  ScreenTriangle::loadSources(mShaderReduce, "shaders/shader_occlusion.vert", "shaders/shader_occlusion_reduce.frag");
+  link = mShaderReduce.prog.Link();
+  std::cout << "Occlusion reduce Frag shader info : " << mShaderReduce.fshd.InfoLog() << "\n";
+  assert (link == 1);
+
+  ScreenTriangle::loadSources(mShaderDepth, "shaders/shader_occlusion.vert", "shaders/shader_occlusion_depth.frag");
+  link = mShaderDepth.prog.Link();
+  std::cout << "Occlusion depth Frag shader info : " << mShaderDepth.fshd.InfoLog() << "\n";
+  assert (link == 1);
+
+  mShaderBox.LoadSources("shaders/shader_occlusion_box.vert", "shaders/shader_occlusion_box.frag");
+  glBindAttribLocation(mShaderBox.prog.ObjectID(), box_attribute, "position");
+  link = mShaderBox.prog.Link();
+  std::cout << "Occlusion box Vert shader info : " << mShaderBox.vshd.InfoLog() << "\n";
+  assert (link == 1);
+  box_mvp = glGetUniformLocation(mShaderBox.prog.ObjectID(), "mvp");
+
+  // two triangles per face, corner i has bit k set at the box maximum along axis k
+  static const int faces[6][4] = { {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+				   {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5} };
+  GLubyte indices[36];
+  for (int f = 0; f < 6; ++f) {
+    static const int triangles[6] = {0, 1, 2, 0, 2, 3};
+    for (int v = 0; v < 6; ++v)
+      indices[6*f + v] = faces[f][triangles[v]];
+  }
+  glGenBuffers(1, &box_indices);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, box_indices);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glGenBuffers(1, &box_buffer);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  for (unsigned int s = 0; s < ring.size(); ++s) {
+    if (ring[s].fence)
+      glDeleteSync(ring[s].fence);
+    glDeleteBuffers(1, &ring[s].pbo);
+  }
+  if (!queries.empty())
+    glDeleteQueries(queries.size(), &queries[0]);
+  glDeleteBuffers(1, &box_buffer);
+  glDeleteBuffers(1, &box_indices);
+  glDeleteFramebuffersEXT(1, &reduce_fbo);
+  glDeleteTextures(1, &reduce_texture);
+}
+
+/**
+ * Sets a camera from the given matrices and the current viewport.
+ * @param camera Resulting camera.
+ * @param modelview Column major modelview.
+ * @param projection Column major projection.
+ **/
+void OcclusionCuller::loadCamera ( Camera &camera, const GLdouble modelview[16], const GLdouble projection[16] ) {
+  for (int i = 0; i < 16; ++i) {
+    camera.modelview[i] = modelview[i];
+    camera.projection[i] = projection[i];
+  }
+  glGetIntegerv(GL_VIEWPORT, camera.viewport);
+
+  // column major product projection * modelview
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 4; ++r) {
+      camera.mvp[4*c + r] = 0.0;
+      for (int k = 0; k < 4; ++k)
+	camera.mvp[4*c + r] += camera.projection[4*k + r] * camera.modelview[4*c + k];
+    }
+}
+
+/**
+ * Starts a new frame, the camera is read again by the next cull.
+ **/
+void OcclusionCuller::beginFrame ( void ) {
+  entries.clear();
+  camera_set = false;
+  ++frame;
+}
+
+/**
+ * Corners of the cluster box, grown by its largest splat radius.
+ **/
+void OcclusionCuller::clusterCorners ( const SurfelCluster &c, float radius_scale, GLdouble corners[8][3] ) const {
+  double margin = c.max_radius * radius_scale;
+  for (int i = 0; i < 8; ++i)
+    for (int k = 0; k < 3; ++k)
+      corners[i][k] = (i & (1 << k)) ? c.box_max[k] + margin : c.box_min[k] - margin;
+}
+
+static inline void transform ( const GLdouble m[16], const GLdouble p[3], GLdouble out[4] ) {
+  for (int r = 0; r < 4; ++r)
+    out[r] = m[r]*p[0] + m[4 + r]*p[1] + m[8 + r]*p[2] + m[12 + r];
+}
+
+/**
+ * Tests if all corners lie outside the same clipping plane of the current camera.
+ **/
+bool OcclusionCuller::outsideFrustum ( const GLdouble corners[8][3] ) const {
+  int outside[6] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < 8; ++i) {
+    GLdouble clip[4];
+    transform(camera.mvp, corners[i], clip);
+    for (int k = 0; k < 3; ++k) {
+      outside[2*k] += clip[k] < -clip[3];
+      outside[2*k + 1] += clip[k] > clip[3];
+    }
+  }
+  for (int p = 0; p < 6; ++p)
+    if (outside[p] == 8)
+      return true;
+  return false;
+}
+
+/**
+ * Tests if the box crosses the near plane of the current camera, where
+ * a box query cannot tell if it is hidden.
+ **/
+bool OcclusionCuller::crossesEyePlane ( const GLdouble corners[8][3] ) const {
+  for (int i = 0; i < 8; ++i) {
+    GLdouble clip[4];
+    transform(camera.mvp, corners[i], clip);
+    if (clip[3] <= 0.0 || clip[2] < -clip[3])
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Tests the box against the depth grid of an older frame.
+ * The box is hidden if its nearest point is farther than the grid depth
+ * in every cell covered by its screen rectangle.
+ * Boxes crossing the eye plane or the borders of the old view are never hidden.
+ **/
+bool OcclusionCuller::behindGrid ( const GLdouble corners[8][3] ) const {
+
+  const GLint *viewport = grid_camera.viewport;
+  double x0 = HUGE_VAL, y0 = HUGE_VAL, x1 = -HUGE_VAL, y1 = -HUGE_VAL, nearest = HUGE_VAL;
+
+  for (int i = 0; i < 8; ++i) {
+    GLdouble clip[4], eye[4];
+    transform(grid_camera.mvp, corners[i], clip);
+    transform(grid_camera.modelview, corners[i], eye);
+    if (clip[3] <= 0.0 || eye[2] >= 0.0)
+      return false;
+    double x = viewport[0] + (clip[0] / clip[3] * 0.5 + 0.5) * viewport[2];
+    double y = viewport[1] + (clip[1] / clip[3] * 0.5 + 0.5) * viewport[3];
+    x0 = std::min(x0, x); x1 = std::max(x1, x);
+    y0 = std::min(y0, y); y1 = std::max(y1, y);
+    nearest = std::min(nearest, -eye[2]);
+  }
+
+  int i0 = (int)floor(x0 / block), i1 = (int)floor(x1 / block);
+  int j0 = (int)floor(y0 / block), j1 = (int)floor(y1 / block);
+  if (i0 < 0 || j0 < 0 || i1 >= grid_width || j1 >= grid_height)
+    return false;
+
+  for (int j = j0; j <= j1; ++j)
+    for (int i = i0; i <= i1; ++i) {
+      float depth = grid[j*grid_width + i];
+      if (depth < 0.0f || depth >= nearest)
+	return false;
+    }
+  return true;
+}
+
+/**
+ * Classifies the clusters of an object for the current frame.
+ * The camera is taken at the first call of each frame, when the box
+ * queries of earlier frames are also collected.
+ * Clusters revealed by a query after the newest grid was captured stay
+ * visible, as do boxes crossing the near plane.
+ * @param obj Object about to be projected.
+ * @param radius_scale Factor from surfel radius to the largest splat extent.
+ * @param modelview Column major modelview of the frame.
+ * @param projection Column major projection of the frame.
+ * @return Per cluster state (VISIBLE, OUTSIDE or OCCLUDED), valid until the next call.
+ **/
+const std::vector<unsigned char>& OcclusionCuller::cull ( const Object * obj, float radius_scale,
+							 const GLdouble modelview[16], const GLdouble projection[16] ) {
+
+  if (!camera_set) {
+    loadCamera(camera, modelview, projection);
+    camera_set = true;
+    poll();
+    readQueries();
+  }
+
+  entries.push_back(Entry());
+  Entry &entry = entries.back();
+  entry.object = obj;
+
+  const std::vector<SurfelCluster> &clusters = obj->getClusters();
+  entry.state.resize(clusters.size());
+
+  // whole object outside the view
+  const SurfelBounds &bounds = obj->getBounds();
+  if (!bounds.empty()) {
+    float object_corners[8][3];
+    GLdouble corners[8][3];
+    bounds.corners(bounds.max_radius * radius_scale, object_corners);
+    for (int i = 0; i < 8; ++i)
+      for (int k = 0; k < 3; ++k)
+	corners[i][k] = object_corners[i][k];
+    if (outsideFrustum(corners)) {
+      std::fill(entry.state.begin(), entry.state.end(), (unsigned char)OUTSIDE);
+      return entry.state;
+    }
+  }
+
+  std::map<const Object*, std::vector<unsigned int> >::const_iterator found = revealed_frame.find(obj);
+  const std::vector<unsigned int> *revealed = found != revealed_frame.end() ? &found->second : NULL;
+
+#pragma omp parallel for schedule(dynamic, 64)
+  for (long c = 0; c < (long)clusters.size(); ++c) {
+    GLdouble corners[8][3];
+    clusterCorners(clusters[c], radius_scale, corners);
+    bool recent = revealed && c < (long)revealed->size() && (*revealed)[c] > grid_frame;
+    if (outsideFrustum(corners))
+      entry.state[c] = OUTSIDE;
+    else if (grid_valid && !recent && !crossesEyePlane(corners) && behindGrid(corners))
+      entry.state[c] = OCCLUDED;
+    else
+      entry.state[c] = VISIBLE;
+  }
+
+  return entry.state;
+}
+
+/**
+ * Draws the faces of a tested box, from its corners in the box buffer.
+ * The box shader and the box buffers must be bound.
+ **/
+void OcclusionCuller::drawBox ( int box ) const {
+  glVertexAttribPointer(box_attribute, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)(box * 24 * sizeof(GLfloat)));
+  glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+}
+
+/**
+ * Second pass for clusters that were hidden in the grid.
+ * Writes the reconstructed depth into the depth buffer of the given
+ * framebuffer and draws the boxes of the occluded clusters with occlusion
+ * queries, which are read by the next frames (see readQueries).
+ * Nothing is issued while the queries of an earlier frame are in flight.
+ * @param fbo Framebuffer with the level 0 depth buffer.
+ * @param depth_texture Reconstructed (depth, depth range, x, y) texture.
+ * @param radius_scale Factor from surfel radius to the largest splat extent.
+ **/
+void OcclusionCuller::testOccluded ( GLuint fbo, GLuint depth_texture, float radius_scale ) {
+
+  if (!box_queries.empty())
+    return;
+
+  std::vector<std::pair<int, int> > tested;
+  for (unsigned int e = 0; e < entries.size(); ++e)
+    for (unsigned int c = 0; c < entries[e].state.size(); ++c)
+      if (entries[e].state[c] == OCCLUDED)
+	tested.push_back(std::make_pair(e, c));
+
+  if (tested.empty())
+    return;
+
+  if (queries.size() < tested.size()) {
+    size_t old_size = queries.size();
+    queries.resize(tested.size());
+    glGenQueries(queries.size() - old_size, &queries[old_size]);
+  }
+
+  glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT | GL_VIEWPORT_BIT | GL_SCISSOR_BIT);
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_ALWAYS);
+
+  /// Replace the sparse depth of the projected points by the reconstructed depth,
+  /// over the whole texture so that the texture coordinates match, inside the view
+  glViewport(0, 0, texture_width, texture_height);
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(camera.viewport[0], camera.viewport[1], camera.viewport[2], camera.viewport[3]);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, depth_texture);
+
+  mShaderDepth.prog.Bind();
+  mShaderDepth.prog.Uniform("textureB", 0);
+  mShaderDepth.prog.Uniform("depth_params", (GLfloat)camera.projection[10], (GLfloat)camera.projection[14]);
+  screen_triangle.draw();
+  mShaderDepth.prog.Unbind();
+  glDisable(GL_SCISSOR_TEST);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  /// Query the cluster boxes against it, with the camera of the frame
+  glViewport(camera.viewport[0], camera.viewport[1], camera.viewport[2], camera.viewport[3]);
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_LEQUAL);
+  glDisable(GL_CULL_FACE);
+
+  std::vector<GLfloat> box_corners (24 * tested.size());
+  for (unsigned int t = 0; t < tested.size(); ++t) {
+    const SurfelCluster &c = entries[tested[t].first].object->getClusters()[tested[t].second];
+    GLdouble corners[8][3];
+    clusterCorners(c, radius_scale, corners);
+    for (int i = 0; i < 8; ++i)
+      for (int k = 0; k < 3; ++k)
+	box_corners[24*t + 3*i + k] = corners[i][k];
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, box_buffer);
+  glBufferData(GL_ARRAY_BUFFER, box_corners.size() * sizeof(GLfloat), &box_corners[0], GL_STREAM_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, box_indices);
+  glEnableVertexAttribArray(box_attribute);
+
+  GLfloat mvp[16];
+  for (int k = 0; k < 16; ++k)
+    mvp[k] = camera.mvp[k];
+  mShaderBox.prog.Bind();
+  glUniformMatrix4fv(box_mvp, 1, GL_FALSE, mvp);
+
+  box_queries.resize(tested.size());
+  for (unsigned int t = 0; t < tested.size(); ++t) {
+    glBeginQuery(GL_SAMPLES_PASSED, queries[t]);
+    drawBox(t);
+    glEndQuery(GL_SAMPLES_PASSED);
+    box_queries[t].object = entries[tested[t].first].object;
+    box_queries[t].cluster = tested[t].second;
+    box_queries[t].query = queries[t];
+  }
+
+  mShaderBox.prog.Unbind();
+  glDisableVertexAttribArray(box_attribute);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glPopAttrib();
+
+  check_for_ogl_error("occlusion queries");
+}
+
+/**
+ * Collects the box queries of an earlier frame if they are available,
+ * without waiting; the clusters whose box passed are marked revealed in
+ * the current frame. Queries complete in order, so the last one tells.
+ **/
+void OcclusionCuller::readQueries ( void ) {
+
+  if (box_queries.empty())
+    return;
+
+  GLuint available = 0;
+  glGetQueryObjectuiv(box_queries.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  for (unsigned int t = 0; t < box_queries.size(); ++t) {
+    GLuint samples = 0;
+    glGetQueryObjectuiv(box_queries[t].query, GL_QUERY_RESULT, &samples);
+    if (samples == 0)
+      continue;
+    std::vector<unsigned int> &revealed = revealed_frame[box_queries[t].object];
+    if (revealed.size() <= box_queries[t].cluster)
+      revealed.resize(box_queries[t].cluster + 1, 0);
+    revealed[box_queries[t].cluster] = frame;
+  }
+  box_queries.clear();
+}
+
+/**
+ * Reduces the reconstructed depth to the occluder grid and queues its
+ * asynchronous readback with the camera of the current frame.
+ * If all slots are still in flight the frame is not captured, so this never blocks.
+ * @param depth_texture Reconstructed (depth, depth range, x, y) texture.
+ **/
+void OcclusionCuller::capture ( GLuint depth_texture ) {
+
+  poll();
+  if (!camera_set || pending == (int)ring.size())
+    return;
+
+  glPushAttrib(GL_VIEWPORT_BIT);
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, reduce_fbo);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+  glViewport(0, 0, grid_width, grid_height);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, depth_texture);
+
+  mShaderReduce.prog.Bind();
+  mShaderReduce.prog.Uniform("textureB", 0);
+  mShaderReduce.prog.Uniform("block", (GLint)block);
+  mShaderReduce.prog.Uniform("pixel_size", (GLfloat)(1.0 / texture_width), (GLfloat)(1.0 / texture_height));
+  mShaderReduce.prog.Uniform("canvas_size", (GLfloat)width, (GLfloat)height);
+  screen_triangle.draw();
+  mShaderReduce.prog.Unbind();
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  Slot &slot = ring[next_slot];
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+  glReadPixels(0, 0, grid_width, grid_height, GL_RED, GL_FLOAT, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.camera = camera;
+  slot.frame = frame;
+  next_slot = (next_slot + 1) % ring.size();
+  ++pending;
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glDrawBuffer(GL_BACK);
+  glReadBuffer(GL_BACK);
+
+  glPopAttrib();
+
+  check_for_ogl_error("occlusion capture");
+}
+
+/**
+ * Takes every grid whose fence has signaled, keeping the newest one.
+ * Never blocks.
+ **/
+void OcclusionCuller::poll ( void ) {
+  while (pending > 0) {
+    Slot &oldest = ring[(next_slot + ring.size() - pending) % ring.size()];
+    GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync(oldest.fence);
+    oldest.fence = 0;
+    --pending;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest.pbo);
+    const GLfloat *data = (const GLfloat*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (data) {
+      memcpy(&grid[0], data, grid.size() * sizeof(GLfloat));
+      grid_camera = oldest.camera;
+      grid_frame = oldest.frame;
+      grid_valid = true;
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+}
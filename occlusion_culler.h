@@ -0,0 +1,150 @@
+/*
+** occlusion_culler.h Occlusion culling of surfel clusters header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __OCCLUSION_CULLER_H__
+#define __OCCLUSION_CULLER_H__
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <map>
+
+#include "object.h"
+#include "screen_triangle.h"
+
+/**
+ * Skips surfel clusters hidden behind the surface reconstructed in
+ * previous frames.
+ *
+ * After each frame the reconstructed level 0 depth is reduced on the GPU
+ * to a coarse grid holding the farthest depth of each block of pixels,
+ * and read back asynchronously together with the camera of that frame.
+ * Before projection, every cluster box (grown by its largest radius) is
+ * tested on the CPU against the newest grid that has arrived: a cluster
+ * is culled when it lies completely behind the grid in all blocks it
+ * covers, or when it lies outside the current view frustum.
+ *
+ * Since the grid comes from an older camera, clusters may become visible
+ * without having been projected. After the pyramid has been reconstructed,
+ * the occluded clusters' boxes are tested with occlusion queries against
+ * the depth of the current reconstruction. The results are read in the
+ * next frame, once available, so the pipeline never stalls: clusters
+ * whose box passed are projected from then on, until a grid that includes
+ * them arrives. A disoccluded cluster thus shows up one frame late.
+ **/
+class OcclusionCuller
+{
+ public:
+
+  /// Per cluster culling state.
+  enum { VISIBLE = 0, OUTSIDE = 1, OCCLUDED = 2 };
+
+  OcclusionCuller(int w, int h, int texture_w, int texture_h, int block = 8, int slots = 3);
+  ~OcclusionCuller();
+
+  void beginFrame ( void );
+
+  const std::vector<unsigned char>& cull ( const Object * obj, float radius_scale,
+					   const GLdouble modelview[16], const GLdouble projection[16] );
+
+  void testOccluded ( GLuint fbo, GLuint depth_texture, float radius_scale );
+
+  void capture ( GLuint depth_texture );
+
+ private:
+
+  /// Camera of a frame: modelview, projection and viewport.
+  struct Camera {
+    GLdouble modelview[16];
+    GLdouble projection[16];
+    GLint viewport[4];
+    /// Product projection * modelview.
+    GLdouble mvp[16];
+  };
+
+  struct Entry {
+    const Object *object;
+    std::vector<unsigned char> state;
+  };
+
+  struct Slot {
+    GLuint pbo;
+    GLsync fence;
+    Camera camera;
+    unsigned int frame;
+  };
+
+  /// Box query of an occluded cluster, read in a later frame.
+  struct BoxQuery {
+    const Object *object;
+    unsigned int cluster;
+    GLuint query;
+  };
+
+  static void loadCamera ( Camera &camera, const GLdouble modelview[16], const GLdouble projection[16] );
+
+  void clusterCorners ( const SurfelCluster &c, float radius_scale, GLdouble corners[8][3] ) const;
+  bool outsideFrustum ( const GLdouble corners[8][3] ) const;
+  bool crossesEyePlane ( const GLdouble corners[8][3] ) const;
+  bool behindGrid ( const GLdouble corners[8][3] ) const;
+  void drawBox ( int box ) const;
+
+  void poll ( void );
+
+  void readQueries ( void );
+
+  int width, height;
+
+  /// Size of the level 0 textures, the canvas and its padding.
+  int texture_width, texture_height;
+
+  /// Level 0 pixels per grid cell side, and grid size.
+  int block;
+  int grid_width, grid_height;
+
+  /// Farthest depth per cell (negative where background shows through).
+  std::vector<float> grid;
+  Camera grid_camera;
+  bool grid_valid;
+
+  /// Current frame, and the frame the newest grid was captured in.
+  unsigned int frame, grid_frame;
+
+  /// Camera of the current frame.
+  Camera camera;
+  bool camera_set;
+
+  std::vector<Entry> entries;
+
+  /// Reduction target and its readback ring.
+  GLuint reduce_fbo, reduce_texture;
+  std::vector<Slot> ring;
+  int next_slot;
+  int pending;
+
+  /// Query pool, and the queries issued but not read yet.
+  std::vector<GLuint> queries;
+  std::vector<BoxQuery> box_queries;
+
+  /// Per object, frame each cluster was last revealed by a query (0 never).
+  std::map<const Object*, std::vector<unsigned int> > revealed_frame;
+
+  /// Corners of the tested boxes, and the triangles of a box over its 8 corners.
+  GLuint box_buffer, box_indices;
+
+  /// Generic vertex attribute of the box corners, and location of the box camera.
+  static const GLuint box_attribute = 0;
+  GLint box_mvp;
+
+  ProgramVF mShaderReduce;
+  ProgramVF mShaderDepth;
+  ProgramVF mShaderBox;
+  ScreenTriangle screen_triangle;
+};
+
+#endif
@@ -0,0 +1,728 @@
+/*
+** ply_reader.cc Fast PLY reader.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "ply_reader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::string;
+
+/// Number of records decoded per chunk, small enough for a chunk to stay in cache
+/// while all of its columns are decoded.
+static const size_t chunk_records = 4096;
+
+/// Minimum size in bytes of the newline aligned chunks of ASCII bodies.
+static const size_t ascii_chunk_bytes = 1 << 20;
+
+/**
+ * Reads a value of type T from possibly unaligned memory.
+ **/
+template <class T> static inline T loadValue ( const char *p ) {
+  T v;
+  memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <class T> static inline T swapBytes ( T v ) {
+  char b[sizeof(T)];
+  memcpy(b, &v, sizeof(T));
+  std::reverse(b, b + sizeof(T));
+  memcpy(&v, b, sizeof(T));
+  return v;
+}
+
+/**
+ * Clamps a value to a color byte. Float colors are taken by value,
+ * as the surfel loader of IOSurfels does.
+ **/
+template <class T> static inline unsigned char toByte ( T v ) {
+  double c = (double)v;
+  c = c < 0.0 ? 0.0 : (c > 255.0 ? 255.0 : c);
+  return (unsigned char)(c + 0.5);
+}
+
+/**
+ * Column decoder into a float array, type and byte order fixed at compile time.
+ **/
+template <class T, bool swap>
+static void decodeFloat ( const char *src, size_t record_size, size_t n, void *dst, int dst_stride ) {
+  float *out = (float*)dst;
+  for (size_t i = 0; i < n; ++i, src += record_size, out += dst_stride) {
+    T v = loadValue<T>(src);
+    if (swap)
+      v = swapBytes(v);
+    *out = (float)v;
+  }
+}
+
+/**
+ * Column decoder into a color byte array.
+ **/
+template <class T, bool swap>
+static void decodeByte ( const char *src, size_t record_size, size_t n, void *dst, int dst_stride ) {
+  unsigned char *out = (unsigned char*)dst;
+  for (size_t i = 0; i < n; ++i, src += record_size, out += dst_stride) {
+    T v = loadValue<T>(src);
+    if (swap)
+      v = swapBytes(v);
+    *out = toByte(v);
+  }
+}
+
+/// Decoders indexed by [byte destination][swap][type].
+typedef void (*Decoder) ( const char *, size_t, size_t, void *, int );
+static const Decoder decoders[2][2][8] = {
+  { { decodeFloat<signed char, false>, decodeFloat<unsigned char, false>,
+      decodeFloat<short, false>, decodeFloat<unsigned short, false>,
+      decodeFloat<int, false>, decodeFloat<unsigned int, false>,
+      decodeFloat<float, false>, decodeFloat<double, false> },
+    { decodeFloat<signed char, true>, decodeFloat<unsigned char, true>,
+      decodeFloat<short, true>, decodeFloat<unsigned short, true>,
+      decodeFloat<int, true>, decodeFloat<unsigned int, true>,
+      decodeFloat<float, true>, decodeFloat<double, true> } },
+  { { decodeByte<signed char, false>, decodeByte<unsigned char, false>,
+      decodeByte<short, false>, decodeByte<unsigned short, false>,
+      decodeByte<int, false>, decodeByte<unsigned int, false>,
+      decodeByte<float, false>, decodeByte<double, false> },
+    { decodeByte<signed char, true>, decodeByte<unsigned char, true>,
+      decodeByte<short, true>, decodeByte<unsigned short, true>,
+      decodeByte<int, true>, decodeByte<unsigned int, true>,
+      decodeByte<float, true>, decodeByte<double, true> } }
+};
+
+static bool hostLittleEndian ( void ) {
+  const unsigned int one = 1;
+  return *(const unsigned char*)&one == 1;
+}
+
+static inline bool isSpace ( char c ) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * Tests whether the 8 bytes at p are all decimal digits.
+ **/
+static inline bool eightDigits ( unsigned long long v ) {
+  return ((v & 0xF0F0F0F0F0F0F0F0ULL) == 0x3030303030303030ULL) &&
+    (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) == 0x3030303030303030ULL);
+}
+
+/**
+ * Converts 8 ASCII digits loaded little endian into their value,
+ * combining pairs, then quads, then the two halves with multiplications.
+ **/
+static inline unsigned int parseEightDigits ( unsigned long long v ) {
+  v -= 0x3030303030303030ULL;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+       (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+  return (unsigned int)v;
+}
+
+/**
+ * Accumulates a run of digits into the mantissa, eight at a time when possible.
+ * Digits that no longer fit are dropped and counted in dropped.
+ * @return Number of digits consumed.
+ **/
+static inline int parseDigits ( const char *&p, const char *end, unsigned long long &mantissa,
+				int &dropped, bool swar ) {
+  const char *start = p;
+  while (swar && end - p >= 8 && mantissa < 10000000000ULL) {
+    unsigned long long v;
+    memcpy(&v, p, 8);
+    if (!eightDigits(v))
+      break;
+    mantissa = mantissa * 100000000ULL + parseEightDigits(v);
+    p += 8;
+  }
+  for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+    if (mantissa < 100000000000000000ULL)
+      mantissa = mantissa * 10 + (*p - '0');
+    else
+      ++dropped;
+  }
+  return p - start;
+}
+
+/**
+ * Parses one ASCII number, never reading past end.
+ * @param p Current position, advanced past the number.
+ * @param end End of the data.
+ * @param v Parsed value.
+ * @return False if no number could be parsed.
+ **/
+static bool parseNumber ( const char *&p, const char *end, double &v ) {
+  static const bool swar = hostLittleEndian();
+
+  while (p < end && isSpace(*p))
+    ++p;
+  if (p == end)
+    return false;
+
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  unsigned long long mantissa = 0;
+  int dropped = 0, exponent = 0;
+  int digits = parseDigits(p, end, mantissa, dropped, swar);
+  exponent += dropped;
+  if (p < end && *p == '.') {
+    ++p;
+    dropped = 0;
+    int fraction = parseDigits(p, end, mantissa, dropped, swar);
+    exponent -= fraction - dropped;
+    digits += fraction;
+  }
+  if (digits == 0)
+    return false;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exp = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative_exp = (*p == '-');
+      ++p;
+    }
+    int e = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+      if (e < 10000)
+	e = e * 10 + (*p - '0');
+    exponent += negative_exp ? -e : e;
+  }
+
+  if (p < end && !isSpace(*p))
+    return false;
+
+  static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+				  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  double scale = 1.0;
+  int e = exponent < 0 ? -exponent : exponent;
+  if (e <= 22)
+    scale = powers[e];
+  else
+    for (double base = 10.0; e; e >>= 1, base *= base)
+      if (e & 1)
+	scale *= base;
+  v = exponent < 0 ? mantissa / scale : mantissa * scale;
+  if (negative)
+    v = -v;
+  return true;
+}
+
+PlyReader::PlyReader() : data(NULL), length(0), mapped(false),
+			 format(ASCII), body(0), target(-1), record_size(0) {
+}
+
+PlyReader::~PlyReader() {
+  close();
+}
+
+/**
+ * Maps the file and parses its header.
+ * @param filename Given file name.
+ * @return False if the file could not be opened or is not a supported PLY.
+ **/
+bool PlyReader::open ( const char * filename ) {
+
+  close();
+
+#ifndef _WIN32
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    error_msg = string("cannot open ") + filename;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      data = (const char*)p;
+      length = st.st_size;
+      mapped = true;
+    }
+  }
+  ::close(fd);
+#endif
+
+  // no mapping available, read the whole file with one large read
+  if (!mapped) {
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+      error_msg = string("cannot open ") + filename;
+      return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buffer.resize(size > 0 ? size : 0);
+    size_t got = size > 0 ? fread(&buffer[0], 1, size, fp) : 0;
+    fclose(fp);
+    buffer.resize(got);
+    data = buffer.empty() ? NULL : &buffer[0];
+    length = got;
+  }
+
+  return parseHeader();
+}
+
+/**
+ * Releases the mapping.
+ **/
+void PlyReader::close ( void ) {
+#ifndef _WIN32
+  if (mapped)
+    munmap((void*)data, length);
+#endif
+  std::vector<char>().swap(buffer);
+  data = NULL;
+  length = 0;
+  mapped = false;
+  elements.clear();
+  plan.clear();
+  target = -1;
+}
+
+int PlyReader::typeFromName ( const string &name ) {
+  if (name == "char" || name == "int8") return T_INT8;
+  if (name == "uchar" || name == "uint8") return T_UINT8;
+  if (name == "short" || name == "int16") return T_INT16;
+  if (name == "ushort" || name == "uint16") return T_UINT16;
+  if (name == "int" || name == "int32") return T_INT32;
+  if (name == "uint" || name == "uint32") return T_UINT32;
+  if (name == "float" || name == "float32") return T_FLOAT32;
+  if (name == "double" || name == "float64") return T_FLOAT64;
+  return T_NONE;
+}
+
+int PlyReader::typeSize ( int type ) {
+  static const int sizes[8] = {1, 1, 2, 2, 4, 4, 4, 8};
+  return sizes[type];
+}
+
+/**
+ * Parses the header: format, elements and their properties.
+ * The target element is the first "vertex" or "surfel" element.
+ * @return False on malformed or unsupported headers.
+ **/
+bool PlyReader::parseHeader ( void ) {
+
+  if (length < 4 || strncmp(data, "ply", 3) != 0) {
+    error_msg = "not a ply file";
+    return false;
+  }
+
+  const char *p = data;
+  const char *end = data + length;
+  bool has_format = false;
+
+  while (p < end) {
+    const char *eol = (const char*)memchr(p, '\n', end - p);
+    if (eol == NULL) {
+      error_msg = "unterminated header";
+      return false;
+    }
+    std::istringstream line (string(p, eol - p));
+    p = eol + 1;
+
+    string keyword;
+    line >> keyword;
+
+    if (keyword == "format") {
+      string f;
+      line >> f;
+      if (f == "ascii") format = ASCII;
+      else if (f == "binary_little_endian") format = BINARY_LITTLE_ENDIAN;
+      else if (f == "binary_big_endian") format = BINARY_BIG_ENDIAN;
+      else {
+	error_msg = "unknown format " + f;
+	return false;
+      }
+      has_format = true;
+    }
+    else if (keyword == "element") {
+      Element e;
+      line >> e.name >> e.count;
+      elements.push_back(e);
+    }
+    else if (keyword == "property") {
+      if (elements.empty()) {
+	error_msg = "property outside of an element";
+	return false;
+      }
+      Property prop;
+      string type;
+      line >> type;
+      prop.list = (type == "list");
+      prop.count_type = T_NONE;
+      if (prop.list) {
+	string count_type;
+	line >> count_type >> type;
+	prop.count_type = typeFromName(count_type);
+      }
+      prop.type = typeFromName(type);
+      line >> prop.name;
+      if (prop.type == T_NONE || (prop.list && prop.count_type == T_NONE)) {
+	error_msg = "unknown type of property " + prop.name;
+	return false;
+      }
+      elements.back().props.push_back(prop);
+    }
+    else if (keyword == "end_header") {
+      body = p - data;
+      break;
+    }
+  }
+
+  if (!has_format || body == 0) {
+    error_msg = "incomplete header";
+    return false;
+  }
+
+  for (unsigned int i = 0; i < elements.size() && target < 0; ++i)
+    if (elements[i].name == "vertex" || elements[i].name == "surfel")
+      target = i;
+
+  if (target < 0) {
+    error_msg = "no vertex or surfel element";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Builds the decoding plan for the target element and allocates the store.
+ * Each used property gets one or more operations with its offset inside
+ * the record and a decoder specialised for its type and byte order.
+ * @param store Store to be filled.
+ * @return False if the element cannot be decoded (list properties).
+ **/
+bool PlyReader::buildPlan ( SurfelStore &store ) {
+
+  enum { POSITION, NORMAL, RADIUS, COLOR, MAJOR, MINOR, ERROR };
+
+  struct Mapping {
+    const char *name;
+    int attribute;
+    int array;
+    int component;
+  };
+
+  static const Mapping mappings[] = {
+    {"x", 0, POSITION, 0}, {"y", 0, POSITION, 1}, {"z", 0, POSITION, 2},
+    {"cx", 0, POSITION, 0}, {"cy", 0, POSITION, 1}, {"cz", 0, POSITION, 2},
+    {"nx", SurfelStore::NORMAL, NORMAL, 0},
+    {"ny", SurfelStore::NORMAL, NORMAL, 1},
+    {"nz", SurfelStore::NORMAL, NORMAL, 2},
+    {"radius", SurfelStore::RADIUS, RADIUS, 0},
+    {"major_axis_size", SurfelStore::RADIUS, RADIUS, 0},
+    {"red", SurfelStore::COLOR, COLOR, 0}, {"green", SurfelStore::COLOR, COLOR, 1},
+    {"blue", SurfelStore::COLOR, COLOR, 2}, {"alpha", SurfelStore::COLOR, COLOR, 3},
+    {"r", SurfelStore::COLOR, COLOR, 0}, {"g", SurfelStore::COLOR, COLOR, 1},
+    {"b", SurfelStore::COLOR, COLOR, 2},
+    {"major_axisx", SurfelStore::AXES, MAJOR, 0}, {"major_axisy", SurfelStore::AXES, MAJOR, 1},
+    {"major_axisz", SurfelStore::AXES, MAJOR, 2}, {"major_axis_size", SurfelStore::AXES, MAJOR, 3},
+    {"minor_axisx", SurfelStore::AXES, MINOR, 0}, {"minor_axisy", SurfelStore::AXES, MINOR, 1},
+    {"minor_axisz", SurfelStore::AXES, MINOR, 2}, {"minor_axis_size", SurfelStore::AXES, MINOR, 3},
+    {"max_error", SurfelStore::ERRORS, ERROR, 0}, {"min_error", SurfelStore::ERRORS, ERROR, 1}
+  };
+  const int num_mappings = sizeof(mappings) / sizeof(Mapping);
+
+  const Element &element = elements[target];
+
+  // first pass: attributes present and record layout
+  int attributes = 0;
+  int found_position = 0;
+  record_size = 0;
+  for (unsigned int i = 0; i < element.props.size(); ++i) {
+    const Property &prop = element.props[i];
+    if (prop.list) {
+      error_msg = "list property " + prop.name + " in " + element.name;
+      return false;
+    }
+    record_size += typeSize(prop.type);
+    for (int m = 0; m < num_mappings; ++m)
+      if (prop.name == mappings[m].name) {
+	attributes |= mappings[m].attribute;
+	if (mappings[m].array == POSITION)
+	  ++found_position;
+      }
+  }
+
+  if (found_position < 3) {
+    error_msg = "missing position properties";
+    return false;
+  }
+
+  store.resize(element.count, attributes);
+
+  // second pass: one operation per (property, destination)
+  bool swap = (format == BINARY_LITTLE_ENDIAN) != hostLittleEndian();
+  size_t offset = 0;
+  plan.clear();
+  for (unsigned int i = 0; i < element.props.size(); ++i) {
+    const Property &prop = element.props[i];
+    for (int m = 0; m < num_mappings; ++m) {
+      if (prop.name != mappings[m].name)
+	continue;
+
+      Op op;
+      op.property = i;
+      op.offset = offset;
+      op.component = mappings[m].component;
+      op.dst_byte = NULL;
+      op.dst = NULL;
+      switch (mappings[m].array) {
+      case POSITION: op.dst = &store.position[0]; op.dst_stride = 3; break;
+      case NORMAL: op.dst = &store.normal[0]; op.dst_stride = 3; break;
+      case RADIUS: op.dst = &store.radius[0]; op.dst_stride = 1; break;
+      case COLOR: op.dst_byte = &store.color[0]; op.dst_stride = 4; break;
+      case MAJOR: op.dst = &store.major_axis[0]; op.dst_stride = 4; break;
+      case MINOR: op.dst = &store.minor_axis[0]; op.dst_stride = 4; break;
+      case ERROR: op.dst = &store.error[0]; op.dst_stride = 2; break;
+      }
+      op.decode = decoders[op.dst_byte != NULL][swap][prop.type];
+      plan.push_back(op);
+    }
+    offset += typeSize(prop.type);
+  }
+
+  return true;
+}
+
+/**
+ * Advances past all elements that precede the target one.
+ * Fixed size binary elements are skipped at once, elements with list
+ * properties are walked record by record.
+ * @param p Start of the body, returned at the start of the target element.
+ * @return False if the file ends early.
+ **/
+bool PlyReader::skipTo ( const char *&p ) {
+
+  const char *end = data + length;
+  bool swap = (format == BINARY_LITTLE_ENDIAN) != hostLittleEndian();
+
+  for (int i = 0; i < target; ++i) {
+    const Element &element = elements[i];
+
+    if (format == ASCII) {
+      double v;
+      for (size_t r = 0; r < element.count; ++r)
+	for (unsigned int k = 0; k < element.props.size(); ++k) {
+	  if (!parseNumber(p, end, v))
+	    return false;
+	  if (element.props[k].list)
+	    for (int c = (int)v; c > 0; --c)
+	      if (!parseNumber(p, end, v))
+		return false;
+	}
+      continue;
+    }
+
+    bool fixed = true;
+    size_t size = 0;
+    for (unsigned int k = 0; k < element.props.size(); ++k) {
+      fixed = fixed && !element.props[k].list;
+      size += typeSize(element.props[k].type);
+    }
+
+    if (fixed) {
+      if ((size_t)(end - p) < size * element.count)
+	return false;
+      p += size * element.count;
+      continue;
+    }
+
+    for (size_t r = 0; r < element.count; ++r)
+      for (unsigned int k = 0; k < element.props.size(); ++k) {
+	const Property &prop = element.props[k];
+	if (!prop.list) {
+	  p += typeSize(prop.type);
+	  continue;
+	}
+	if (p + typeSize(prop.count_type) > end)
+	  return false;
+	float c;
+	decoders[0][swap][prop.count_type](p, 0, 1, &c, 1);
+	p += typeSize(prop.count_type) + (size_t)c * typeSize(prop.type);
+      }
+    if (p > end)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Decodes the target element into the store.
+ * @param store Store to be filled, resized to the number of surfels.
+ * @return Number of surfels read, -1 on error (see error()).
+ **/
+long PlyReader::read ( SurfelStore &store ) {
+
+  if (target < 0) {
+    if (error_msg.empty())
+      error_msg = "no file open";
+    return -1;
+  }
+
+  if (!buildPlan(store))
+    return -1;
+
+  const char *p = data + body;
+  if (!skipTo(p)) {
+    error_msg = "file ends before the " + elements[target].name + " element";
+    store.clear();
+    return -1;
+  }
+
+  long n = (format == ASCII) ? readAscii(p) : readBinary(p);
+  if (n < 0)
+    store.clear();
+  return n;
+}
+
+/**
+ * Decodes binary records in parallel chunks, column by column.
+ * @param p Start of the target element.
+ **/
+long PlyReader::readBinary ( const char *p ) {
+
+  const size_t n = elements[target].count;
+  if ((size_t)(data + length - p) < n * record_size) {
+    error_msg = "file is truncated";
+    return -1;
+  }
+
+  const long chunks = (n + chunk_records - 1) / chunk_records;
+
+#pragma omp parallel for schedule(dynamic, 16)
+  for (long c = 0; c < chunks; ++c) {
+    size_t first = c * chunk_records;
+    size_t m = std::min(chunk_records, n - first);
+    const char *src = p + first * record_size;
+    for (unsigned int k = 0; k < plan.size(); ++k) {
+      const Op &op = plan[k];
+      void *dst = op.dst_byte ? (void*)(op.dst_byte + first * op.dst_stride + op.component)
+	: (void*)(op.dst + first * op.dst_stride + op.component);
+      op.decode(src + op.offset, record_size, m, dst, op.dst_stride);
+    }
+  }
+
+  return n;
+}
+
+/**
+ * Decodes ASCII records, one record per line.
+ * The body is split into newline aligned chunks; the lines of each chunk
+ * are counted in parallel and a prefix sum gives the first record of every
+ * chunk, so all chunks are then parsed in parallel straight into place.
+ * @param p Start of the target element.
+ **/
+long PlyReader::readAscii ( const char *p ) {
+
+  const Element &element = elements[target];
+  const char *end = data + length;
+  const size_t n = element.count;
+
+  // preceding elements end in the middle of their last line
+  if (target > 0) {
+    const char *eol = (const char*)memchr(p, '\n', end - p);
+    p = eol ? eol + 1 : end;
+  }
+
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  size_t chunks = std::min((size_t)threads * 8, (size_t)(end - p) / ascii_chunk_bytes);
+  chunks = std::max(chunks, (size_t)1);
+
+  std::vector<const char*> bounds (chunks + 1);
+  bounds[0] = p;
+  bounds[chunks] = end;
+  for (size_t c = 1; c < chunks; ++c) {
+    const char *q = std::max(p + (end - p) / chunks * c, bounds[c-1]);
+    const char *eol = (const char*)memchr(q, '\n', end - q);
+    bounds[c] = eol ? eol + 1 : end;
+  }
+
+  // first record of each chunk
+  std::vector<size_t> first (chunks + 1, 0);
+#pragma omp parallel for schedule(static, 1)
+  for (long c = 0; c < (long)chunks; ++c) {
+    size_t lines = 0;
+    for (const char *q = bounds[c]; q < bounds[c+1]; ++lines) {
+      const char *eol = (const char*)memchr(q, '\n', bounds[c+1] - q);
+      q = eol ? eol + 1 : bounds[c+1];
+    }
+    first[c+1] = lines;
+  }
+  for (size_t c = 0; c < chunks; ++c)
+    first[c+1] += first[c];
+
+  if (first[chunks] < n) {
+    error_msg = "file is truncated";
+    return -1;
+  }
+
+  long bad_record = -1;
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (long c = 0; c < (long)chunks; ++c) {
+    std::vector<double> values (element.props.size());
+    const char *q = bounds[c];
+    for (size_t r = first[c]; r < std::min(first[c+1], n); ++r) {
+      const char *eol = (const char*)memchr(q, '\n', bounds[c+1] - q);
+      if (eol == NULL)
+	eol = bounds[c+1];
+
+      bool ok = true;
+      for (unsigned int k = 0; k < values.size() && ok; ++k)
+	ok = parseNumber(q, eol, values[k]);
+      if (!ok) {
+#pragma omp critical
+	bad_record = (bad_record < 0) ? (long)r : std::min(bad_record, (long)r);
+	break;
+      }
+      q = eol + 1;
+
+      for (unsigned int k = 0; k < plan.size(); ++k) {
+	const Op &op = plan[k];
+	if (op.dst_byte)
+	  op.dst_byte[r * op.dst_stride + op.component] = toByte(values[op.property]);
+	else
+	  op.dst[r * op.dst_stride + op.component] = (float)values[op.property];
+      }
+    }
+  }
+
+  if (bad_record >= 0) {
+    std::ostringstream msg;
+    msg << "bad value in record " << bad_record;
+    error_msg = msg.str();
+    return -1;
+  }
+
+  return n;
+}
@@ -0,0 +1,111 @@
+/*
+** ply_reader.h Fast PLY reader header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __PLY_READER_H__
+#define __PLY_READER_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "surfel_store.h"
+
+/**
+ * Reader for point and surfel PLY files decoding straight into a SurfelStore.
+ * The header is parsed once and turned into a decoding plan, one specialised
+ * column decoder per property that is used (type and byte order are resolved
+ * when the plan is built, not per value). The file is memory mapped and
+ * binary bodies are decoded in parallel chunks of records, ASCII bodies
+ * in parallel newline aligned chunks.
+ * Reads the first "vertex" or "surfel" element, with the property names
+ * written by IOSurfels and by the usual scanners (x, nx, red, radius ...).
+ **/
+class PlyReader
+{
+ public:
+
+  PlyReader();
+  ~PlyReader();
+
+  bool open ( const char * filename );
+  void close ( void );
+
+  long read ( SurfelStore &store );
+
+  /// Number of surfels of the element that will be read.
+  size_t count ( void ) const { return target < 0 ? 0 : elements[target].count; }
+
+  /// Size in bytes of the body, for throughput reports.
+  size_t bodySize ( void ) const { return length - body; }
+
+  /// Description of the last error.
+  const std::string& error ( void ) const { return error_msg; }
+
+  enum format_enum { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+
+  enum type_enum { T_INT8, T_UINT8, T_INT16, T_UINT16, T_INT32, T_UINT32, T_FLOAT32, T_FLOAT64, T_NONE };
+
+ private:
+
+  struct Property {
+    std::string name;
+    int type;
+    bool list;
+    int count_type;
+  };
+
+  struct Element {
+    std::string name;
+    size_t count;
+    std::vector<Property> props;
+  };
+
+  /// Decodes one property of n records into a strided float or byte array.
+  typedef void (*ColumnDecoder) ( const char *src, size_t record_size, size_t n, void *dst, int dst_stride );
+
+  /// One step of the decoding plan.
+  struct Op {
+    int property;
+    size_t offset;
+    ColumnDecoder decode;
+    /// Destination array (float or color bytes), stride and component in elements.
+    float *dst;
+    unsigned char *dst_byte;
+    int dst_stride;
+    int component;
+  };
+
+  bool parseHeader ( void );
+  bool buildPlan ( SurfelStore &store );
+  bool skipTo ( const char *&p );
+
+  long readBinary ( const char *p );
+  long readAscii ( const char *p );
+
+  static int typeFromName ( const std::string &name );
+  static int typeSize ( int type );
+
+  std::string error_msg;
+
+  /// Mapped file.
+  const char *data;
+  size_t length;
+  bool mapped;
+  std::vector<char> buffer;
+
+  int format;
+  size_t body;
+
+  std::vector<Element> elements;
+  int target;
+
+  std::vector<Op> plan;
+  size_t record_size;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*
+** ply_writer.cc Surfel PLY writer.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "ply_writer.h"
+
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// Records encoded per block.
+static const size_t block_records = 1 << 18;
+
+/// Upper bound of the characters written per ASCII value, separator included.
+static const size_t ascii_value_size = 16;
+
+enum { POSITION, NORMAL, RADIUS, COLOR, MAJOR, MINOR, ERROR, NUM_ARRAYS };
+
+static bool hostLittleEndian ( void ) {
+  const unsigned int one = 1;
+  return *(const unsigned char*)&one == 1;
+}
+
+/**
+ * Float arrays of the store, indexed as the column arrays (NULL if absent).
+ **/
+static void storeArrays ( const SurfelStore &store, const float *arrays[NUM_ARRAYS] ) {
+  arrays[POSITION] = &store.position[0];
+  arrays[NORMAL] = &store.normal[0];
+  arrays[RADIUS] = &store.radius[0];
+  arrays[COLOR] = NULL;
+  arrays[MAJOR] = store.major_axis.empty() ? NULL : &store.major_axis[0];
+  arrays[MINOR] = store.minor_axis.empty() ? NULL : &store.minor_axis[0];
+  arrays[ERROR] = store.error.empty() ? NULL : &store.error[0];
+}
+
+PlyWriter::PlyWriter() : fp(NULL), binary(true), attribs(0), record_size(0), count(0), written(0) {
+}
+
+PlyWriter::~PlyWriter() {
+  close();
+}
+
+void PlyWriter::addColumn ( const char *name, int array, int component, int stride, bool byte ) {
+  Column c = {name, array, component, stride, byte};
+  columns.push_back(c);
+  record_size += byte ? 1 : sizeof(float);
+}
+
+/**
+ * Creates the file and writes the header.
+ * @param filename Given file name.
+ * @param count Total number of surfels that will be written.
+ * @param attributes Attributes to be written (SurfelStore flags).
+ * @param binary Binary (host byte order) or ASCII body.
+ * @return False if the file cannot be created.
+ **/
+bool PlyWriter::open ( const char * filename, size_t count, int attributes, bool binary ) {
+
+  close();
+
+  fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+
+  this->binary = binary;
+  this->count = count;
+  attribs = attributes;
+  written = 0;
+  columns.clear();
+  record_size = 0;
+
+  const char *element = "vertex";
+
+  if (attributes & SurfelStore::AXES) {
+    // same layout as IOSurfels::SaveSurfels, readable by LoadSurfels
+    element = "surfel";
+    addColumn("cx", POSITION, 0, 3, false);
+    addColumn("cy", POSITION, 1, 3, false);
+    addColumn("cz", POSITION, 2, 3, false);
+    addColumn("nx", NORMAL, 0, 3, false);
+    addColumn("ny", NORMAL, 1, 3, false);
+    addColumn("nz", NORMAL, 2, 3, false);
+    addColumn("major_axisx", MAJOR, 0, 4, false);
+    addColumn("major_axisy", MAJOR, 1, 4, false);
+    addColumn("major_axisz", MAJOR, 2, 4, false);
+    addColumn("major_axis_size", MAJOR, 3, 4, false);
+    addColumn("minor_axisx", MINOR, 0, 4, false);
+    addColumn("minor_axisy", MINOR, 1, 4, false);
+    addColumn("minor_axisz", MINOR, 2, 4, false);
+    addColumn("minor_axis_size", MINOR, 3, 4, false);
+    addColumn("r", COLOR, 0, 4, false);
+    addColumn("g", COLOR, 1, 4, false);
+    addColumn("b", COLOR, 2, 4, false);
+    addColumn("max_error", ERROR, 0, 2, false);
+    addColumn("min_error", ERROR, 1, 2, false);
+  }
+  else {
+    addColumn("x", POSITION, 0, 3, false);
+    addColumn("y", POSITION, 1, 3, false);
+    addColumn("z", POSITION, 2, 3, false);
+    if (attributes & SurfelStore::NORMAL) {
+      addColumn("nx", NORMAL, 0, 3, false);
+      addColumn("ny", NORMAL, 1, 3, false);
+      addColumn("nz", NORMAL, 2, 3, false);
+    }
+    if (attributes & SurfelStore::COLOR) {
+      addColumn("red", COLOR, 0, 4, true);
+      addColumn("green", COLOR, 1, 4, true);
+      addColumn("blue", COLOR, 2, 4, true);
+    }
+    if (attributes & SurfelStore::RADIUS)
+      addColumn("radius", RADIUS, 0, 1, false);
+  }
+
+  fprintf(fp, "ply\nformat %s 1.0\ncomment pyramid point renderer\nelement %s %lu\n",
+	  !binary ? "ascii" : (hostLittleEndian() ? "binary_little_endian" : "binary_big_endian"),
+	  element, (unsigned long)count);
+  for (unsigned int i = 0; i < columns.size(); ++i)
+    fprintf(fp, "property %s %s\n", columns[i].byte ? "uchar" : "float", columns[i].name);
+  fprintf(fp, "end_header\n");
+
+  return !ferror(fp);
+}
+
+/**
+ * Appends the surfels of a store, block by block.
+ * @param store Surfels to be written, must have the attributes given to open.
+ * @return False on write errors or if more surfels than announced are written.
+ **/
+bool PlyWriter::write ( const SurfelStore &store ) {
+
+  if (fp == NULL || written + store.size() > count)
+    return false;
+
+  int slices = 1;
+#ifdef _OPENMP
+  slices = omp_get_max_threads();
+#endif
+
+  const size_t max_record = binary ? record_size : columns.size() * ascii_value_size;
+  block.resize(block_records * max_record);
+  std::vector<size_t> sizes (slices);
+
+  for (size_t first = 0; first < store.size(); first += block_records) {
+    size_t n = std::min(block_records, store.size() - first);
+    size_t slice = (n + slices - 1) / slices;
+
+#pragma omp parallel for schedule(static, 1)
+    for (int s = 0; s < slices; ++s) {
+      size_t begin = std::min(n, s * slice);
+      size_t m = std::min(n, begin + slice) - begin;
+      char *out = &block[begin * max_record];
+      sizes[s] = binary ? encodeBinary(store, first + begin, m, out)
+	: formatAscii(store, first + begin, m, out);
+    }
+
+    for (int s = 0; s < slices; ++s)
+      if (sizes[s] > 0 && fwrite(&block[std::min(n, s * slice) * max_record], 1, sizes[s], fp) != sizes[s])
+	return false;
+  }
+
+  written += store.size();
+  return true;
+}
+
+/**
+ * Closes the file.
+ * @return False if fewer surfels than announced were written.
+ **/
+bool PlyWriter::close ( void ) {
+  if (fp == NULL)
+    return true;
+  bool ok = (fclose(fp) == 0) && written == count;
+  fp = NULL;
+  std::vector<char>().swap(block);
+  return ok;
+}
+
+/**
+ * Writes n records in host byte order.
+ * @return Number of bytes written to out.
+ **/
+size_t PlyWriter::encodeBinary ( const SurfelStore &store, size_t first, size_t n, char *out ) const {
+
+  const float *arrays[NUM_ARRAYS];
+  storeArrays(store, arrays);
+
+  char *p = out;
+  for (size_t i = first; i < first + n; ++i)
+    for (unsigned int k = 0; k < columns.size(); ++k) {
+      const Column &c = columns[k];
+      size_t index = i * c.stride + c.component;
+      if (c.byte)
+	*p++ = store.color[index];
+      else {
+	float v = (c.array == COLOR) ? (float)store.color[index] :
+	  (arrays[c.array] ? arrays[c.array][index] : 0.0f);
+	memcpy(p, &v, sizeof(float));
+	p += sizeof(float);
+      }
+    }
+  return p - out;
+}
+
+/**
+ * Formats n records as text lines.
+ * @return Number of characters written to out.
+ **/
+size_t PlyWriter::formatAscii ( const SurfelStore &store, size_t first, size_t n, char *out ) const {
+
+  const float *arrays[NUM_ARRAYS];
+  storeArrays(store, arrays);
+
+  char *p = out;
+  for (size_t i = first; i < first + n; ++i) {
+    for (unsigned int k = 0; k < columns.size(); ++k) {
+      const Column &c = columns[k];
+      size_t index = i * c.stride + c.component;
+      if (c.byte)
+	p += snprintf(p, ascii_value_size, "%d ", store.color[index]);
+      else {
+	float v = (c.array == COLOR) ? (float)store.color[index] :
+	  (arrays[c.array] ? arrays[c.array][index] : 0.0f);
+	p += snprintf(p, ascii_value_size, "%g ", v);
+      }
+    }
+    p[-1] = '\n';
+  }
+  return p - out;
+}
+
+/**
+ * Writes a whole store to a PLY file.
+ * @param filename Given file name.
+ * @param store Surfels to be written.
+ * @param binary Binary or ASCII body.
+ * @return False on errors.
+ **/
+bool PlyWriter::save ( const char * filename, const SurfelStore &store, bool binary ) {
+  PlyWriter writer;
+  return writer.open(filename, store.size(), store.attributes(), binary) &&
+    writer.write(store) && writer.close();
+}
@@ -0,0 +1,68 @@
+/*
+** ply_writer.h Surfel PLY writer header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __PLY_WRITER_H__
+#define __PLY_WRITER_H__
+
+#include <cstdio>
+#include <vector>
+
+#include "surfel_store.h"
+
+/**
+ * Writes surfel arrays to PLY files in large blocks.
+ * Binary records of a block are encoded in parallel into one buffer that
+ * is written with a single call; ASCII blocks are formatted in parallel,
+ * one text buffer per slice, and written in order.
+ * Stores with axes are written as a "surfel" element with the layout of
+ * IOSurfels::SaveSurfels, others as a "vertex" element.
+ * Several stores can be appended to the same file (open, write, close).
+ **/
+class PlyWriter
+{
+ public:
+
+  PlyWriter();
+  ~PlyWriter();
+
+  bool open ( const char * filename, size_t count, int attributes, bool binary = true );
+  bool write ( const SurfelStore &store );
+  bool close ( void );
+
+  static bool save ( const char * filename, const SurfelStore &store, bool binary = true );
+
+ private:
+
+  /// One property of the written element.
+  struct Column {
+    const char *name;
+    int array;
+    int component;
+    int stride;
+    bool byte;
+  };
+
+  void addColumn ( const char *name, int array, int component, int stride, bool byte );
+
+  size_t encodeBinary ( const SurfelStore &store, size_t first, size_t n, char *out ) const;
+  size_t formatAscii ( const SurfelStore &store, size_t first, size_t n, char *out ) const;
+
+  FILE *fp;
+  bool binary;
+  int attribs;
+
+  std::vector<Column> columns;
+  size_t record_size;
+
+  /// Records announced in the header and records written so far.
+  size_t count, written;
+
+  std::vector<char> block;
+};
+
+#endif
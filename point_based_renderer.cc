@@ -6,3 +6,81 @@
 */
 
 #include "point_based_renderer.h"
+
+const GLdouble PointBasedRenderer::identity[16] = { 1.0, 0.0, 0.0, 0.0,  0.0, 1.0, 0.0, 0.0,
+						    0.0, 0.0, 1.0, 0.0,  0.0, 0.0, 0.0, 1.0 };
+
+/**
+ * Turns the asynchronous readback of rendered frames on/off.
+ * Turning it off, or changing what is captured, delivers all frames still in flight.
+ * @param r Readback state.
+ * @param attributes Capture the reconstructed normal and depth along with color.
+ **/
+void PointBasedRenderer::setReadback ( const bool r, const bool attributes ) {
+  if (readback && r && readback->hasAttributes() != attributes) {
+    delete readback;
+    readback = NULL;
+  }
+  if (r && !readback) {
+    readback = new FrameReadback(canvas_width, canvas_height, attributes);
+    readback->setCallback(readback_callback, readback_data);
+    readback->setOutputPrefix(readback_prefix);
+    readback->setQueueing(readback_queue);
+  }
+  else if (!r && readback) {
+    delete readback;
+    readback = NULL;
+  }
+}
+
+/**
+ * Sets the function called with every frame that comes back from the GPU.
+ * @param cb Callback, NULL to remove it.
+ * @param user_data Pointer handed back to the callback.
+ **/
+void PointBasedRenderer::setReadbackCallback ( ReadbackCallback cb, void *user_data ) {
+  readback_callback = cb;
+  readback_data = user_data;
+  if (readback)
+    readback->setCallback(cb, user_data);
+}
+
+/**
+ * Sets the file prefix for writing captured frames to disk.
+ * @param prefix File name prefix, empty string disables writing.
+ **/
+void PointBasedRenderer::setReadbackOutput ( const string &prefix ) {
+  readback_prefix = prefix;
+  if (readback)
+    readback->setOutputPrefix(prefix);
+}
+
+/**
+ * Keeps host copies of captured frames to be fetched with popReadbackFrame.
+ * @param q Queueing state.
+ **/
+void PointBasedRenderer::setReadbackQueue ( const bool q ) {
+  readback_queue = q;
+  if (readback)
+    readback->setQueueing(q);
+}
+
+/**
+ * Fetches the oldest captured frame from the readback queue.
+ * @param image Receives the frame.
+ * @return False if no frame is available yet.
+ **/
+bool PointBasedRenderer::popReadbackFrame ( ReadbackImage &image ) {
+  if (!readback)
+    return false;
+  readback->poll();
+  return readback->pop(image);
+}
+
+/**
+ * Blocks until all frames in flight have been delivered.
+ **/
+void PointBasedRenderer::flushReadback ( void ) {
+  if (readback)
+    readback->flush();
+}
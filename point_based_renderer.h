@@ -14,6 +14,7 @@
 #include "surfel.hpp"
 #include "materials.h"
 #include "object.h"
+#include "frame_readback.h"
 
 /**
  * Base class for rendering algorithms.
@@ -29,8 +30,12 @@ class PointBasedRenderer
  PointBasedRenderer() :
   canvas_width(1024), canvas_height(1024), scale_factor(1.0),
     material_id(0), depth_test(1), back_face_culling(1), elliptical_weight(0),
-    reconstruction_filter_size(1.0), prefilter_size(1.0), minimum_radius_size(0.0)
-    {}
+    reconstruction_filter_size(1.0), prefilter_size(1.0), minimum_radius_size(0.0),
+    adaptive_levels(0), kernel_size(12), sample_begin(0.0f), sample_end(1.0f), readback(NULL), readback_callback(NULL), readback_data(NULL), readback_queue(false),
+    light_direction(0.0, 0.0, 1.0)
+    {
+      setCamera(identity, identity);
+    }
 
   /**
    * Constructor for given screen size.
@@ -40,10 +45,14 @@ class PointBasedRenderer
  PointBasedRenderer(int w, int h) :
   canvas_width(w), canvas_height(h), scale_factor(1.0),
     material_id(0), depth_test(1), back_face_culling(1), elliptical_weight(0),
-    reconstruction_filter_size(1.0), prefilter_size(1.0), minimum_radius_size(0.0)
-    {}
+    reconstruction_filter_size(1.0), prefilter_size(1.0), minimum_radius_size(0.0),
+    adaptive_levels(0), kernel_size(12), sample_begin(0.0f), sample_end(1.0f), readback(NULL), readback_callback(NULL), readback_data(NULL), readback_queue(false),
+    light_direction(0.0, 0.0, 1.0)
+    {
+      setCamera(identity, identity);
+    }
   
-  virtual ~PointBasedRenderer() {}
+  virtual ~PointBasedRenderer() { delete readback; }
 
   virtual void init ( void ) {}
 
@@ -100,6 +109,137 @@ class PointBasedRenderer
    **/
   virtual void setGpuMaskSize ( int ) {}
 
+  /**
+   * Renders the shaded image to an offscreen buffer instead of the window.
+   * Needed when the canvas is larger than the window, e.g. tiled rendering.
+   * @param o Offscreen state.
+   **/
+  virtual void setOffscreen ( bool ) {}
+
+  /**
+   * Skips surfel clusters hidden behind the surface reconstructed in
+   * previous frames (see OcclusionCuller).
+   * @param c Occlusion culling state.
+   **/
+  virtual void setOcclusionCulling ( bool ) {}
+
+  /**
+   * Projects samples into buffers that persist between frames, so that
+   * the samples of successive frames can be accumulated (see setKeepSamples).
+   * @param a Accumulation state.
+   **/
+  virtual void setAccumulation ( bool ) {}
+
+  /**
+   * When on, clearBuffers keeps the samples projected in previous frames
+   * and the new samples are added to them. Needs setAccumulation.
+   * @param k Keep samples flag.
+   **/
+  virtual void setKeepSamples ( bool ) {}
+
+  /**
+   * Projects samples on the CPU with all cores instead of rasterizing
+   * them on the GPU (see SoftwareProjector).
+   * @param s Software projection state.
+   **/
+  virtual void setSoftwareProjection ( bool ) {}
+
+  /**
+   * Keeps the buffers of every frame so that the next one may redo only
+   * part of the canvas (see setUpdateRegion). The shaded image is then
+   * kept offscreen and copied to the window after shading.
+   * @param p Partial updates state.
+   **/
+  virtual void setPartialUpdates ( bool ) {}
+
+  /**
+   * Restricts the next frame to a rectangle of the canvas: clearBuffers,
+   * projection, the pyramid and shading only write the pixels inside it,
+   * and the rest of the previous frame is kept. The rectangle must be
+   * grown by the splat support, and every object reaching into it must
+   * be projected again. Holds until the frame is drawn.
+   * @param region x, y, width and height in pixels, NULL for a whole frame.
+   * @return False if the frame must be whole anyway.
+   **/
+  virtual bool setUpdateRegion ( const int * ) { return false; }
+
+  /**
+   * Range of every surfel cluster projected by projectSamples, as fractions
+   * of the cluster size; [0, 1] projects all surfels.
+   * @param begin Start of the range.
+   * @param end End of the range.
+   **/
+  void setSampleRange ( float begin, float end ) {
+    sample_begin = begin;
+    sample_end = end;
+  }
+
+  /// Overdraw reduction modes of the projection, see setOverdrawMode.
+  enum { OVERDRAW_OFF = 0, OVERDRAW_SORTED = 1, OVERDRAW_PREPASS = 2 };
+
+  /**
+   * Reduces the fragments written by the projection shader where many
+   * surfels fall on the same pixel.
+   * OVERDRAW_SORTED draws the clusters of every object front to back, so
+   * that most hidden fragments fail the depth test; OVERDRAW_PREPASS also
+   * lays down the depth of all surfels first, with color writes off, so
+   * that only the front surfels write the pyramid buffers.
+   * @param mode Overdraw mode.
+   **/
+  virtual void setOverdrawMode ( int ) {}
+
+  /**
+   * Counts the points and fragments of the projection (see getOverdraw)
+   * with OVERDRAW_OFF as well; the other modes always count them.
+   * @param c Counters state.
+   **/
+  virtual void setOverdrawCounters ( bool ) {}
+
+  /**
+   * Points drawn and fragments written by the projection shader, from the
+   * newest frame whose counters are available.
+   * @param points Projected points.
+   * @param fragments Fragments that passed the depth test and wrote the pyramid.
+   **/
+  virtual void getOverdraw( double &points, double &fragments ) const {
+    points = fragments = 0.0;
+  }
+
+  /// Stereo modes, see setStereo.
+  enum { STEREO_OFF = 0, STEREO_SHARED = 1, STEREO_TWO_PASS = 2 };
+
+  /**
+   * Renders two eyes side by side in the canvas.
+   * With STEREO_SHARED both eyes are projected into one pyramid, which
+   * is then reconstructed and shaded once; with STEREO_TWO_PASS each eye
+   * runs the whole pipeline (for comparison).
+   * @param mode Stereo mode.
+   * @param gap Empty columns between the eyes, wider than the largest projected splat.
+   **/
+  virtual void setStereo ( int, int ) {}
+
+  /**
+   * Sets the viewport of one eye before its samples are projected.
+   * @param eye 0 for the left eye, 1 for the right eye.
+   **/
+  virtual void beginEye ( int ) {}
+
+  /**
+   * Copies all rendering parameters (filters, material, flags) from another renderer.
+   * @param r Renderer to copy from.
+   **/
+  void copyParameters ( const PointBasedRenderer &r ) {
+    material_id = r.material_id;
+    depth_test = r.depth_test;
+    back_face_culling = r.back_face_culling;
+    elliptical_weight = r.elliptical_weight;
+    reconstruction_filter_size = r.reconstruction_filter_size;
+    prefilter_size = r.prefilter_size;
+    minimum_radius_size = r.minimum_radius_size;
+    adaptive_levels = r.adaptive_levels;
+    kernel_size = r.kernel_size;
+  }
+
   /** 
    * Sets eye vector used mainly for backface culling.
    * @param e Given eye vector.
@@ -108,6 +248,27 @@ class PointBasedRenderer
     eye = e;
   }
 
+  /**
+   * Sets the camera the samples are projected with, in place of the
+   * fixed function matrix stacks.
+   * @param modelview Column major modelview, including the model transformation.
+   * @param projection Column major projection.
+   **/
+  void setCamera ( const GLdouble modelview[16], const GLdouble projection[16] ) {
+    for (int i = 0; i < 16; ++i) {
+      camera_modelview[i] = modelview[i];
+      camera_projection[i] = projection[i];
+    }
+  }
+
+  /**
+   * Sets the direction of the light used by the deferred shading.
+   * @param l Unit direction towards the light, in eye space.
+   **/
+  void setLightDirection (Point3f l) {
+    light_direction = l;
+  }
+
   /** 
    * Sets scale factor for zooming, scales sample's radius size.
    * @param s Given scale factor.
@@ -165,6 +326,47 @@ class PointBasedRenderer
     elliptical_weight = w;
   }
 
+  /**
+   * Sets the number of pixels gathered per pixel by analysis and synthesis.
+   * Takes effect when the shaders are created (createShaders).
+   * @param k Kernel size: 4 (fast), 12 (default) or 20 (quality).
+   **/
+  void setKernelSize( const int k ) {
+    if (k == 4 || k == 12 || k == 20)
+      kernel_size = k;
+  }
+
+  int getKernelSize( void ) const { return kernel_size; }
+
+  /**
+   * GPU time of the pyramid passes, from the newest frame whose timer
+   * queries are available.
+   * @param analysis Analysis time in milliseconds.
+   * @param synthesis Synthesis time in milliseconds.
+   **/
+  virtual void getPyramidTimes( double &analysis, double &synthesis ) const {
+    analysis = synthesis = 0.0;
+  }
+
+  /**
+   * Sets the adaptive pyramid depth on/off.
+   * When on, analysis and synthesis only climb as many levels as needed
+   * to fill the holes found in previous frames. Holes are only found where
+   * specified pixels lie close on both sides, so wide gaps opened by a zoom
+   * or a disocclusion wait for the next frame with all levels; off by default.
+   * @param a Given adaptive levels state.
+   **/
+  void setAdaptiveLevels( const bool a ) {
+    adaptive_levels = a;
+  }
+
+  void setReadback ( const bool r, const bool attributes = true );
+  void setReadbackCallback ( ReadbackCallback cb, void *user_data );
+  void setReadbackOutput ( const string &prefix );
+  void setReadbackQueue ( const bool q );
+  bool popReadbackFrame ( ReadbackImage &image );
+  void flushReadback ( void );
+
  protected:
 
   /// Canvas width.
@@ -176,6 +378,12 @@ class PointBasedRenderer
   /// Eye position.
   Point3f eye;
 
+  /// Camera of the projection, column major.
+  GLdouble camera_modelview[16];
+  GLdouble camera_projection[16];
+
+  static const GLdouble identity[16];
+
   /// Scale factor (camera zooming)
   double scale_factor;
 
@@ -200,9 +408,36 @@ class PointBasedRenderer
   /// Minimum smallest radius size.
   double minimum_radius_size;
 
+  /// Flag to turn on/off the adaptive number of pyramid levels
+  bool adaptive_levels;
+
+  /// Number of pixels gathered by analysis and synthesis.
+  int kernel_size;
+
+  /// Projected range of every surfel cluster.
+  float sample_begin, sample_end;
+
+  /// Asynchronous readback of rendered frames, NULL when disabled.
+  FrameReadback *readback;
+
+  /// Readback settings, kept so they survive turning readback off and on.
+  ReadbackCallback readback_callback;
+  void *readback_data;
+  string readback_prefix;
+  bool readback_queue;
+
+  /// Unit direction towards the light, in eye space.
+  Point3f light_direction;
+
 };
 
-//inline void check_for_ogl_error( char * from = 0) {
+/**
+ * Reports the pending OpenGL error, if any.
+ * glGetError waits for the driver, so the check is only compiled in
+ * with CHECK_GL_ERRORS defined (see CXXFLAGS in the Makefile).
+ * @param from Location printed with the error.
+ **/
+#ifdef CHECK_GL_ERRORS
 inline void check_for_ogl_error( string from = "") {
   GLenum err = glGetError();
   if (err != GL_NO_ERROR) {
@@ -210,5 +445,8 @@ inline void check_for_ogl_error( string from = "") {
     cerr << __FILE__ << " (" << __LINE__ << ") " << gluErrorString(err) << endl;
   }
 }
+#else
+inline void check_for_ogl_error( const char * = "") {}
+#endif
 
 #endif
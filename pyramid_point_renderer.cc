@@ -27,7 +27,7 @@ void PyramidPointRenderer::createShaders ( void ) {
 	bool link;
 
 	//	mShaderProjection.SetSources(loadShaderSource("shader_point_projection.vert").toAscii().data(), loadShaderSource("shader_point_projection.frag").toAscii().data());
-	mShaderProjection.LoadSources("shaders/shader_point_projection.vert", "shaders/shader_point_projection.frag");
+	loadProjectionShader(mShaderProjection, "shaders/shader_point_projection.vert", "shaders/shader_point_projection.frag");
 	link = mShaderProjection.prog.Link();
 
 	std::string compileinfo = mShaderProjection.fshd.InfoLog();  
@@ -35,7 +35,7 @@ void PyramidPointRenderer::createShaders ( void ) {
 	assert (link == 1);
 
 	//	mShaderAnalysis.SetSources(loadShaderSource("shader_analysis.vert").toAscii().data(), loadShaderSource("shader_analysis.frag").toAscii().data());
-	mShaderAnalysis.LoadSources("shaders/shader_analysis.vert", "shaders/shader_analysis.frag");
+	loadKernelShader(mShaderAnalysis, "shaders/shader_analysis.vert", "shaders/shader_analysis.frag");
 	link = mShaderAnalysis.prog.Link();
 
 	compileinfo = mShaderAnalysis.fshd.InfoLog();  
@@ -43,7 +43,7 @@ void PyramidPointRenderer::createShaders ( void ) {
 	assert (link == 1);
 
 	//	mShaderSynthesis.SetSources(loadShaderSource("shader_synthesis.vert").toAscii().data(), loadShaderSource("shader_synthesis.frag").toAscii().data());
-	mShaderSynthesis.LoadSources("shaders/shader_synthesis.vert", "shaders/shader_synthesis.frag");
+	loadKernelShader(mShaderSynthesis, "shaders/shader_synthesis.vert", "shaders/shader_synthesis.frag");
 	link = mShaderSynthesis.prog.Link();
 
 	compileinfo = mShaderSynthesis.fshd.InfoLog();  
@@ -51,7 +51,7 @@ void PyramidPointRenderer::createShaders ( void ) {
 	assert (link == 1);
 
 	//	mShaderPhong.SetSources(loadShaderSource("shader_phong.vert").toAscii().data(), loadShaderSource("shader_phong.frag").toAscii().data());
-	mShaderPhong.LoadSources("shaders/shader_phong.vert", "shaders/shader_phong.frag");
+	ScreenTriangle::loadSources(mShaderPhong, "shaders/shader_phong.vert", "shaders/shader_phong.frag");
 	link = mShaderPhong.prog.Link();
 
 	compileinfo = mShaderPhong.fshd.InfoLog();  
@@ -8,6 +8,12 @@
 #include "pyramid_point_renderer_base.h"
 
 #include <stdexcept>
+#include <fstream>
+#include <sstream>
+
+/// With adaptive levels, all levels are used once every this many frames
+/// so that holes too wide to be found at the active levels are detected.
+static const int full_levels_interval = 30;
 
 using std::runtime_error;
 #define FOO(a) case a: throw std::runtime_error( where + ": " #a ); break
@@ -42,43 +48,75 @@ void PyramidPointRendererBase::init ( void ) {
 
   cout << "LEVELS :  " << (int)(log(canvas_width)/log(2.0)) << " " << (int)(log(canvas_height)/log(2.0)) << " " << levels_count << endl;
 
+  /// Pad the base level so that every level is exactly half the one below
+  int tile = 1 << max(levels_count - 1, 0);
+  pyramid_width = (canvas_width + tile - 1) / tile * tile;
+  pyramid_height = (canvas_height + tile - 1) / tile * tile;
+
   resetPointers();
   createFBO();
+  computeLevelParameters();
+
+  active_levels = levels_count;
+  probed_levels = 0;
+  frames_since_full = 0;
+
+  glGenQueries(4, &timer_queries[0][0]);
+  timer_pending[0] = timer_pending[1] = false;
+  timer_slot = 0;
+  analysis_time = synthesis_time = 0.0;
+
+  overdraw_mode = OVERDRAW_OFF;
+  overdraw_counters = false;
+  overdraw_used[0] = overdraw_used[1] = 0;
+  overdraw_slot = 0;
+  projected_points = written_fragments = 0.0;
+
+  screen_triangle = new ScreenTriangle();
+
+  ScreenTriangle::loadSources(mShaderProbe, "shaders/shader_analysis.vert", "shaders/shader_level_probe.frag");
+  bool link = mShaderProbe.prog.Link();
+  std::cout << "Level probe Frag shader info : " << mShaderProbe.fshd.InfoLog() << "\n";
+  assert (link == 1);
+  resolveLevelUniforms(mShaderProbe, probe_uniforms);
+
+  fbo_output = 0;
+  output_color = 0;
+  offscreen = false;
+
+  culler = NULL;
 
-  vertices[0][0] = 0.0;
-  vertices[0][1] = 0.0;
-  vertices[1][0] = 0.0; 
-  vertices[1][1] = canvas_height;
-  vertices[2][0] = canvas_width;
-  vertices[2][1] = canvas_height;
-  vertices[3][0] = canvas_width; 
-  vertices[3][1] = 0.0;
+  fbo_projection = 0;
+  projection_textures = NULL;
+  projection_depth = 0;
+  keep_samples = false;
+  accumulation = false;
 
-  texcoors0[0][0] = 0.0;
-  texcoors0[0][1] = 0.0;
-  texcoors0[1][0] = 0.0;
-  texcoors0[1][1] = 1.0;
-  texcoors0[2][0] = 1.0;
-  texcoors0[2][1] = 1.0;
-  texcoors0[3][0] = 1.0;
-  texcoors0[3][1] = 0.0;
+  software = NULL;
+
+  stereo_mode = STEREO_OFF;
+  stereo_gap = 0;
+
+  partial_updates = false;
+  frame_kept = false;
+  region_update = false;
 }
 
 /**
  * Default constructor.
  **/
 PyramidPointRendererBase::PyramidPointRendererBase() : PointBasedRenderer(),
-						       fbo_buffers_count(2) {
+						       fbo_buffers_count(2), attribute_format(FBO_FORMAT) {
   init();
 }
 
 PyramidPointRendererBase::PyramidPointRendererBase(int w, int h) : PointBasedRenderer(w, h),
-								   fbo_buffers_count(2) {
+								   fbo_buffers_count(2), attribute_format(FBO_FORMAT) {
   init();
 }
 
-PyramidPointRendererBase::PyramidPointRendererBase(int w, int h, int fbos) : PointBasedRenderer(w, h),
-									     fbo_buffers_count(fbos) {
+PyramidPointRendererBase::PyramidPointRendererBase(int w, int h, int fbos, GLenum attributes) :
+  PointBasedRenderer(w, h), fbo_buffers_count(fbos), attribute_format(attributes) {
   init();
 									     }
 
@@ -90,31 +128,34 @@ PyramidPointRendererBase::~PyramidPointRendererBase()  {
   glDrawBuffer(GL_BACK);
 
   glDeleteTextures(1, &fbo_depth);
+
+  if (!level_queries.empty())
+    glDeleteQueries(level_queries.size(), &level_queries[0]);
+  glDeleteQueries(4, &timer_queries[0][0]);
+  for (int i = 0; i < 2; ++i)
+    if (!overdraw_queries[i].empty())
+      glDeleteQueries(overdraw_queries[i].size(), &overdraw_queries[i][0]);
+
+  setPartialUpdates(false);
+  setOcclusionCulling(false);
+  setAccumulation(false);
+  setSoftwareProjection(false);
 	
   fbo_lod.clear();
   delete [] fbo_buffers;
   delete [] fbo_textures;
   delete [] shader_texture_names;
+  delete screen_triangle;
 }
 
 
 /**
- * Renders the QUAD with textures.
+ * Renders the full screen triangle over the current viewport.
  * Each fragment in shader will read one pixel from texture.
  **/
 const void PyramidPointRendererBase::rasterizePixels(void)
-     
 {
-  // Rasterize texture as quads.
-  // Uses multiple tex coords in the case of reading from multiple levels
-  // at the same time. (ex. synthesis phase)
-  glBegin(GL_QUADS);
-  glColor4f(1.0f, 1.0f, 1.0f, 1.0f);  
-  for(int i = 0; i < 4; i++) {
-    glMultiTexCoord2fARB(GL_TEXTURE0, texcoors0[i][0], texcoors0[i][1]);
-    glVertex2f(vertices[i][0], vertices[i][1]);
-  }
-  glEnd();
+  screen_triangle->draw();
 }
 
 /**
@@ -128,18 +169,23 @@ const void PyramidPointRendererBase::activateTexture(const int text_id, const in
 
   if (text_id == -1)
     glBindTexture(FBO_TYPE, (GLuint)0);
-  else {   
+  else
     glBindTexture(FBO_TYPE, fbo_textures[text_id]);
-    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-  }
 }
 
 /** 
  * Project point samples to screen space.
  * @param obj Pointer to object for rendering.
+ * @param skip Per cluster flags, nonzero clusters are not projected (NULL projects all).
  **/
-void PyramidPointRendererBase::projectSurfels ( const Object* const obj )
+void PyramidPointRendererBase::projectSurfels ( const Object* const obj, const vector<unsigned char> *skip )
 {
+  if (software) {
+    software->project(obj, skip, sample_begin, sample_end, eye, pyramidScale(), back_face_culling,
+		      camera_modelview, camera_projection);
+    return;
+  }
+
   int level = 0;
 
   // render targets (GL_COLOR_ATTACHMENTs)
@@ -148,21 +194,61 @@ void PyramidPointRendererBase::projectSurfels ( const Object* const obj )
     buffers[i] = fbo_buffers[i];
 
   //fbo_lod[level]->bind();
-  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_lod[level]);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, level == 0 ? projectionBuffer() : fbo_lod[level]);
 
   glDrawBuffers(fbo_buffers_count, buffers);
+  scissorRegion();
 
   mShaderProjection.prog.Bind();
-  mShaderProjection.prog.Uniform("canvas_size", (GLfloat)canvas_width, (GLfloat)canvas_height);  
-  mShaderProjection.prog.Uniform("eye", (GLfloat)eye[0], (GLfloat)eye[1], (GLfloat)eye[2]);
-  mShaderProjection.prog.Uniform("back_face_culling", (GLint)back_face_culling);
-  mShaderProjection.prog.Uniform("scale", (GLfloat)scale_factor); 
+  glUniform2f(projection_uniforms.canvas_size, (GLfloat)pyramid_width, (GLfloat)pyramid_height);
+  glUniform3f(projection_uniforms.eye, (GLfloat)eye[0], (GLfloat)eye[1], (GLfloat)eye[2]);
+  glUniform1i(projection_uniforms.back_face_culling, (GLint)back_face_culling);
+  glUniform1f(projection_uniforms.scale, (GLfloat)pyramidScale());
+  glUniform1i(projection_uniforms.quantized, (GLint)obj->isQuantized());
+  cameraUniforms();
+  projectionUniforms(obj);
 
   // Render vertices from surfel list.
   glPointSize(1.0);
-  obj->render();
+  const Object::ClusterOrder *order = NULL;
+  if (overdraw_mode != OVERDRAW_OFF) {
+    obj->sortClusters(eye, cluster_order);
+    order = &cluster_order;
+  }
+
+  // depth of all surfels first, the second pass then only writes the front ones
+  if (overdraw_mode == OVERDRAW_PREPASS) {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    obj->render(skip, sample_begin, sample_end, order);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+  }
+
+  if (overdraw_counters || overdraw_mode != OVERDRAW_OFF) {
+    vector<GLuint> &queries = overdraw_queries[overdraw_slot];
+    int &used = overdraw_used[overdraw_slot];
+    if ((int)queries.size() < used + 2) {
+      queries.resize(used + 2);
+      glGenQueries(2, &queries[used]);
+    }
+    glBeginQuery(GL_PRIMITIVES_GENERATED, queries[used]);
+    glBeginQuery(GL_SAMPLES_PASSED, queries[used + 1]);
+    obj->render(skip, sample_begin, sample_end, order);
+    glEndQuery(GL_SAMPLES_PASSED);
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    used += 2;
+  }
+  else
+    obj->render(skip, sample_begin, sample_end, order);
+
+  if (overdraw_mode == OVERDRAW_PREPASS) {
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+  }
 
   mShaderProjection.prog.Unbind();
+  glDisable(GL_SCISSOR_TEST);
   //  fbo_lod[level]->release();
   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
 }
@@ -172,6 +258,8 @@ void PyramidPointRendererBase::projectSurfels ( const Object* const obj )
  * Pull phase.
  * Create pyramid structure starting one level above base level (already created with projection).
  * Each pixel is the average of the four pixels in level below.
+ * Partial frames still analyze whole levels: the coarser levels depend on the
+ * whole canvas, and synthesis left last frame's values in them.
  **/
 void PyramidPointRendererBase::rasterizeAnalysisPyramid( void ) {
   
@@ -193,46 +281,24 @@ void PyramidPointRendererBase::rasterizeAnalysisPyramid( void ) {
     mShaderAnalysis.prog.Uniform(shader_texture_names[i].c_str(), i); //samplers
   mShaderAnalysis.prog.Unbind();
 
-  GLfloat lw, lh, ratio_w, ratio_h;
   // Reconstructs all lower resolution levels bottom-up fashion
-  for (int level = 1; level < levels_count; level++)
-    {	  
-      lw = floorf(canvas_width / pow(2.0, level));
-      lh = floorf(canvas_height / pow(2.0, level));
-      glViewport(0, 0, lw, lh);
-      glMatrixMode(GL_PROJECTION);
-      glLoadIdentity();
-      gluOrtho2D(0.0,  lw, 0.0, lh);
-      glMatrixMode(GL_MODELVIEW);
-      glLoadIdentity();
-
-      vertices[1][1] = lh;
-      vertices[2][0] = lw;
-      vertices[2][1] = lh;
-      vertices[3][0] = lw;
-
-      //fbo_lod[level]->bind();
+  mShaderAnalysis.prog.Bind();
+  for (int level = 1; level < active_levels; level++)
+    {
+      const LevelParameters &p = level_parameters[level];
+      setLevelViewport(level, false);
+
       glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_lod[level]);
       glDrawBuffers(fbo_buffers_count, buffers);
 
-      ratio_w = lw;
-      ratio_h = lh;
-      lw = floorf(canvas_width / pow(2.0, level-1));
-      lh = floorf(canvas_height / pow(2.0, level-1));		
-		
-      mShaderAnalysis.prog.Bind();
-      mShaderAnalysis.prog.Uniform("level", (GLint)level);	  
-      mShaderAnalysis.prog.Uniform("offset", (GLfloat)0.25/lw, (GLfloat)0.25/lh);
-      mShaderAnalysis.prog.Uniform("level_ratio", (GLfloat)(2.0*ratio_w/lw), (GLfloat)(2.0*ratio_h/lh));
+      glUniform1i(analysis_uniforms.level, level);
+      glUniform2fv(analysis_uniforms.offset, 1, p.offset);
+      glUniform2fv(analysis_uniforms.level_ratio, 1, p.analysis_ratio);
 
       rasterizePixels();
-
-      mShaderAnalysis.prog.Unbind();
-      //fbo_lod[level]->release();
-      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
-  
     }
-  
+  mShaderAnalysis.prog.Unbind();
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
 }
 
 /**
@@ -262,55 +328,79 @@ void PyramidPointRendererBase::rasterizeSynthesisPyramid( void )
     mShaderSynthesis.prog.Uniform(shader_texture_names[i].c_str(), i);
   mShaderSynthesis.prog.Unbind();
 
-  GLfloat lw, lh, ratio_w, ratio_h;
-  for (int level = levels_count - 2; level >= 0; level--)
+  mShaderSynthesis.prog.Bind();
+  for (int level = active_levels - 2; level >= 0; level--)
     {
-      lw = floorf(canvas_width / pow(2.0, level));
-      lh = floorf(canvas_height / pow(2.0, level));
-      glViewport(0, 0, lw, lh);
-      glMatrixMode(GL_PROJECTION);
-      glLoadIdentity();
-      gluOrtho2D(0.0,  lw, 0.0, lh);
-      glMatrixMode(GL_MODELVIEW);
-      glLoadIdentity();
-		
-      /// maximum coordinates for drawing quad
-      vertices[1][1] = lh;
-      vertices[2][0] = lw;
-      vertices[2][1] = lh;
-      vertices[3][0] = lw;
-
-      //fbo_lod[level]->bind();
+      const LevelParameters &p = level_parameters[level];
+      setLevelViewport(level);
+
       glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_lod[level]);
       glDrawBuffers(fbo_buffers_count, buffers);
 
-      mShaderSynthesis.prog.Bind();
-      mShaderSynthesis.prog.Uniform("level", (GLint)level);
-
-      ratio_w = lw;
-      ratio_h = lh;
-      lw = floorf(canvas_width / pow(2.0, level+1));
-      lh = floorf(canvas_height / pow(2.0, level+1));
-
-      mShaderSynthesis.prog.Uniform("half_pixel_size", (GLfloat)0.5/lw, (GLfloat)0.5/lh);
-
-      check_for_ogl_error("uniforms 0");
-
-      mShaderSynthesis.prog.Uniform("level_ratio", (GLfloat)(0.5*ratio_w/lw), (GLfloat)(0.5*ratio_h/lh));
-
-      check_for_ogl_error("uniforms 1");
-
-      mShaderSynthesis.prog.Uniform("canvas_ratio", (GLfloat)lw/lh);
-
-      check_for_ogl_error("uniforms 2");
+      glUniform1i(synthesis_uniforms.level, level);
+      glUniform2fv(synthesis_uniforms.half_pixel_size, 1, p.half_pixel_size);
+      glUniform2fv(synthesis_uniforms.level_ratio, 1, p.synthesis_ratio);
+      glUniform1f(synthesis_uniforms.canvas_ratio, p.canvas_ratio);
 
       rasterizePixels();
+    }
+  mShaderSynthesis.prog.Unbind();
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+}
 
-      mShaderSynthesis.prog.Unbind();
-      //fbo_lod[level]->release();
-      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+/**
+ * Sets the light of the bound shading shader: a directional light in eye
+ * space with the default colors of GL_LIGHT0 and of the light model.
+ **/
+void PyramidPointRendererBase::lightUniforms(void)
+{
+  Point3f half_vector = (light_direction + Point3f(0.0, 0.0, 1.0)).Normalize();
+  mShaderPhong.prog.Uniform("light_direction", light_direction[0], light_direction[1], light_direction[2]);
+  mShaderPhong.prog.Uniform("half_vector", half_vector[0], half_vector[1], half_vector[2]);
+  mShaderPhong.prog.Uniform("light_ambient", 0.2f, 0.2f, 0.2f, 1.0f);
+  mShaderPhong.prog.Uniform("light_diffuse", 1.0f, 1.0f, 1.0f, 1.0f);
+  mShaderPhong.prog.Uniform("light_specular", 1.0f, 1.0f, 1.0f, 1.0f);
+
+  /// Material times light of the shaders matching the Splatting Plugin for comparison
+  mShaderPhong.prog.Uniform("splat_ambient", 0.0f, 0.0f, 0.0f, 1.0f);
+  mShaderPhong.prog.Uniform("splat_diffuse", 0.6f, 0.6f, 0.6f, 1.0f);
+  mShaderPhong.prog.Uniform("splat_specular", 0.5f, 0.5f, 0.5f, 1.0f);
+  mShaderPhong.prog.Uniform("splat_shininess", 64.0f);
+}
 
+/**
+ * Sets the camera of the bound projection shader from the matrices given
+ * to setCamera: their product, the modelview, and the inverse transpose
+ * of its rotation part for the normals.
+ **/
+void PyramidPointRendererBase::cameraUniforms(void)
+{
+  const GLdouble *modelview = camera_modelview, *projection = camera_projection;
+
+  // column major product projection * modelview
+  GLfloat mvp[16], mv[16];
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 4; ++r) {
+      GLdouble sum = 0.0;
+      for (int k = 0; k < 4; ++k)
+	sum += projection[4*k + r] * modelview[4*c + k];
+      mvp[4*c + r] = sum;
+      mv[4*c + r] = modelview[4*c + r];
     }
+
+  const GLdouble *m = modelview;
+  GLdouble cofactor[9] = {
+    m[5]*m[10] - m[9]*m[6], m[9]*m[2] - m[1]*m[10], m[1]*m[6] - m[5]*m[2],
+    m[8]*m[6] - m[4]*m[10], m[0]*m[10] - m[8]*m[2], m[4]*m[2] - m[0]*m[6],
+    m[4]*m[9] - m[8]*m[5], m[8]*m[1] - m[0]*m[9], m[0]*m[5] - m[4]*m[1] };
+  GLdouble det = m[0]*cofactor[0] + m[4]*cofactor[1] + m[8]*cofactor[2];
+  GLfloat normal_matrix[9];
+  for (int k = 0; k < 9; ++k)
+    normal_matrix[k] = det != 0.0 ? cofactor[k] / det : 0.0;
+
+  glUniformMatrix4fv(projection_uniforms.mvp, 1, GL_FALSE, mvp);
+  glUniformMatrix4fv(projection_uniforms.modelview, 1, GL_FALSE, mv);
+  glUniformMatrix3fv(projection_uniforms.normal_matrix, 1, GL_FALSE, normal_matrix);
 }
 
 /**
@@ -326,15 +416,19 @@ void PyramidPointRendererBase::rasterizePhongShading(void)
   mShaderPhong.prog.Uniform("color_specular", Mats[material_id][8], Mats[material_id][9], Mats[material_id][10], Mats[material_id][11]);
   mShaderPhong.prog.Uniform("shininess", Mats[material_id][12]);
   mShaderPhong.prog.Uniform("level", (GLint)level);
+
+  lightUniforms();
+
+
   /// samplers, binds normal texture, then binds extra attributes if any starting from third texture (color ...)
   mShaderPhong.prog.Uniform(shader_texture_names[0].c_str(), 0);
   for (int i = 2; i < fbo_buffers_count; ++i)
     mShaderPhong.prog.Uniform(shader_texture_names[i].c_str(), i-1);
 
-  glViewport(0, 0, canvas_width, canvas_height);
+  glEnable(GL_SCISSOR_TEST);
+  setLevelViewport(0);
 
-  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
-  glDrawBuffer(GL_BACK);
+  bindOutputBuffer();
 
   activateTexture(0, 0);
   /// source textures that are acessed in shaders
@@ -344,6 +438,9 @@ void PyramidPointRendererBase::rasterizePhongShading(void)
   rasterizePixels();
 
   mShaderPhong.prog.Unbind();
+  glDisable(GL_SCISSOR_TEST);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glDrawBuffer(GL_BACK);
 
   /// clear
   for (int i = 0; i < fbo_buffers_count; ++i)
@@ -360,44 +457,72 @@ void PyramidPointRendererBase::clearBuffers( void ) {
   mShaderSynthesis.prog.Unbind();
   mShaderPhong.prog.Unbind();
 
-  glEnable(FBO_TYPE);
   glDisable(GL_BLEND);
   glEnable(GL_DEPTH_TEST);
   glDepthMask(GL_TRUE);
   glDepthFunc(GL_LESS);
 
+  readOverdraw();
+
   GLint currentDrawBuffer;
   glGetIntegerv(GL_DRAW_BUFFER, &currentDrawBuffer);
 
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f); 
+  clearPyramid();
+
+  if (culler)
+    culler->beginFrame();
+
+  /// Clear the back buffer (or the offscreen output)
+  bindOutputBuffer();
+  glClearColor(0.7f, 0.7f, 0.8f, 1.0f);
+  scissorRegion();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glDisable(GL_SCISSOR_TEST);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glDrawBuffer(GL_BACK);
+
+  check_for_ogl_error("clear buffers");
   
-  check_for_ogl_error("before clearing ");
+}
 
-  /// clear all buffers of all fbos
-  for (int level = 0; level < levels_count; level++) {
-    //fbo_lod[level]->bind();
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_lod[level]);
-    
-    for (int j = 0; j < fbo_buffers_count; j++) {
-      glDrawBuffer(fbo_buffers[j]);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    }
+/**
+ * Clears the buffers of the projection level and its depth buffer,
+ * only inside the update region of a partial frame.
+ * The other levels are not cleared: analysis writes every pixel of
+ * the levels it uses before they are read.
+ * With persistent projection buffers (accumulation, partial updates) they
+ * are cleared instead, unless accumulated samples are kept; level 0 is
+ * overwritten by copyProjection.
+ **/
+void PyramidPointRendererBase::clearPyramid( void ) {
 
-    checkFramebufferStatus( __func__ );
-    check_for_ogl_error("clearing");
+  if (accumulation && keep_samples)
+    return;
 
-    //fbo_lod[level]->release();
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  if (software) {
+    software->clear();
+    return;
+  }
 
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f); 
+  glDepthMask(GL_TRUE);
+  
+  check_for_ogl_error("before clearing ");
+
+  /// clear all buffers of the level 0 fbo
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, projectionBuffer());
+    
+  scissorRegion();
+  for (int j = 0; j < fbo_buffers_count; j++) {
+    glDrawBuffer(fbo_buffers[j]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   }
+  glDisable(GL_SCISSOR_TEST);
 
-  /// Clear the back buffer
-  glDrawBuffer(GL_BACK);
-  glClearColor(0.7f, 0.7f, 0.8f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  checkFramebufferStatus( __func__ );
+  check_for_ogl_error("clearing");
 
-  check_for_ogl_error("clear buffers");
-  
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
 }
 
 /**
@@ -405,7 +530,10 @@ void PyramidPointRendererBase::clearBuffers( void ) {
  **/
 void PyramidPointRendererBase::projectSamples(Object* const obj) {
   // Project points to framebuffer with depth test on.
-  projectSurfels( obj );
+  if (culler)
+    projectSurfels( obj, &culler->cull(obj, cullingRadiusScale(), camera_modelview, camera_projection) );
+  else
+    projectSurfels( obj );
   check_for_ogl_error("project samples");
 }
 
@@ -417,22 +545,228 @@ void PyramidPointRendererBase::interpolate() {
   glDisable(GL_DEPTH_TEST);
   glDepthMask(GL_FALSE);
 
-  /// Set the Ortho once, while viewport is set for each pyramid level render pass
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  gluOrtho2D(0.0, canvas_width, 0.0, canvas_height);
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
+  // the pyramid still holds the whole last frame
+  if (emptyRegion())
+    return;
+
+  updateActiveLevels();
+  readTimers();
+
+  // samples projected on the CPU are accumulated by the projector itself
+  if (software)
+    software->upload(fbo_textures);
+  else if (fbo_projection)
+    copyProjection();
+
+  rasterizePyramid(true);
+
+  if (culler) {
+    /// Clusters hidden in older frames but visible in this one, projected from the next frame
+    culler->testOccluded(fbo_lod[0], fbo_textures[1], cullingRadiusScale());
+    culler->capture(fbo_textures[1]);
+  }
+}
+
+/**
+ * Copies the persistent projection into level 0, where analysis and
+ * synthesis work in place.
+ **/
+void PyramidPointRendererBase::copyProjection( void ) {
+
+  glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, fbo_projection);
+  glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, fbo_lod[0]);
+  for (int i = 0; i < fbo_buffers_count; ++i) {
+    glReadBuffer(fbo_buffers[i]);
+    glDrawBuffer(fbo_buffers[i]);
+    glBlitFramebufferEXT(0, 0, canvas_width, canvas_height, 0, 0, canvas_width, canvas_height,
+			 GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glReadBuffer(GL_BACK);
+  glDrawBuffer(GL_BACK);
+
+  check_for_ogl_error("copy projection");
+}
 
+/**
+ * Runs analysis and synthesis over the projected level 0.
+ * @param timed Measure both passes with the timer queries of the current slot.
+ **/
+void PyramidPointRendererBase::rasterizePyramid( bool timed ) {
+
+  GLuint *timers = timer_queries[timer_slot];
+  timed = timed && !timer_pending[timer_slot];
+
+  /// No matrices, the viewport and scissor are set for each pyramid level render pass
+  glEnable(GL_SCISSOR_TEST);
   /// Pull phase - Create pyramid structure
+  if (timed)
+    glBeginQuery(GL_TIME_ELAPSED, timers[0]);
   rasterizeAnalysisPyramid();
+  if (timed)
+    glEndQuery(GL_TIME_ELAPSED);
   check_for_ogl_error("analysis");
 
+  /// Count the holes left at each level, for the next frames
+  probeLevels();
+
   /// Push phase - Interpolate scattered data
+  if (timed)
+    glBeginQuery(GL_TIME_ELAPSED, timers[1]);
   rasterizeSynthesisPyramid();
+  if (timed) {
+    glEndQuery(GL_TIME_ELAPSED);
+    timer_pending[timer_slot] = true;
+  }
+  glDisable(GL_SCISSOR_TEST);
   check_for_ogl_error("synthesis");
 }
 
+/**
+ * Collects the pyramid times of the previous frame if they are available,
+ * without waiting, and switches to the other pair of timer queries.
+ **/
+void PyramidPointRendererBase::readTimers( void ) {
+
+  timer_slot = 1 - timer_slot;
+  if (!timer_pending[timer_slot])
+    return;
+
+  GLuint available = 0;
+  glGetQueryObjectuiv(timer_queries[timer_slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  GLuint64 elapsed[2];
+  glGetQueryObjectui64v(timer_queries[timer_slot][0], GL_QUERY_RESULT, &elapsed[0]);
+  glGetQueryObjectui64v(timer_queries[timer_slot][1], GL_QUERY_RESULT, &elapsed[1]);
+  analysis_time = elapsed[0] * 1.0e-6;
+  synthesis_time = elapsed[1] * 1.0e-6;
+  timer_pending[timer_slot] = false;
+}
+
+/**
+ * Sums the overdraw counters of the projection passes issued two frames
+ * ago if they are available, without waiting, then reuses their queries
+ * for the current frame; counts that are late are dropped.
+ **/
+void PyramidPointRendererBase::readOverdraw( void ) {
+
+  overdraw_slot = 1 - overdraw_slot;
+  int used = overdraw_used[overdraw_slot];
+  if (used == 0) {
+    if (!overdraw_counters && overdraw_mode == OVERDRAW_OFF)
+      projected_points = written_fragments = 0.0;
+    return;
+  }
+  overdraw_used[overdraw_slot] = 0;
+
+  const vector<GLuint> &queries = overdraw_queries[overdraw_slot];
+  GLuint available = 0;
+  glGetQueryObjectuiv(queries[used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  GLuint64 points = 0, fragments = 0, count;
+  for (int i = 0; i < used; i += 2) {
+    glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &count);
+    points += count;
+    glGetQueryObjectui64v(queries[i + 1], GL_QUERY_RESULT, &count);
+    fragments += count;
+  }
+  projected_points = points;
+  written_fragments = fragments;
+}
+
+/**
+ * Counts the holes of each analysis level above level 0 with one occlusion
+ * query per level. Nothing is written; results are read in later frames
+ * by updateActiveLevels, so probing never waits for the GPU.
+ **/
+void PyramidPointRendererBase::probeLevels( void ) {
+
+  if (!adaptive_levels || probed_levels > 0)
+    return;
+
+  if (level_queries.empty()) {
+    level_queries.resize(levels_count);
+    glGenQueries(levels_count, &level_queries[0]);
+  }
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_lod[0]);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  /// the padding would count as holes
+  glEnable(GL_SCISSOR_TEST);
+
+  activateTexture(0, 0);
+
+  mShaderProbe.prog.Bind();
+  mShaderProbe.prog.Uniform(shader_texture_names[0].c_str(), 0);
+
+  for (int level = 1; level < active_levels; level++) {
+    const LevelParameters &p = level_parameters[level];
+    setLevelViewport(level, false);
+
+    glUniform1i(probe_uniforms.level, level);
+    glUniform2fv(probe_uniforms.pixel_size, 1, p.pixel_size);
+
+    glBeginQuery(GL_SAMPLES_PASSED, level_queries[level]);
+    rasterizePixels();
+    glEndQuery(GL_SAMPLES_PASSED);
+  }
+
+  mShaderProbe.prog.Unbind();
+  glDisable(GL_SCISSOR_TEST);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+  probed_levels = active_levels;
+  check_for_ogl_error("level probe");
+}
+
+/**
+ * Chooses the number of levels of the current frame from the newest probe
+ * results that are available: holes at level l are filled from level l+1,
+ * so levels up to the highest one with holes plus one are needed, and one
+ * more is kept as a margin. If the highest probed level still has holes the
+ * pyramid grows, and every full_levels_interval frames all levels are used.
+ **/
+void PyramidPointRendererBase::updateActiveLevels( void ) {
+
+  if (!adaptive_levels) {
+    active_levels = levels_count;
+    probed_levels = 0;
+    return;
+  }
+
+  // partial frames keep the levels of the frame they update
+  if (region_update)
+    return;
+
+  if (probed_levels > 1) {
+    GLuint available = 0;
+    glGetQueryObjectuiv(level_queries[probed_levels - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      int top = 0;
+      for (int level = 1; level < probed_levels; ++level) {
+	GLuint holes = 0;
+	glGetQueryObjectuiv(level_queries[level], GL_QUERY_RESULT, &holes);
+	if (holes > 0)
+	  top = level;
+      }
+      active_levels = min(levels_count, top + 3);
+      probed_levels = 0;
+    }
+  }
+  else
+    probed_levels = 0;
+
+  if (++frames_since_full >= full_levels_interval && probed_levels == 0) {
+    active_levels = levels_count;
+    frames_since_full = 0;
+  }
+}
+
 /**
  * Renders reconstructed model on screen with
  * per pixel shading.
@@ -441,20 +775,35 @@ void PyramidPointRendererBase::draw( void ) {
 
   glEnable(GL_DEPTH_TEST);
   glDepthMask(GL_TRUE);
-  glEnable(GL_LIGHTING);
-  glEnable(GL_LIGHT0);
-  glDisable(GL_COLOR_MATERIAL);
 
-  /// These parameters are matching the Splatting Plugin for comparison
-  glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, 64);
-  glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, vcg::Point4f(0.3, 0.3, 0.3, 1.).V());
-  glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, vcg::Point4f(0.6, 0.6, 0.6, 1.).V());
-  glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, vcg::Point4f(0.5, 0.5, 0.5, 1.).V());
+  ///  Deffered shading of the final image containing normal map,
+  ///  an empty region only shows the kept image again
+  if (!emptyRegion())
+    rasterizePhongShading();
+
+  /// Queue asynchronous readback of the shaded image and reconstructed level 0
+  if (readback) {
+    if (offscreen)
+      readback->capture(fbo_output, GL_COLOR_ATTACHMENT0_EXT, fbo_lod[0], fbo_buffers[0], fbo_buffers[1]);
+    else
+      readback->capture(0, GL_BACK, fbo_lod[0], fbo_buffers[0], fbo_buffers[1]);
+  }
 
-  ///  Deffered shading of the final image containing normal map
-  rasterizePhongShading();
+  /// The kept image is shown through the back buffer, whose contents do not survive swaps
+  if (partial_updates) {
+    glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, fbo_output);
+    glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+    glDrawBuffer(GL_BACK);
+    glBlitFramebufferEXT(0, 0, canvas_width, canvas_height, 0, 0, canvas_width, canvas_height,
+			 GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    glReadBuffer(GL_BACK);
+  }
 
-  glDisable(FBO_TYPE);
+  /// Partial updates start from a whole mono frame
+  frame_kept = partial_updates && stereo_mode == STEREO_OFF && !accumulation && !software;
+  region_update = false;
 
   check_for_ogl_error("draw");
 }
@@ -478,7 +827,7 @@ void PyramidPointRendererBase::createFBO() {
     fbo_buffers[i] = GL_COLOR_ATTACHMENT0_EXT + i;
 
     glBindTexture(FBO_TYPE, fbo_textures[i]);
-    glTexImage2D(FBO_TYPE, 0, FBO_FORMAT, canvas_width, canvas_height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexImage2D(FBO_TYPE, 0, bufferFormat(i), pyramid_width, pyramid_height, 0, GL_RGBA, GL_FLOAT, NULL);
 
     glGenerateMipmapEXT(FBO_TYPE);
 
@@ -495,7 +844,7 @@ void PyramidPointRendererBase::createFBO() {
   /// create a depth buffer:
   glGenTextures(1, &fbo_depth);
   glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, fbo_depth);
-  glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT32, canvas_width, canvas_height);
+  glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT32, pyramid_width, pyramid_height);
   check_for_ogl_error("depth buffer creation");
 
   fbo_lod.resize(levels_count);
@@ -505,14 +854,6 @@ void PyramidPointRendererBase::createFBO() {
   /// now attach all textures to fbos, each fbo stores one mipmap level of all render targets
   for (int level = 0; level < levels_count; level++) {
 
-    int dim = 1024/pow(2.0, double(level));
-    // fbo_lod[level] = new QGLFramebufferObject(dim, dim, FBO_TYPE);		
-		
-    // if (!fbo_lod[level]->isValid())
-    //   std::cout << level << " PyramidPointRenderer: invalid FBO\n";	  
-
-    //  fbo_lod[level]->bind();
-
     glGenFramebuffersEXT(1, &fbo_lod[level]);
     glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_lod[level]);
     // for each level: attach all render targets to the fbo
@@ -521,6 +862,11 @@ void PyramidPointRendererBase::createFBO() {
       glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, fbo_buffers[i], FBO_TYPE, fbo_textures[i], level);
     }
     check_for_ogl_error("fbo attachment");
+
+    /// the padding outside the canvas is never written, it must read as empty
+    glDrawBuffers(fbo_buffers_count, fbo_buffers);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
     //checkFramebufferStatus( __func__ );
 
     //fbo_lod[level]->release();
@@ -542,6 +888,398 @@ void PyramidPointRendererBase::createFBO() {
   check_for_ogl_error("fbo_mipmap");
 }
 
+/**
+ * Turns offscreen rendering of the shaded image on/off.
+ * The offscreen buffer has the canvas size, independent of the window.
+ * @param o Offscreen state.
+ **/
+void PyramidPointRendererBase::setOffscreen ( bool o ) {
+
+  if (o && !offscreen) {
+    glGenRenderbuffersEXT(1, &output_color);
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, output_color);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, canvas_width, canvas_height);
+
+    glGenFramebuffersEXT(1, &fbo_output);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_output);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+				 GL_RENDERBUFFER_EXT, output_color);
+    checkFramebufferStatus( __func__ );
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    check_for_ogl_error("offscreen output");
+  }
+  else if (!o && offscreen) {
+    glDeleteFramebuffersEXT(1, &fbo_output);
+    glDeleteRenderbuffersEXT(1, &output_color);
+    fbo_output = output_color = 0;
+  }
+  offscreen = o;
+}
+
+/**
+ * Loads a shader pair, defining KERNEL_SIZE in the fragment shader
+ * right after its #version line (which must come first).
+ * @param shader Shader pair to be loaded.
+ * @param vert Vertex shader file name.
+ * @param frag Fragment shader file name.
+ **/
+void PyramidPointRendererBase::loadKernelShader ( ProgramVF &shader, const char *vert, const char *frag ) {
+
+  std::ifstream vert_file (vert), frag_file (frag);
+  std::stringstream vert_source, frag_source;
+  vert_source << vert_file.rdbuf();
+  frag_source << frag_file.rdbuf();
+  if (!vert_file || !frag_file)
+    cerr << "failed to load shader files " << vert << " " << frag << endl;
+
+  std::ostringstream define;
+  define << "#define KERNEL_SIZE " << kernel_size << "\n";
+
+  std::string source = frag_source.str();
+  size_t position = source.find("#version");
+  if (position == std::string::npos)
+    position = 0;
+  else if ((position = source.find('\n', position)) == std::string::npos)
+    position = source.size();
+  else
+    ++position;
+  source.insert(position, define.str());
+
+  shader.SetSources(vert_source.str().c_str(), source.c_str());
+  ScreenTriangle::bindAttribute(shader);
+}
+
+/**
+ * Loads a projection shader pair and binds its surfel inputs to the
+ * attributes Object::render feeds. Must be followed by linking.
+ * @param shader Shader pair to be loaded.
+ * @param vert Vertex shader file name.
+ * @param frag Fragment shader file name.
+ **/
+void PyramidPointRendererBase::loadProjectionShader ( ProgramVF &shader, const char *vert, const char *frag ) {
+
+  shader.LoadSources(vert, frag);
+
+  GLuint program = shader.prog.ObjectID();
+  glBindAttribLocation(program, Object::POSITION_ATTRIBUTE, "surfel_position");
+  glBindAttribLocation(program, Object::NORMAL_ATTRIBUTE, "surfel_normal");
+  glBindAttribLocation(program, Object::COLOR_ATTRIBUTE, "surfel_color");
+  glBindAttribLocation(program, Object::AXES_ATTRIBUTE, "surfel_axes");
+  glBindAttribLocation(program, Object::CLUSTER_ORIGIN_ATTRIBUTE, "cluster_origin");
+  glBindAttribLocation(program, Object::CLUSTER_STEP_ATTRIBUTE, "cluster_step");
+}
+
+/**
+ * Creates the shaders of the renderer and resolves the locations of
+ * their per level and per object uniforms.
+ **/
+void PyramidPointRendererBase::loadShaders ( void ) {
+
+  createShaders();
+
+  resolveLevelUniforms(mShaderAnalysis, analysis_uniforms);
+  resolveLevelUniforms(mShaderSynthesis, synthesis_uniforms);
+  resolveProjectionUniforms();
+}
+
+/**
+ * Looks up the per level uniforms of a linked screen pass shader once,
+ * instead of by name at every level of every frame.
+ * @param shader Linked shader.
+ * @param uniforms Resulting locations, -1 for the uniforms the shader does not use.
+ **/
+void PyramidPointRendererBase::resolveLevelUniforms ( ProgramVF &shader, LevelUniforms &uniforms ) {
+
+  GLuint program = shader.prog.ObjectID();
+  uniforms.level = glGetUniformLocation(program, "level");
+  uniforms.offset = glGetUniformLocation(program, "offset");
+  uniforms.level_ratio = glGetUniformLocation(program, "level_ratio");
+  uniforms.half_pixel_size = glGetUniformLocation(program, "half_pixel_size");
+  uniforms.canvas_ratio = glGetUniformLocation(program, "canvas_ratio");
+  uniforms.pixel_size = glGetUniformLocation(program, "pixel_size");
+  uniforms.level_size = glGetUniformLocation(program, "level_size");
+}
+
+/**
+ * Looks up the per object uniforms of the linked projection shader once,
+ * instead of by name for every object of every frame.
+ **/
+void PyramidPointRendererBase::resolveProjectionUniforms ( void ) {
+
+  GLuint program = mShaderProjection.prog.ObjectID();
+  ProjectionUniforms &uniforms = projection_uniforms;
+  uniforms.mvp = glGetUniformLocation(program, "mvp");
+  uniforms.modelview = glGetUniformLocation(program, "modelview");
+  uniforms.normal_matrix = glGetUniformLocation(program, "normal_matrix");
+  uniforms.canvas_size = glGetUniformLocation(program, "canvas_size");
+  uniforms.eye = glGetUniformLocation(program, "eye");
+  uniforms.back_face_culling = glGetUniformLocation(program, "back_face_culling");
+  uniforms.scale = glGetUniformLocation(program, "scale");
+  uniforms.quantized = glGetUniformLocation(program, "quantized");
+  uniforms.reconstruction_filter_size = glGetUniformLocation(program, "reconstruction_filter_size");
+  uniforms.mask_size = glGetUniformLocation(program, "mask_size");
+}
+
+/**
+ * Computes the size of every level and the parameters of the passes that
+ * write it, once for the canvas size. Levels are sized from the padded
+ * base level, so each one is exactly half the one below and the ratios
+ * between levels are exact; only the region covering the canvas is drawn.
+ * One more level than levels_count is kept, since synthesis reads the
+ * level above the one it writes.
+ **/
+void PyramidPointRendererBase::computeLevelParameters ( void ) {
+
+  level_parameters.resize(levels_count + 1);
+  for (int level = 0; level <= levels_count; ++level) {
+    LevelParameters &p = level_parameters[level];
+    p.width = pyramid_width / pow(2.0, level);
+    p.height = pyramid_height / pow(2.0, level);
+    p.region[0] = (canvas_width + (1 << level) - 1) >> level;
+    p.region[1] = (canvas_height + (1 << level) - 1) >> level;
+    p.pixel_size[0] = 1.0 / p.width;
+    p.pixel_size[1] = 1.0 / p.height;
+  }
+
+  for (int level = 0; level <= levels_count; ++level) {
+    LevelParameters &p = level_parameters[level];
+
+    /// analysis reads the level below
+    const LevelParameters &below = level_parameters[level > 0 ? level - 1 : 0];
+    p.offset[0] = 0.25 / below.width;
+    p.offset[1] = 0.25 / below.height;
+    p.analysis_ratio[0] = 2.0 * p.width / below.width;
+    p.analysis_ratio[1] = 2.0 * p.height / below.height;
+
+    /// synthesis reads the level above
+    const LevelParameters &above = level_parameters[level < levels_count ? level + 1 : level];
+    p.half_pixel_size[0] = 0.5 / above.width;
+    p.half_pixel_size[1] = 0.5 / above.height;
+    p.synthesis_ratio[0] = 0.5 * p.width / above.width;
+    p.synthesis_ratio[1] = 0.5 * p.height / above.height;
+    p.canvas_ratio = above.width / above.height;
+  }
+}
+
+/**
+ * Sets the viewport to a whole pyramid level, so that texture coordinates
+ * over the viewport address the level exactly, and the scissor to the part
+ * of the level that covers the canvas. Pixels outside it are never written
+ * and stay empty.
+ * On partial frames the scissor is restricted to the update region, grown
+ * at each level by the reach of the synthesis kernels into the level
+ * above, so that every pixel synthesized in the region only reads pixels
+ * synthesized in this frame.
+ * @param level Pyramid level.
+ * @param partial Restrict the scissor on partial frames.
+ **/
+void PyramidPointRendererBase::setLevelViewport ( int level, bool partial ) {
+
+  const LevelParameters &p = level_parameters[level];
+  glViewport(0, 0, (GLsizei)p.width, (GLsizei)p.height);
+  if (!region_update || !partial) {
+    glScissor(0, 0, p.region[0], p.region[1]);
+    return;
+  }
+
+  /// the four closest pixels of the level above, and a texel for rounding
+  const GLint reach = 2;
+  GLint x0 = update_region[0], y0 = update_region[1];
+  GLint x1 = x0 + update_region[2], y1 = y0 + update_region[3];
+  for (int l = 1; l <= level; ++l) {
+    x0 = (x0 >> 1) - reach;
+    y0 = (y0 >> 1) - reach;
+    x1 = ((x1 + 1) >> 1) + reach;
+    y1 = ((y1 + 1) >> 1) + reach;
+  }
+  x0 = max(x0, 0);
+  y0 = max(y0, 0);
+  x1 = min(x1, p.region[0]);
+  y1 = min(y1, p.region[1]);
+  glScissor(x0, y0, max(x1 - x0, 0), max(y1 - y0, 0));
+}
+
+/**
+ * Enables the scissor over the update region of a partial frame,
+ * for the clears and the projection; whole frames are not restricted.
+ **/
+void PyramidPointRendererBase::scissorRegion ( void ) {
+  if (region_update) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(update_region[0], update_region[1], update_region[2], update_region[3]);
+  }
+}
+
+/**
+ * Turns occlusion culling of surfel clusters on/off.
+ * @param c Occlusion culling state.
+ **/
+void PyramidPointRendererBase::setOcclusionCulling ( bool c ) {
+  // the culler keeps a single camera per frame, and culled clusters would miss their share of accumulated samples
+  if (stereo_mode != STEREO_OFF || accumulation)
+    c = false;
+  if (c && !culler)
+    culler = new OcclusionCuller(canvas_width, canvas_height, pyramid_width, pyramid_height);
+  else if (!c && culler) {
+    delete culler;
+    culler = NULL;
+  }
+}
+
+/**
+ * Turns accumulation of the samples of successive frames on/off, in the
+ * persistent projection buffers.
+ * Occlusion culling is turned off while accumulation is on.
+ * @param a Accumulation state.
+ **/
+void PyramidPointRendererBase::setAccumulation ( bool a ) {
+
+  if (a != accumulation)
+    keep_samples = false;
+  accumulation = a;
+  if (a)
+    setOcclusionCulling(false);
+  updateProjectionBuffers();
+}
+
+/**
+ * Creates the persistent projection buffers while accumulation or partial
+ * updates need them, and deletes them otherwise. They have the layout of
+ * level 0 and their own depth buffer.
+ **/
+void PyramidPointRendererBase::updateProjectionBuffers ( void ) {
+
+  bool needed = accumulation || partial_updates;
+  if (needed && !fbo_projection) {
+    projection_textures = new GLuint[fbo_buffers_count];
+    glGenTextures(fbo_buffers_count, projection_textures);
+    glGenFramebuffersEXT(1, &fbo_projection);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_projection);
+    for (int i = 0; i < fbo_buffers_count; i++) {
+      glBindTexture(FBO_TYPE, projection_textures[i]);
+      glTexImage2D(FBO_TYPE, 0, bufferFormat(i), canvas_width, canvas_height, 0, GL_RGBA, GL_FLOAT, NULL);
+      glTexParameteri(FBO_TYPE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(FBO_TYPE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, fbo_buffers[i], FBO_TYPE, projection_textures[i], 0);
+    }
+    glBindTexture(FBO_TYPE, 0);
+
+    glGenRenderbuffersEXT(1, &projection_depth);
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, projection_depth);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT32, canvas_width, canvas_height);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+				 GL_RENDERBUFFER_EXT, projection_depth);
+    checkFramebufferStatus( __func__ );
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    check_for_ogl_error("projection buffers");
+  }
+  else if (!needed && fbo_projection) {
+    glDeleteFramebuffersEXT(1, &fbo_projection);
+    glDeleteRenderbuffersEXT(1, &projection_depth);
+    glDeleteTextures(fbo_buffers_count, projection_textures);
+    delete [] projection_textures;
+    projection_textures = NULL;
+    fbo_projection = projection_depth = 0;
+  }
+}
+
+/**
+ * Turns projection of the samples on the CPU on/off.
+ * @param s Software projection state.
+ **/
+void PyramidPointRendererBase::setSoftwareProjection ( bool s ) {
+  if (s && !software)
+    software = new SoftwareProjector(canvas_width, canvas_height, fbo_buffers_count, pyramid_width, pyramid_height);
+  else if (!s && software) {
+    delete software;
+    software = NULL;
+  }
+}
+
+/**
+ * Turns partial updates on/off. The shaded image is rendered to the
+ * offscreen output, which keeps it between frames, and the samples are
+ * projected into the persistent projection buffers, so that level 0
+ * outside the region holds projected samples rather than the
+ * reconstruction of the last frame.
+ * @param p Partial updates state.
+ **/
+void PyramidPointRendererBase::setPartialUpdates ( bool p ) {
+  partial_updates = p;
+  frame_kept = false;
+  setOffscreen(p);
+  updateProjectionBuffers();
+}
+
+/**
+ * Restricts the next frame to a region of the canvas, if the buffers
+ * still hold the previous frame and no mode rebuilds them every frame
+ * (stereo, accumulation and software projection) or skips clusters in
+ * them (occlusion culling).
+ * @param region x, y, width and height in pixels, NULL for a whole frame.
+ * @return True if the frame is partial.
+ **/
+bool PyramidPointRendererBase::setUpdateRegion ( const int * region ) {
+
+  region_update = region && frame_kept && stereo_mode == STEREO_OFF && !accumulation && !software && !culler;
+  if (region_update) {
+    int x0 = max(region[0], 0), y0 = max(region[1], 0);
+    int x1 = min(region[0] + region[2], canvas_width), y1 = min(region[1] + region[3], canvas_height);
+    update_region[0] = x0;
+    update_region[1] = y0;
+    update_region[2] = max(x1 - x0, 0);
+    update_region[3] = max(y1 - y0, 0);
+  }
+  return region_update;
+}
+
+/**
+ * Sets side by side stereo rendering.
+ * Occlusion culling is turned off while stereo is on.
+ * @param mode STEREO_OFF, STEREO_SHARED or STEREO_TWO_PASS.
+ * @param gap Empty columns between the eyes.
+ **/
+void PyramidPointRendererBase::setStereo ( int mode, int gap ) {
+  stereo_mode = mode;
+  stereo_gap = max(gap, 0);
+  if (stereo_mode != STEREO_OFF)
+    setOcclusionCulling(false);
+}
+
+/**
+ * Prepares the projection of one eye: sets its viewport, the left or
+ * right half of the canvas without the gap. In two pass mode the
+ * projection level is cleared for the right eye, after the left eye
+ * has been reconstructed and shaded.
+ * @param eye 0 for the left eye, 1 for the right eye.
+ **/
+void PyramidPointRendererBase::beginEye ( int eye ) {
+  int eye_width = (canvas_width - stereo_gap) / 2;
+
+  if (stereo_mode == STEREO_TWO_PASS && eye > 0) {
+    clearPyramid();
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+  }
+
+  glViewport(eye * (canvas_width - eye_width), 0, eye_width, canvas_height);
+}
+
+/**
+ * Binds the destination of the shaded image, the back buffer or
+ * the offscreen output.
+ **/
+void PyramidPointRendererBase::bindOutputBuffer ( void ) {
+  if (offscreen) {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_output);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+  }
+  else {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    glDrawBuffer(GL_BACK);
+  }
+}
+
 // QString PyramidPointRendererBase::loadShaderSource(const QString& filename) const {
   
 //   QString res;
@@ -13,6 +13,9 @@
 #include <cassert>
 
 #include "point_based_renderer.h"
+#include "occlusion_culler.h"
+#include "software_projector.h"
+#include "screen_triangle.h"
 
 #define FBO_TYPE GL_TEXTURE_2D
 #define FBO_FORMAT GL_RGBA32F
@@ -26,20 +29,79 @@
 class PyramidPointRendererBase : public PointBasedRenderer
 {
  private:
+	void rasterizePyramid ( bool timed = false );
+	void readTimers ( void );
+	void readOverdraw ( void );
+
+	void updateActiveLevels ( void );
+	void computeLevelParameters ( void );
+
+ protected:
 	virtual void rasterizeAnalysisPyramid( void );
 	virtual void rasterizeSynthesisPyramid( void );
 	virtual void rasterizePhongShading(void);
 
- protected:
+	/// Sets extra uniforms of the bound projection shader for an object.
+	virtual void projectionUniforms ( const Object * ) {}
+
+	virtual void probeLevels ( void );
+
+	void lightUniforms ( void );
+
+	void cameraUniforms ( void );
+
+	void setLevelViewport ( int level, bool partial = true );
+
+	void scissorRegion ( void );
+
+	/// Partial frame where nothing changed.
+	bool emptyRegion ( void ) const { return region_update && (update_region[2] <= 0 || update_region[3] <= 0); }
 
   	void createFBO();
 
-	void projectSurfels( const Object * const );
+	void projectSurfels( const Object * const, const vector<unsigned char> *skip = NULL );
+
+	void clearPyramid ( void );
+
+	void copyProjection ( void );
+
+	void updateProjectionBuffers ( void );
+
+	/// Internal format of pyramid attachment i; normals and depths need floats.
+	GLenum bufferFormat ( int i ) const { return i < 2 ? FBO_FORMAT : attribute_format; }
+
+	/// Framebuffer the samples are projected into.
+	GLuint projectionBuffer ( void ) const { return fbo_projection ? fbo_projection : fbo_lod[0]; }
+
+	void loadKernelShader ( ProgramVF &shader, const char *vert, const char *frag );
+
+	static void loadProjectionShader ( ProgramVF &shader, const char *vert, const char *frag );
+
+	/// Locations of the per level uniforms of a screen pass, -1 where unused.
+	struct LevelUniforms {
+	  GLint level, offset, level_ratio, half_pixel_size, canvas_ratio, pixel_size, level_size;
+	};
+
+	static void resolveLevelUniforms ( ProgramVF &shader, LevelUniforms &uniforms );
+
+	/// Locations of the per object uniforms of the projection shader, -1 where unused.
+	struct ProjectionUniforms {
+	  GLint mvp, modelview, normal_matrix, canvas_size, eye, back_face_culling, scale, quantized;
+	  GLint reconstruction_filter_size, mask_size;
+	};
+
+	void resolveProjectionUniforms ( void );
 
 	const void activateTexture(const int text_id, const int target_id);
 
 	const void rasterizePixels(void);
 
+	void bindOutputBuffer ( void );
+
+
+	/// Largest splat extent in world space relative to the surfel radius,
+	/// used to grow cluster boxes for culling.
+	float cullingRadiusScale ( void ) const { return 2.0 * reconstruction_filter_size; }
 
 	void resetPointers ( void ) {   
 		fbo_buffers = NULL;
@@ -50,22 +112,49 @@ class PyramidPointRendererBase : public PointBasedRenderer
  public:
 	PyramidPointRendererBase();
 	PyramidPointRendererBase(int w, int h);
-	PyramidPointRendererBase(int w, int h, int fbos);
+	PyramidPointRendererBase(int w, int h, int fbos, GLenum attributes = FBO_FORMAT);
 	~PyramidPointRendererBase();
 
 	void init ( void );
 
 	virtual void createShaders ( void ) = 0;
 
+	void loadShaders ( void );
+
 	void draw();
 	void clearBuffers (void);
 	void projectSamples (Object* const obj );
 	void interpolate ( void );
+
+	void setOffscreen ( bool o );
+	void setOcclusionCulling ( bool c );
+	void setStereo ( int mode, int gap );
+	void setAccumulation ( bool a );
+	void setKeepSamples ( bool k ) { keep_samples = k; }
+	void setSoftwareProjection ( bool s );
+	void setPartialUpdates ( bool p );
+	bool setUpdateRegion ( const int * region );
+	void setOverdrawMode ( int m ) { overdraw_mode = m; }
+	void setOverdrawCounters ( bool c ) { overdraw_counters = c; }
+	void beginEye ( int eye );
+
+	void getPyramidTimes ( double &analysis, double &synthesis ) const {
+		analysis = analysis_time;
+		synthesis = synthesis_time;
+	}
+
+	void getOverdraw ( double &points, double &fragments ) const {
+		points = projected_points;
+		fragments = written_fragments;
+	}
 	
 	protected:
 	/// Number of frame buffer object attachments.
 	int fbo_buffers_count;
 
+	/// Internal format of the attachments after the first two (extra surfel attributes).
+	GLenum attribute_format;
+
 	/// Shaders using VCG lib
 	ProgramVF mShaderProjection;
 	ProgramVF mShaderAnalysis;
@@ -75,12 +164,73 @@ class PyramidPointRendererBase : public PointBasedRenderer
 	/// Textures names to pass as uniform to shaders
 	string *shader_texture_names;
 
+	/// Per level uniform locations of the analysis, synthesis and probe shaders.
+	LevelUniforms analysis_uniforms;
+	LevelUniforms synthesis_uniforms;
+	LevelUniforms probe_uniforms;
+
+	/// Per object uniform locations of the projection shader.
+	ProjectionUniforms projection_uniforms;
+
+	/// Parameters of the passes writing each level, computed once for the canvas size.
+	struct LevelParameters {
+	  /// Padded level size, pixel size and size of the region covering the canvas.
+	  GLfloat width, height;
+	  GLfloat pixel_size[2];
+	  GLint region[2];
+	  /// Analysis: quarter pixel of the level below and size ratio to it.
+	  GLfloat offset[2];
+	  GLfloat analysis_ratio[2];
+	  /// Synthesis: half pixel of the level above, size ratio to it and its aspect.
+	  GLfloat half_pixel_size[2];
+	  GLfloat synthesis_ratio[2];
+	  GLfloat canvas_ratio;
+	};
+	vector<LevelParameters> level_parameters;
+
 	/// The application-created framebuffer object.
 	vector<GLuint> fbo_lod;
 
 	/// Framebuffer for depth test.
 	GLuint fbo_depth;
 
+	/// Offscreen framebuffer and color renderbuffer for the shaded image.
+	GLuint fbo_output;
+	GLuint output_color;
+
+	/// Flag to render the shaded image offscreen instead of to the back buffer
+	bool offscreen;
+
+	/// Occlusion culling of surfel clusters, NULL when disabled.
+	OcclusionCuller *culler;
+
+	/// Persistent projection buffers, copied to level 0 before analysis;
+	/// 0 unless accumulation or partial updates are on.
+	GLuint fbo_projection;
+	GLuint *projection_textures;
+	GLuint projection_depth;
+
+	/// Accumulate the samples of successive frames, and keep them when clearing.
+	bool accumulation;
+	bool keep_samples;
+
+	/// CPU projection of the samples, NULL when projecting on the GPU.
+	SoftwareProjector *software;
+
+	/// Keep every frame for partial updates, shown from the offscreen output.
+	bool partial_updates;
+
+	/// The buffers hold a whole frame that a partial update may start from.
+	bool frame_kept;
+
+	/// The current frame only redoes update_region (x, y, width, height).
+	bool region_update;
+	GLint update_region[4];
+
+	/// Stereo mode and number of columns between the eyes.
+	int stereo_mode;
+	int stereo_gap;
+
 	/// usually fboBuffers[i] == GL_COLOR_ATTACHMENT0_EXT + i, 
 	/// but we don't rely on this assumption
 	GLuint* fbo_buffers;
@@ -96,11 +246,59 @@ class PyramidPointRendererBase : public PointBasedRenderer
 	/// Number of pyramid levels.
 	int levels_count;
 
+	/// Size of the base level, the canvas padded to a multiple of
+	/// 2^(levels_count-1) so that every level halves exactly.
+	int pyramid_width, pyramid_height;
+
+	/// Projected radius scale, normalized to the padded height.
+	float pyramidScale ( void ) const { return scale_factor * canvas_height / pyramid_height; }
+
+	/// Number of levels used by analysis and synthesis in the current frame,
+	/// levels_count unless adaptive levels are on.
+	int active_levels;
+
+	/// Occlusion queries counting the holes of each level (see shader_level_probe.frag).
+	vector<GLuint> level_queries;
+
+	/// Number of levels probed by the queries in flight, 0 if none.
+	int probed_levels;
+
+	/// Frames since all levels were last used.
+	int frames_since_full;
+
+	ProgramVF mShaderProbe;
+
+	/// Timer queries of analysis and synthesis for two frames, used alternately.
+	GLuint timer_queries[2][2];
+	bool timer_pending[2];
+	int timer_slot;
+
+	/// Newest GPU times in milliseconds.
+	double analysis_time, synthesis_time;
+
+	/// Overdraw reduction of the projection (OVERDRAW_*).
+	int overdraw_mode;
+
+	/// Count points and fragments with OVERDRAW_OFF too.
+	bool overdraw_counters;
+
+	/// Cluster order of the object being projected, shared by its passes.
+	Object::ClusterOrder cluster_order;
+
+	/// Queries counting the points and the written fragments of each projection
+	/// pass (two per pass), for two frames used alternately.
+	vector<GLuint> overdraw_queries[2];
+	int overdraw_used[2];
+	int overdraw_slot;
+
+	/// Newest counts of projected points and written fragments.
+	double projected_points, written_fragments;
+
 	/// Current rasterize level
 	int cur_level;
 
-	GLfloat vertices[4][2];
-	GLfloat texcoors0[4][2];  
+	/// Geometry of the screen space passes.
+	ScreenTriangle *screen_triangle;
 
 };
 
@@ -9,8 +9,10 @@
 
 /**
  * Default constructor.
+ * Colors have 8 bits per channel, so the color pyramid is RGBA8 instead
+ * of floats; the pull-push averages are rounded to 8 bits at every level.
  **/
-PyramidPointRendererColor::PyramidPointRendererColor(int w, int h) : PyramidPointRendererBase(w, h, 3) {
+PyramidPointRendererColor::PyramidPointRendererColor(int w, int h) : PyramidPointRendererBase(w, h, 3, GL_RGBA8) {
 }
 
 void PyramidPointRendererColor::createShaders ( void ) {
@@ -24,7 +26,7 @@ void PyramidPointRendererColor::createShaders ( void ) {
   bool link;
 
   //  mShaderProjection.SetSources(loadShaderSource("shader_point_projection_color.vert").toAscii().data(), loadShaderSource("shader_point_projection_color.frag").toAscii().data());
-  mShaderProjection.LoadSources("shaders/shader_point_projection_color.vert", "shaders/shader_point_projection_color.frag");
+  loadProjectionShader(mShaderProjection, "shaders/shader_point_projection_color.vert", "shaders/shader_point_projection_color.frag");
   link = mShaderProjection.prog.Link();
 
   std::string compileinfo = mShaderProjection.vshd.InfoLog();  
@@ -32,7 +34,7 @@ void PyramidPointRendererColor::createShaders ( void ) {
   assert (link == 1);
 
   //  mShaderAnalysis.SetSources(loadShaderSource("shader_analysis_color.vert").toAscii().data(), loadShaderSource("shader_analysis_color.frag").toAscii().data());
-  mShaderAnalysis.LoadSources("shaders/shader_analysis_color.vert", "shaders/shader_analysis_color.frag");
+  ScreenTriangle::loadSources(mShaderAnalysis, "shaders/shader_analysis_color.vert", "shaders/shader_analysis_color.frag");
   link = mShaderAnalysis.prog.Link();
 
   compileinfo = mShaderAnalysis.fshd.InfoLog();  
@@ -40,7 +42,7 @@ void PyramidPointRendererColor::createShaders ( void ) {
   assert (link == 1);
 
   //  mShaderSynthesis.SetSources(loadShaderSource("shader_synthesis_color.vert").toAscii().data(), loadShaderSource("shader_synthesis_color.frag").toAscii().data());
-  mShaderSynthesis.LoadSources("shaders/shader_synthesis_color.vert", "shaders/shader_synthesis_color.frag");
+  ScreenTriangle::loadSources(mShaderSynthesis, "shaders/shader_synthesis_color.vert", "shaders/shader_synthesis_color.frag");
   link = mShaderSynthesis.prog.Link();
 
   compileinfo = mShaderSynthesis.fshd.InfoLog();  
@@ -48,7 +50,7 @@ void PyramidPointRendererColor::createShaders ( void ) {
   assert (link == 1);
 
   //  mShaderPhong.SetSources(loadShaderSource("shader_phong_color.vert").toAscii().data(), loadShaderSource("shader_phong_color.frag").toAscii().data());
-  mShaderPhong.LoadSources("shaders/shader_phong_color.vert", "shaders/shader_phong_color.frag");
+  ScreenTriangle::loadSources(mShaderPhong, "shaders/shader_phong_color.vert", "shaders/shader_phong_color.frag");
   link = mShaderPhong.prog.Link();
 
   compileinfo = mShaderPhong.fshd.InfoLog();  
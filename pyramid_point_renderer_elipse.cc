@@ -0,0 +1,74 @@
+/*
+** pyramid_point_renderer_elipse.cc Pyramid Point Based Rendering of elliptical surfels.
+**
+**
+**   history:	created  20-Nov-09
+*/
+
+#include "pyramid_point_renderer_elipse.h"
+
+
+/**
+ * Default constructor, the ellipse axes need a float third buffer.
+ **/
+PyramidPointRendererElipse::PyramidPointRendererElipse(int w, int h) : PyramidPointRendererBase(w, h, 3) {
+}
+
+/**
+ * Installs the shaders using the GLSL Kernel class.
+ **/
+void PyramidPointRendererElipse::createShaders ( void ) {
+
+  // Store texture names to be passed as uniforms
+  shader_texture_names = new string[fbo_buffers_count];
+  shader_texture_names[0] = "textureA";
+  shader_texture_names[1] = "textureB";
+  shader_texture_names[2] = "textureC";
+
+  bool link;
+
+  loadProjectionShader(mShaderProjection, "shaders/shader_point_projection_elipse.vert", "shaders/shader_point_projection_elipse.frag");
+  link = mShaderProjection.prog.Link();
+
+  std::string compileinfo = mShaderProjection.vshd.InfoLog();
+  std::cout << "Projection Vert shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  loadKernelShader(mShaderAnalysis, "shaders/shader_analysis.vert", "shaders/shader_analysis_elipse.frag");
+  link = mShaderAnalysis.prog.Link();
+
+  compileinfo = mShaderAnalysis.fshd.InfoLog();
+  std::cout << "Analysis Frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  loadKernelShader(mShaderSynthesis, "shaders/shader_synthesis.vert", "shaders/shader_synthesis_elipse.frag");
+  link = mShaderSynthesis.prog.Link();
+
+  compileinfo = mShaderSynthesis.fshd.InfoLog();
+  std::cout << "Synthesis Frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  // shading only reads the normals, as for circular surfels
+  ScreenTriangle::loadSources(mShaderPhong, "shaders/shader_phong.vert", "shaders/shader_phong.frag");
+  link = mShaderPhong.prog.Link();
+
+  compileinfo = mShaderPhong.fshd.InfoLog();
+  std::cout << "Phong Frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  check_for_ogl_error("shaders loading");
+}
+
+/**
+ * Pull phase, as in the other pyramids; the ellipse test also needs
+ * the canvas aspect and the smallest minor axis.
+ **/
+void PyramidPointRendererElipse::rasterizeAnalysisPyramid( void ) {
+
+  mShaderAnalysis.prog.Bind();
+  mShaderAnalysis.prog.Uniform("canvas_ratio", (GLfloat)pyramid_width / pyramid_height);
+  mShaderAnalysis.prog.Uniform("minimum_size", (GLfloat)(minimum_radius_size));
+  mShaderAnalysis.prog.Unbind();
+
+  PyramidPointRendererBase::rasterizeAnalysisPyramid();
+}
@@ -0,0 +1,43 @@
+/*
+** pyramid_point_renderer_elipse.h Pyramid Point Based Rendering of elliptical surfels header.
+**
+**
+**   history:	created  20-Nov-09
+*/
+
+
+#ifndef __PYRAMID_POINT_RENDERER_ELIPSE_H__
+#define __PYRAMID_POINT_RENDERER_ELIPSE_H__
+
+#include <cmath>
+#include <cassert>
+
+#include "pyramid_point_renderer_base.h"
+
+/**
+ * Pyramid renderer for anisotropic surfels, with the principal axes of
+ * every projected ellipse carried through the pyramid instead of being
+ * derived from the normal.
+ * The first two buffers keep the layout of the other pyramids, with the
+ * major semi-axis as radius, so that occlusion culling and the level
+ * probes work unchanged; the third one holds (cos, sin) of twice the
+ * major axis angle and the minor semi-axis, which average linearly.
+ * Circular surfels are drawn as ellipses with equal axes.
+ **/
+class PyramidPointRendererElipse : public PyramidPointRendererBase
+{
+ private:
+
+  void createShaders ( void );
+
+  void rasterizeAnalysisPyramid ( void );
+
+ public:
+
+  PyramidPointRendererElipse(int w, int h);
+
+  /// The CPU projector only writes the circular layout.
+  void setSoftwareProjection ( bool ) { PyramidPointRendererBase::setSoftwareProjection(false); }
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+** pyramid_point_renderer_er.cc Pyramid Point Based Rendering with Ellipse Rasterization.
+**
+**
+**   history:	created  24-Apr-08
+*/
+
+#include "pyramid_point_renderer_er.h"
+
+
+/**
+ * Default constructor, creates the full resolution reconstruction buffers.
+ * Colors have 8 bits per channel as in the color renderer.
+ **/
+PyramidPointRendererER::PyramidPointRendererER(int w, int h) : PyramidPointRendererBase(w, h, 3, GL_RGBA8),
+							       gpu_mask_size(1), synthesis_result(0), splat_levels(1) {
+
+  glGenTextures(4, &synthesis_textures[0][0]);
+  glGenFramebuffersEXT(2, fbo_synthesis);
+  for (int j = 0; j < 2; ++j) {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_synthesis[j]);
+    for (int i = 0; i < 2; ++i) {
+      glBindTexture(FBO_TYPE, synthesis_textures[j][i]);
+      glTexImage2D(FBO_TYPE, 0, FBO_FORMAT, pyramid_width, pyramid_height, 0, GL_RGBA, GL_FLOAT, NULL);
+      glTexParameteri(FBO_TYPE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(FBO_TYPE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(FBO_TYPE, GL_TEXTURE_WRAP_S, GL_CLAMP);
+      glTexParameteri(FBO_TYPE, GL_TEXTURE_WRAP_T, GL_CLAMP);
+      glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT + i, FBO_TYPE, synthesis_textures[j][i], 0);
+    }
+  }
+  glBindTexture(FBO_TYPE, 0);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+  check_for_ogl_error("synthesis buffers");
+}
+
+PyramidPointRendererER::~PyramidPointRendererER() {
+  glDeleteFramebuffersEXT(2, fbo_synthesis);
+  glDeleteTextures(4, &synthesis_textures[0][0]);
+}
+
+/**
+ * Starts a frame with level 0 alone, raised by every projected object.
+ **/
+void PyramidPointRendererER::clearBuffers ( void ) {
+  splat_levels = 1;
+  PyramidPointRendererBase::clearBuffers();
+}
+
+/**
+ * Sets the uniforms deciding in which level each projected ellipse is
+ * splatted, and raises the levels of the frame up to the level of the
+ * largest ellipse the object may project: its largest radius at the point
+ * of its bounding sphere closest to the eye.
+ * @param obj Object being projected.
+ **/
+void PyramidPointRendererER::projectionUniforms ( const Object *obj ) {
+  glUniform1f(projection_uniforms.reconstruction_filter_size, (GLfloat)(reconstruction_filter_size));
+  glUniform1i(projection_uniforms.mask_size, (GLint)gpu_mask_size);
+
+  const SurfelBounds &bounds = obj->getBounds();
+  float distance = (eye - bounds.center).Norm() - bounds.radius;
+  if (bounds.empty() || distance <= 0.0f) {
+    splat_levels = levels_count;
+    return;
+  }
+
+  /// as targetLevel in the projection shader
+  float radius = bounds.max_radius * pyramidScale() / distance;
+  float footprint = 4.0f * radius * sqrt(reconstruction_filter_size) * pyramid_height;
+  int level = 0;
+  for (; footprint > 2*gpu_mask_size + 1 && level < levels_count - 1; footprint *= 0.5f)
+    ++level;
+  splat_levels = max(splat_levels, level + 1);
+}
+
+/**
+ * Pull phase, as in the other pyramids but up to the level of the largest
+ * ellipse projected in this frame: every level may hold ellipses to be splatted.
+ **/
+void PyramidPointRendererER::rasterizeAnalysisPyramid( void ) {
+
+  mShaderAnalysis.prog.Bind();
+  mShaderAnalysis.prog.Uniform("canvas_size", (GLfloat)pyramid_width, (GLfloat)pyramid_height);
+  mShaderAnalysis.prog.Uniform("mask_size", (GLint)gpu_mask_size);
+  mShaderAnalysis.prog.Unbind();
+
+  // persistent projections may hold the ellipses of earlier frames
+  active_levels = fbo_projection ? levels_count : splat_levels;
+
+  PyramidPointRendererBase::rasterizeAnalysisPyramid();
+}
+
+/**
+ * Splats the ellipses of each level into the full resolution reconstruction,
+ * one pass per level ping-ponging between the two synthesis framebuffers.
+ **/
+void PyramidPointRendererER::rasterizeSynthesisPyramid( void ) {
+
+  /// pyramid on units 0-2, reconstruction of the previous levels on units 3-4
+  for (int i = 0; i < fbo_buffers_count; ++i)
+    activateTexture(i, i);
+
+  mShaderSynthesis.prog.Bind();
+  mShaderSynthesis.prog.Uniform("canvas_size", (GLfloat)pyramid_width, (GLfloat)pyramid_height);
+  mShaderSynthesis.prog.Uniform("mask_size", (GLint)gpu_mask_size);
+  mShaderSynthesis.prog.Uniform("minimum_size", (GLfloat)(minimum_radius_size));
+  mShaderSynthesis.prog.Uniform("reconstruction_filter_size", (GLfloat)(reconstruction_filter_size));
+  mShaderSynthesis.prog.Uniform("prefilter_size", (GLfloat)(prefilter_size));
+  mShaderSynthesis.prog.Uniform("depth_test", depth_test);
+  mShaderSynthesis.prog.Uniform("elliptical_weight", elliptical_weight);
+  for (int i = 0; i < fbo_buffers_count; ++i)
+    mShaderSynthesis.prog.Uniform(shader_texture_names[i].c_str(), i);
+  mShaderSynthesis.prog.Uniform("accumA", fbo_buffers_count);
+  mShaderSynthesis.prog.Uniform("accumB", fbo_buffers_count + 1);
+
+  /// full resolution, padded as level 0
+  setLevelViewport(0);
+
+  GLuint buffers[2] = { GL_COLOR_ATTACHMENT0_EXT, GL_COLOR_ATTACHMENT1_EXT };
+  int target = 0;
+  for (int level = 0; level < active_levels; level++) {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo_synthesis[target]);
+    glDrawBuffers(2, buffers);
+
+    for (int i = 0; i < 2; ++i) {
+      glActiveTexture(GL_TEXTURE0 + fbo_buffers_count + i);
+      glBindTexture(FBO_TYPE, synthesis_textures[1 - target][i]);
+    }
+
+    glUniform1i(synthesis_uniforms.level, level);
+    glUniform2f(synthesis_uniforms.level_size, level_parameters[level].width, level_parameters[level].height);
+
+    rasterizePixels();
+
+    target = 1 - target;
+  }
+  synthesis_result = 1 - target;
+
+  mShaderSynthesis.prog.Unbind();
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+  for (int i = 0; i < fbo_buffers_count + 2; ++i)
+    activateTexture(-1, i);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+/**
+ * Deferred shading of the full resolution reconstruction.
+ **/
+void PyramidPointRendererER::rasterizePhongShading( void ) {
+
+  mShaderPhong.prog.Bind();
+  mShaderPhong.prog.Uniform("color_ambient", Mats[material_id][0], Mats[material_id][1], Mats[material_id][2], Mats[material_id][3]);
+  mShaderPhong.prog.Uniform("color_diffuse", Mats[material_id][4], Mats[material_id][5], Mats[material_id][6], Mats[material_id][7]);
+  mShaderPhong.prog.Uniform("color_specular", Mats[material_id][8], Mats[material_id][9], Mats[material_id][10], Mats[material_id][11]);
+  mShaderPhong.prog.Uniform("shininess", Mats[material_id][12]);
+  lightUniforms();
+  mShaderPhong.prog.Uniform("textureA", 0);
+  mShaderPhong.prog.Uniform("textureB", 1);
+
+  glEnable(GL_SCISSOR_TEST);
+  setLevelViewport(0);
+
+  bindOutputBuffer();
+
+  for (int i = 0; i < 2; ++i) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(FBO_TYPE, synthesis_textures[synthesis_result][i]);
+  }
+
+  rasterizePixels();
+
+  mShaderPhong.prog.Unbind();
+  glDisable(GL_SCISSOR_TEST);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glDrawBuffer(GL_BACK);
+
+  for (int i = 0; i < 2; ++i)
+    activateTexture(-1, i);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+
+/**
+ * Installs the shaders using the GLSL Kernel class.
+ **/
+void PyramidPointRendererER::createShaders ( void ) {
+
+  // Store texture names to be passed as uniforms
+  shader_texture_names = new string[fbo_buffers_count];
+  shader_texture_names[0] = "textureA";
+  shader_texture_names[1] = "textureB";
+  shader_texture_names[2] = "textureC";
+
+  bool link;
+
+  loadProjectionShader(mShaderProjection, "shaders/shader_point_projection_color_er.vert", "shaders/shader_point_projection_color_er.frag");
+  link = mShaderProjection.prog.Link();
+
+  std::string compileinfo = mShaderProjection.fshd.InfoLog();
+  std::cout << "Proj frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  ScreenTriangle::loadSources(mShaderAnalysis, "shaders/shader_analysis.vert", "shaders/shader_analysis_er.frag");
+  link = mShaderAnalysis.prog.Link();
+
+  compileinfo = mShaderAnalysis.fshd.InfoLog();
+  std::cout << "Analysis frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  ScreenTriangle::loadSources(mShaderSynthesis, "shaders/shader_synthesis_er.vert", "shaders/shader_synthesis_er.frag");
+  link = mShaderSynthesis.prog.Link();
+
+  compileinfo = mShaderSynthesis.fshd.InfoLog();
+  std::cout << "Synth Frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  ScreenTriangle::loadSources(mShaderPhong, "shaders/shader_phong_er.vert", "shaders/shader_phong_er.frag");
+  link = mShaderPhong.prog.Link();
+
+  compileinfo = mShaderPhong.fshd.InfoLog();
+  std::cout << "Phong Frag shader info : " << compileinfo << "\n";
+  assert (link == 1);
+
+  check_for_ogl_error("shaders loading");
+}
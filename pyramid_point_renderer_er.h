@@ -0,0 +1,68 @@
+/*
+** pyramid_point_renderer_er.h Pyramid Point Based Rendering with Ellipse Rasterization header.
+**
+**
+**   history:	created  24-Apr-08
+*/
+
+#ifndef __PYRAMID_POINT_RENDERER_ER_H__
+#define __PYRAMID_POINT_RENDERER_ER_H__
+
+#include <cmath>
+#include <cassert>
+
+#include "pyramid_point_renderer_base.h"
+
+/**
+ * Template variant of the pyramid renderer, always with colors.
+ * Analysis carries each ellipse up only to the first level where its
+ * footprint fits a window of (2*gpu_mask_size+1)^2 texels. Synthesis then
+ * splats the ellipses of every level straight into a full resolution
+ * reconstruction with that window, instead of filling holes level by level.
+ * Few levels are involved when the splats are small.
+ **/
+class PyramidPointRendererER : public PyramidPointRendererBase
+{
+ private:
+
+  void createShaders ( void );
+
+  void projectionUniforms ( const Object *obj );
+  void rasterizeAnalysisPyramid ( void );
+  void rasterizeSynthesisPyramid ( void );
+  void rasterizePhongShading ( void );
+
+  /// Levels follow the ellipses projected in each frame, there is nothing to probe.
+  void probeLevels ( void ) {}
+
+ public:
+
+  PyramidPointRendererER(int w, int h);
+  ~PyramidPointRendererER();
+
+  void clearBuffers ( void );
+
+  void setGpuMaskSize ( int s ) { gpu_mask_size = max(s, 1); }
+
+  /// The culler and the CPU projector only know the layout of the other pyramids.
+  void setOcclusionCulling ( bool ) { PyramidPointRendererBase::setOcclusionCulling(false); }
+  void setSoftwareProjection ( bool ) { PyramidPointRendererBase::setSoftwareProjection(false); }
+
+ private:
+
+  /// Gpu mask size (sub mask for each cpu mask pixel)
+  int gpu_mask_size;
+
+  /// Full resolution reconstruction, ping-ponged between two framebuffers with
+  /// (weighted normal, total weight) and (weighted depth, weighted color).
+  GLuint fbo_synthesis[2];
+  GLuint synthesis_textures[2][2];
+
+  /// Framebuffer holding the reconstruction of the last frame.
+  int synthesis_result;
+
+  /// Levels holding the ellipses projected in this frame, up to the largest one.
+  int splat_levels;
+};
+
+#endif
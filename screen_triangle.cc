@@ -0,0 +1,60 @@
+/*
+** screen_triangle.cc Full screen pass geometry.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "screen_triangle.h"
+
+/**
+ * Uploads the three corners once.
+ **/
+ScreenTriangle::ScreenTriangle ( void ) {
+
+  static const GLfloat corners[6] = { -1.0f, -1.0f,  3.0f, -1.0f,  -1.0f, 3.0f };
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ScreenTriangle::~ScreenTriangle ( void ) {
+  glDeleteBuffers(1, &buffer);
+}
+
+/**
+ * Draws the triangle with the bound shader over the current viewport.
+ **/
+void ScreenTriangle::draw ( void ) const {
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glVertexAttribPointer(corner_attribute, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+  glEnableVertexAttribArray(corner_attribute);
+
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  glDisableVertexAttribArray(corner_attribute);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Binds the "corner" input of a screen pass vertex shader to the corner
+ * attribute. Must be called after the sources are set and before linking.
+ * @param shader Screen pass shader.
+ **/
+void ScreenTriangle::bindAttribute ( ProgramVF &shader ) {
+  glBindAttribLocation(shader.prog.ObjectID(), corner_attribute, "corner");
+}
+
+/**
+ * Loads the sources of a screen pass shader and binds its corner input.
+ * @param shader Screen pass shader, linked afterwards by the caller.
+ * @param vert Vertex shader file.
+ * @param frag Fragment shader file.
+ **/
+void ScreenTriangle::loadSources ( ProgramVF &shader, const char *vert, const char *frag ) {
+  shader.LoadSources(vert, frag);
+  bindAttribute(shader);
+}
@@ -0,0 +1,46 @@
+/*
+** screen_triangle.h Full screen pass geometry header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SCREEN_TRIANGLE_H__
+#define __SCREEN_TRIANGLE_H__
+
+#include <GL/glew.h>
+#include <wrap/gl/shaders.h>
+
+/**
+ * One triangle covering the whole viewport, kept in a vertex buffer, for
+ * the screen space passes (analysis, synthesis, shading ...).
+ *
+ * The corners (-1,-1), (3,-1) and (-1,3) are given directly in clip
+ * coordinates through the generic attribute "corner", so the passes need
+ * no matrices: the viewport alone selects the pixels that are written.
+ * The vertex shaders of the passes compute their texture coordinates,
+ * [0, 1] over the viewport, as corner * 0.5 + 0.5.
+ **/
+class ScreenTriangle
+{
+ public:
+
+  ScreenTriangle ( void );
+  ~ScreenTriangle ( void );
+
+  void draw ( void ) const;
+
+  static void bindAttribute ( ProgramVF &shader );
+
+  static void loadSources ( ProgramVF &shader, const char *vert, const char *frag );
+
+ private:
+
+  /// Generic vertex attribute of the corners.
+  static const GLuint corner_attribute = 0;
+
+  GLuint buffer;
+};
+
+#endif
@@ -3,6 +3,13 @@
 
 #extension GL_ARB_draw_buffers : enable
 
+varying vec2 texcoord;
+
+// number of gathered pixels (4, 12 or 20), defined by the renderer
+#ifndef KERNEL_SIZE
+#define KERNEL_SIZE 12
+#endif
+
 // flag for depth test on/off
 uniform bool depth_test;
 
@@ -63,7 +70,7 @@ float pointInEllipse(in vec2 d, in float radius, in vec3 normal){
 
 void main (void) {
 
-  const int k = 12;
+  const int k = KERNEL_SIZE;
 
   vec2 tex_coord[k];
 
@@ -74,7 +81,7 @@ void main (void) {
 
   vec4 pixelA[k], pixelB[k];
 
-  vec2 center_coord = gl_TexCoord[0].st * level_ratio;
+  vec2 center_coord = texcoord * level_ratio;
 
   //up-right
   tex_coord[0].st = center_coord.st + offset.st;
@@ -87,7 +94,8 @@ void main (void) {
   //down-left
   tex_coord[3].st = center_coord.st - offset.st;
 
-  if (k == 12) {
+#if KERNEL_SIZE >= 12
+  {
     //up-right-right and up-right-up
     tex_coord[4] = tex_coord[5] = tex_coord[0];
     tex_coord[4].s += 2.0*offset.s;
@@ -108,6 +116,23 @@ void main (void) {
     tex_coord[10].s -= 2.0*offset.s;
     tex_coord[11].t -= 2.0*offset.t;
   }
+#endif
+
+#if KERNEL_SIZE == 20
+  {
+    //corners of the four by four block
+    tex_coord[12].st = tex_coord[0].st + 2.0*offset.st;
+    tex_coord[13].st = tex_coord[1].st + vec2(-2.0*offset.s, 2.0*offset.t);
+    tex_coord[14].st = tex_coord[2].st + vec2(2.0*offset.s, -2.0*offset.t);
+    tex_coord[15].st = tex_coord[3].st - 2.0*offset.st;
+
+    //one pixel further on each side, rotated to keep the fourfold symmetry
+    tex_coord[16].st = tex_coord[4].st + vec2(2.0*offset.s, 0.0);
+    tex_coord[17].st = tex_coord[7].st + vec2(0.0, 2.0*offset.t);
+    tex_coord[18].st = tex_coord[10].st - vec2(2.0*offset.s, 0.0);
+    tex_coord[19].st = tex_coord[9].st - vec2(0.0, 2.0*offset.t);
+  }
+#endif
   
 
   // Compute the front most pixel from lower level (minimum z coordinate)
@@ -1,9 +1,15 @@
 /// GLSL CODE
 
 /// Vertex Shader -- Analysis Shader
+#version 120
 
+attribute vec2 corner;
+
+varying vec2 texcoord;
+
+/// Full screen triangle, corners in clip coordinates
 void main(void)
 {
-  gl_TexCoord[0] = gl_MultiTexCoord0;
-  gl_Position = gl_ProjectionMatrix * gl_Vertex;
+  texcoord = corner * 0.5 + 0.5;
+  gl_Position = vec4(corner, 0.0, 1.0);
 }
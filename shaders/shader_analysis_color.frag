@@ -3,6 +3,8 @@
 
 #extension GL_ARB_draw_buffers : enable
 
+varying vec2 texcoord;
+
 // flag for depth test on/off
 uniform bool depth_test;
 
@@ -73,7 +75,7 @@ void main (void) {
 
   vec4 pixelA[4], pixelB[4], pixelC[4];
 	
-	vec2 center_coord = gl_TexCoord[0].st * level_ratio;
+	vec2 center_coord = texcoord * level_ratio;
 
 	//up-right
 	tex_coord[0].st = center_coord.st + offset.st;
@@ -96,7 +98,7 @@ void main (void) {
 		pixelA[i] = texture2DLod (textureA, tex_coord[i].st, float(level-1)).xyzw;   
 		if (pixelA[i].w > 0.0) {
 			pixelB[i] = texture2DLod (textureB, tex_coord[i].st, float(level-1)).xyzw;
-			dist_test = pointInEllipse(pixelB[i].zw - gl_TexCoord[0].st, pixelA[i].w, pixelA[i].xyz);
+			dist_test = pointInEllipse(pixelB[i].zw - texcoord, pixelA[i].w, pixelA[i].xyz);
 
 			if  (dist_test > -10.0)
 			{
@@ -121,11 +123,11 @@ void main (void) {
       // Check if valid gather pixel or unspecified (or ellipse out of reach set above)
       if (pixelA[i].w > 0.0) 
 		{
-		  pixelC[i] = texture2DLod (textureC, tex_coord[i].st, float(level-1)).xyzw;
-	  	
 		  // Depth test between valid in reach ellipses
 		  if ((!depth_test) || (pixelB[i].x - pixelB[i].y <= zmin))
 			{
+			  // color is only fetched for pixels that take part in the average
+			  pixelC[i] = texture2DLod (textureC, tex_coord[i].st, float(level-1)).xyzw;
 			  float w = 1.0;
 			  bufferA += pixelA[i] * w;
 
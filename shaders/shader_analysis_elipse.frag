@@ -0,0 +1,224 @@
+/* Analysis step of the elliptical surfels pyramid */
+#version 120
+
+#extension GL_ARB_draw_buffers : enable
+
+varying vec2 texcoord;
+
+// number of gathered pixels (4, 12 or 20), defined by the renderer
+#ifndef KERNEL_SIZE
+#define KERNEL_SIZE 12
+#endif
+
+// flag for depth test on/off
+uniform bool depth_test;
+
+// 2.0*size of current level / size of one level down
+uniform vec2 level_ratio;
+
+// current read level
+uniform int level;
+
+uniform vec2 offset;
+
+// canvas_width / canvas_height
+uniform float canvas_ratio;
+
+uniform float reconstruction_filter_size;
+uniform float prefilter_size;
+uniform float minimum_size;
+
+uniform sampler2D textureA;
+uniform sampler2D textureB;
+uniform sampler2D textureC;
+
+
+// tests if a point is inside an ellipse.
+// Ellipse is centered at origin and point displaced by d.
+// @param d Difference vector from center of ellipse to point.
+// @param radius Ellipse major axis length * 0.5.
+// @param axes (cos, sin) of twice the major axis angle and minor axis length * 0.5.
+float pointInEllipse(in vec2 d, in float radius, in vec3 axes){
+
+  // scale pixel distance according to screen dimensions
+  d.x *= canvas_ratio;
+
+  // half angle of the major axis direction
+  float cos_angle = sqrt(max(0.5 * (1.0 + axes.x), 0.0));
+  float sin_angle = sqrt(max(0.5 * (1.0 - axes.x), 0.0));
+  if (axes.y < 0.0)
+    sin_angle = -sin_angle;
+
+  // rotate point to ellipse coordinate system
+  vec2 rotated_pos = vec2(d.x*cos_angle + d.y*sin_angle,
+			  -d.x*sin_angle + d.y*cos_angle);
+
+  // major and minor axis
+  float a = 2.0*radius;
+  float b = 2.0*max(axes.z, minimum_size*radius);
+
+  // inside ellipse test
+  float test = ((rotated_pos.x*rotated_pos.x)/(a*a)) + ((rotated_pos.y*rotated_pos.y)/(b*b));
+
+  if (test <= reconstruction_filter_size)
+    return test;
+  else return -1.0;
+}
+
+void main (void) {
+
+  const int k = KERNEL_SIZE;
+
+  vec2 tex_coord[k];
+
+  vec4 bufferA = vec4(0.0, 0.0, 0.0, 0.0);
+  vec4 bufferB = vec4(0.0, 0.0, 0.0, 0.0);
+  vec4 bufferC = vec4(0.0, 0.0, 0.0, 0.0);
+
+  float valid_pixels = 0.0;
+
+  vec4 pixelA[k], pixelB[k], pixelC[k];
+
+  vec2 center_coord = texcoord * level_ratio;
+
+  //up-right
+  tex_coord[0].st = center_coord.st + offset.st;
+  //up-left
+  tex_coord[1].s = center_coord.s - offset.s;
+  tex_coord[1].t = center_coord.t + offset.t;
+  //down-right
+  tex_coord[2].s = center_coord.s + offset.s;
+  tex_coord[2].t = center_coord.t - offset.t;
+  //down-left
+  tex_coord[3].st = center_coord.st - offset.st;
+
+#if KERNEL_SIZE >= 12
+  {
+    //up-right-right and up-right-up
+    tex_coord[4] = tex_coord[5] = tex_coord[0];
+    tex_coord[4].s += 2.0*offset.s;
+    tex_coord[5].t += 2.0*offset.t;
+
+    //up-left-left and up-left-up
+    tex_coord[6] = tex_coord[7] = tex_coord[1];
+    tex_coord[6].s -= 2.0*offset.s;
+    tex_coord[7].t += 2.0*offset.t;
+
+    //down-right-right and down-right-down
+    tex_coord[8] = tex_coord[9] = tex_coord[2];
+    tex_coord[8].s += 2.0*offset.s;
+    tex_coord[9].t -= 2.0*offset.t;
+ 
+    //down-left-left and down-left-down
+    tex_coord[10] = tex_coord[11] = tex_coord[3];
+    tex_coord[10].s -= 2.0*offset.s;
+    tex_coord[11].t -= 2.0*offset.t;
+  }
+#endif
+
+#if KERNEL_SIZE == 20
+  {
+    //corners of the four by four block
+    tex_coord[12].st = tex_coord[0].st + 2.0*offset.st;
+    tex_coord[13].st = tex_coord[1].st + vec2(-2.0*offset.s, 2.0*offset.t);
+    tex_coord[14].st = tex_coord[2].st + vec2(2.0*offset.s, -2.0*offset.t);
+    tex_coord[15].st = tex_coord[3].st - 2.0*offset.st;
+
+    //one pixel further on each side, rotated to keep the fourfold symmetry
+    tex_coord[16].st = tex_coord[4].st + vec2(2.0*offset.s, 0.0);
+    tex_coord[17].st = tex_coord[7].st + vec2(0.0, 2.0*offset.t);
+    tex_coord[18].st = tex_coord[10].st - vec2(2.0*offset.s, 0.0);
+    tex_coord[19].st = tex_coord[9].st - vec2(0.0, 2.0*offset.t);
+  }
+#endif
+  
+
+  // Compute the front most pixel from lower level (minimum z coordinate)
+  float dist_test = 0.0;
+  float zmin = 10000.0;
+  float zmax = -10000.0;
+  float weights[k];
+  for (int i = 0; i < k; ++i) {
+    weights[i] = 0.0;
+    pixelA[i] = texture2DLod (textureA, tex_coord[i].st, float(level-1)).xyzw;
+
+    if (pixelA[i].w > 0.0) {
+      pixelB[i] = texture2DLod (textureB, tex_coord[i].st, float(level-1)).xyzw;	
+      pixelC[i] = texture2DLod (textureC, tex_coord[i].st, float(level-1)).xyzw;
+
+      vec2 dist_to_pixel = pixelB[i].zw - center_coord;
+      dist_test = pointInEllipse(dist_to_pixel, pixelA[i].w, pixelC[i].xyz);
+
+      if  (dist_test != -1.0)
+	{
+	  // test for minimum depth coordinate of valid ellipses
+	  if (pixelB[i].x <= zmin) {
+	    zmin = pixelB[i].x;
+	    zmax = zmin + pixelB[i].y;
+	    weights[i] = exp(-0.5*dist_test);
+	  }
+	}
+      else {
+	// if the ellipse does not reach the center ignore it in the averaging
+	pixelA[i].w = -1.0;
+      }
+    }
+  }
+
+  float new_zmax = zmax;
+
+  float total_weight = 0.0;
+  // Gather pixels values
+  for (int i = 0; i < k; ++i)
+    {
+      // Check if valid gather pixel or unspecified (or ellipse out of reach set above)
+      if (pixelA[i].w > 0.0) 
+	{
+	  {
+	    // Depth test between valid in reach ellipses
+	    if ((!depth_test) || (pixelB[i].x - pixelB[i].y <= zmax))
+	      {
+		
+		bufferA += pixelA[i] * weights[i];
+
+		// Increment ellipse total path with distance from gather pixel to center
+		//bufferB.zw += (pixelB[i].zw + gather_pixel_desloc[i].xy) * w;
+		bufferB.zw += pixelB[i].zw * weights[i];
+
+		// double angle vectors average without the sign ambiguity of the axis
+		bufferC += pixelC[i] * weights[i];
+	      
+		// Take maximum depth range
+		new_zmax = max(pixelB[i].x + pixelB[i].y, new_zmax);
+	      
+		total_weight += weights[i];
+	      }
+	  }
+	}
+    }
+
+  // average values if there are any valid ellipses
+  // otherwise the pixel will be writen as unspecified
+  
+  if (total_weight > 0.0)
+    {
+      bufferA /= total_weight;
+      bufferA.xyz = normalize(bufferA.xyz);
+      bufferB.x = zmin;
+      //      bufferB.y = new_zmax - zmin;
+      bufferB.y = bufferA.w;
+
+      bufferB.zw /= total_weight;
+
+      bufferC /= total_weight;
+      float len = length(bufferC.xy);
+      bufferC.xy = (len > 0.0) ? bufferC.xy / len : vec2(1.0, 0.0);
+    }
+
+  // first buffer = (n.x, n.y, n.z, radius)
+  gl_FragData[0] = bufferA;
+  // second buffer = (depth, max_depth, dx, dy)
+  gl_FragData[1] = bufferB;
+  // third buffer = (cos 2 angle, sin 2 angle, minor radius, 0)
+  gl_FragData[2] = bufferC;
+}
@@ -0,0 +1,49 @@
+/* Level probe */
+#version 120
+
+varying vec2 texcoord;
+
+// Marks the holes of an analysis level: unspecified pixels that have
+// specified pixels at most two pixels away on both sides along one of
+// the four axes. Pixels on the outside of silhouettes only have data on
+// one side and are discarded, so counting the passing fragments with an
+// occlusion query gives the number of holes that need a coarser level.
+
+uniform sampler2D textureA;
+
+// level to be probed
+uniform int level;
+
+// pixel size of the probed level, in texture coordinates
+uniform vec2 pixel_size;
+
+bool specified(in vec2 tex_coord)
+{
+  return texture2DLod (textureA, tex_coord, float(level)).w > 0.0;
+}
+
+void main (void) {
+
+  vec2 center = texcoord;
+
+  if (specified(center))
+    discard;
+
+  vec2 axes[4];
+  axes[0] = vec2(pixel_size.s, 0.0);
+  axes[1] = vec2(0.0, pixel_size.t);
+  axes[2] = vec2(pixel_size.s, pixel_size.t);
+  axes[3] = vec2(pixel_size.s, -pixel_size.t);
+
+  bool hole = false;
+  for (int i = 0; i < 4; ++i) {
+    bool before = specified(center - axes[i]) || specified(center - 2.0*axes[i]);
+    bool after = specified(center + axes[i]) || specified(center + 2.0*axes[i]);
+    hole = hole || (before && after);
+  }
+
+  if (!hole)
+    discard;
+
+  gl_FragColor = vec4(1.0);
+}
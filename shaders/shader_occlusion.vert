@@ -0,0 +1,15 @@
+/// GLSL CODE
+
+/// Vertex Shader -- Occlusion culling passes
+#version 120
+
+attribute vec2 corner;
+
+varying vec2 texcoord;
+
+/// Full screen triangle, corners in clip coordinates
+void main(void)
+{
+  texcoord = corner * 0.5 + 0.5;
+  gl_Position = vec4(corner, 0.0, 1.0);
+}
@@ -0,0 +1,10 @@
+/* Occlusion box queries */
+#version 120
+
+// Color writes are off, the queries only count the fragments
+// of the box that pass the depth test.
+
+void main(void)
+{
+  gl_FragColor = vec4(0.0);
+}
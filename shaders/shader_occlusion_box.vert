@@ -0,0 +1,14 @@
+/// GLSL CODE
+
+/// Vertex Shader -- Occlusion culling box queries
+#version 120
+
+uniform mat4 mvp;
+
+attribute vec3 position;
+
+/// Corner of a cluster box, with the camera of the frame
+void main(void)
+{
+  gl_Position = mvp * vec4(position, 1.0);
+}
@@ -0,0 +1,24 @@
+/* Occlusion depth buffer */
+#version 120
+
+varying vec2 texcoord;
+
+// Writes the reconstructed level 0 depth into the depth buffer, so that
+// bounding boxes of culled clusters can be tested with occlusion queries.
+// depth_params holds the projection matrix terms P[2][2] and P[3][2].
+
+uniform sampler2D textureB;
+
+uniform vec2 depth_params;
+
+void main(void)
+{
+  float depth = texture2DLod (textureB, texcoord, 0.0).x;
+
+  if (depth <= 0.0)
+    gl_FragDepth = 1.0;
+  else {
+    float ndc = (depth_params.y - depth_params.x * depth) / depth;
+    gl_FragDepth = clamp(0.5 * ndc + 0.5, 0.0, 1.0);
+  }
+}
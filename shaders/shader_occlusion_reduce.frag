@@ -0,0 +1,36 @@
+/* Occlusion depth reduction */
+#version 120
+
+// Farthest reconstructed eye depth of a block of level 0 pixels.
+// The result is an occluder depth: anything behind it, in every pixel
+// of the block, is hidden. Background pixels (depth 0) make the block
+// transparent, which is marked with a negative value.
+
+uniform sampler2D textureB;
+
+// level 0 pixels per block side
+uniform int block;
+
+// 1 / size of level 0
+uniform vec2 pixel_size;
+
+// part of level 0 covering the canvas, the rest is padding
+uniform vec2 canvas_size;
+
+void main(void)
+{
+  vec2 first = floor(gl_FragCoord.xy) * float(block) + vec2(0.5);
+  float farthest = 0.0;
+
+  for (int j = 0; j < block; ++j)
+    for (int i = 0; i < block; ++i) {
+      vec2 tex_coord = min(first + vec2(i, j), canvas_size - vec2(0.5)) * pixel_size;
+      float depth = texture2DLod (textureB, tex_coord, 0.0).x;
+      if (depth <= 0.0)
+	farthest = -1.0;
+      else if (farthest >= 0.0)
+	farthest = max(farthest, depth);
+    }
+
+  gl_FragColor = vec4(farthest, 0.0, 0.0, 0.0);
+}
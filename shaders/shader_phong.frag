@@ -1,17 +1,26 @@
 #version 120
 
+varying vec2 texcoord;
+
 uniform sampler2D textureA;
 uniform vec4 color_ambient;
 uniform vec4 color_diffuse;
 uniform vec4 color_specular;
 uniform float shininess;
 
+// directional light in eye space
+uniform vec3 light_direction;
+uniform vec3 half_vector;
+uniform vec4 light_ambient;
+uniform vec4 light_diffuse;
+uniform vec4 light_specular;
+
 uniform int level;
 
 void main (void) {
 
-  vec4 normal = texture2DLod (textureA, gl_TexCoord[0].st, float(level)).xyzw;
-  //vec4 normal = texture2D (textureA, gl_TexCoord[0].st).xyzw;
+  vec4 normal = texture2DLod (textureA, texcoord, float(level)).xyzw;
+  //vec4 normal = texture2D (textureA, texcoord).xyzw;
   vec4 color = vec4(1.0);
 
   if (normal.a != 0.0) {
@@ -22,16 +31,16 @@ void main (void) {
       color.rgb = normal.rgb;
     }
     else {
-      vec3 lightDir = normalize(vec3(gl_LightSource[0].position));
+      vec3 lightDir = light_direction;
      
-      color = color_ambient * (gl_LightSource[0].ambient + gl_LightModel.ambient);
+      color = color_ambient * light_ambient;
 
       float NdotL = max(dot(normal.xyz, lightDir.xyz), 0.0);
 
       if (NdotL > 0.0) {
-	color += color_diffuse * gl_LightSource[0].diffuse * NdotL;
-	float NdotHV = max(dot(normal.xyz, gl_LightSource[0].halfVector.xyz), 0.0);
-	color += color_specular * gl_LightSource[0].specular * pow(NdotHV, shininess);
+	color += color_diffuse * light_diffuse * NdotL;
+	float NdotHV = max(dot(normal.xyz, half_vector), 0.0);
+	color += color_specular * light_specular * pow(NdotHV, shininess);
       }
     }
     color.a = 1.0;
@@ -1,5 +1,7 @@
 #version 120
 
+varying vec2 texcoord;
+
 uniform sampler2D textureA;
 uniform sampler2D textureC;
 
@@ -8,12 +10,25 @@ uniform vec4 color_diffuse;
 uniform vec4 color_specular;
 uniform float shininess;
 
+// directional light in eye space
+uniform vec3 light_direction;
+uniform vec3 half_vector;
+uniform vec4 light_ambient;
+uniform vec4 light_diffuse;
+uniform vec4 light_specular;
+
+// material times light, matching the Splatting Plugin
+uniform vec4 splat_ambient;
+uniform vec4 splat_diffuse;
+uniform vec4 splat_specular;
+uniform float splat_shininess;
+
 uniform int level;
 
 void main (void) {
 
-  vec4 normal = texture2DLod (textureA, gl_TexCoord[0].st, float(level)).xyzw;
-  vec4 color = texture2DLod (textureC, gl_TexCoord[0].st, float(level)).xyzw;
+  vec4 normal = texture2DLod (textureA, texcoord, float(level)).xyzw;
+  vec4 color = texture2DLod (textureC, texcoord, float(level)).xyzw;
 
   if (normal.a != 0.0) {
 
@@ -28,30 +43,30 @@ void main (void) {
 	}
 	else if (shininess != 90.0) {
 	  
-	  vec3 lightVec = normalize(gl_LightSource[0].position.xyz);
-	  vec3 halfVec = gl_LightSource[0].halfVector.xyz; //normalize( lightVec - normalize(eyePos) );
+	  vec3 lightVec = light_direction;
+	  vec3 halfVec = half_vector; //normalize( lightVec - normalize(eyePos) );
 	  float aux_dot = dot(normal.xyz, lightVec);
 	  float diffuseCoeff = clamp(aux_dot, 0.0, 1.0);
 
-	  float specularCoeff = aux_dot>0.0 ? clamp(pow(clamp(dot(halfVec, normal.xyz),0.0,1.0), gl_FrontMaterial.shininess), 0.0, 1.0) : 0.0;	 
+	  float specularCoeff = aux_dot>0.0 ? clamp(pow(clamp(dot(halfVec, normal.xyz),0.0,1.0), splat_shininess), 0.0, 1.0) : 0.0;	 
 	  
-	  color = vec4(color.rgb * ( gl_FrontLightProduct[0].ambient.rgb + diffuseCoeff * gl_FrontLightProduct[0].diffuse.rgb) + specularCoeff * gl_FrontLightProduct[0].specular.rgb, 1.0);
+	  color = vec4(color.rgb * ( splat_ambient.rgb + diffuseCoeff * splat_diffuse.rgb) + specularCoeff * splat_specular.rgb, 1.0);
 
 	}
 	else
 	{
-	  vec3 lightDir = normalize(vec3(gl_LightSource[0].position));
+	  vec3 lightDir = light_direction;
      
-	  color += color_ambient * (gl_LightSource[0].ambient + gl_LightModel.ambient);
+	  color += color_ambient * light_ambient;
 
 	  float NdotL = max(dot(normal.xyz, lightDir.xyz), 0);
 
-	  //color += color_diffuse * gl_LightSource[0].diffuse * NdotL;
+	  //color += color_diffuse * light_diffuse * NdotL;
 
 	  if (NdotL > 0.0) {
-		color += color_diffuse * gl_LightSource[0].diffuse * NdotL;
-		float NdotHV = max(dot(normal.xyz, gl_LightSource[0].halfVector.xyz), 0.0);
-		color += color_specular * gl_LightSource[0].specular * pow(NdotHV, shininess);
+		color += color_diffuse * light_diffuse * NdotL;
+		float NdotHV = max(dot(normal.xyz, half_vector), 0.0);
+		color += color_specular * light_specular * pow(NdotHV, shininess);
 	  }
 	}
     color.a = 1.0;
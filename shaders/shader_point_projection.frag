@@ -1,6 +1,7 @@
 /// GLSL CODE
 
 /// 1st Fragment Shader
+#version 120
 
 // Projects points to screen space and rotates normal
 // stores output on texture
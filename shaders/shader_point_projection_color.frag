@@ -1,6 +1,7 @@
 /// GLSL CODE
 
 /// 1st Fragment Shader
+#version 120
 
 // Projects points to screen space and rotates normal
 // stores output on texture
@@ -13,6 +14,7 @@ uniform vec2 canvas_size;
 varying vec3 normal_vec;
 varying vec3 radius_depth_w;
 varying float dist_to_eye;
+varying vec4 point_color;
 
 void main(void)
 { 
@@ -29,5 +31,5 @@ void main(void)
   // Third buffer  : color
   gl_FragData[0] = vec4 (normalize(normal_vec), proj_radius );
   gl_FragData[1] = vec4 (radius_depth_w.y, 2.0*depth_interval, screen_pos);
-  gl_FragData[2] = gl_Color;
+  gl_FragData[2] = point_color;
 }
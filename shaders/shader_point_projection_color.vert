@@ -1,23 +1,73 @@
 // GLSL CODE
 
 /// 1st Vertex Shader
+#version 120
 
 // Projects points to screen space and rotates normal
 // stores output on texture
 
 uniform vec3 eye;
 uniform int back_face_culling;
+uniform int quantized;
+
+// camera, set by the renderer instead of the fixed function matrices
+uniform mat4 mvp;
+uniform mat4 modelview;
+uniform mat3 normal_matrix;
+
+// surfel and cluster attributes (see Object::render)
+attribute vec4 surfel_position;
+attribute vec3 surfel_normal;
+attribute vec4 surfel_color;
+attribute vec4 cluster_origin;
+attribute vec4 cluster_step;
 
 varying vec3 normal_vec;
 varying vec3 radius_depth_w;
 varying float dist_to_eye;
+varying vec4 point_color;
 
 //varying vec2 pos;
 
+// Decodes the compressed surfel format (see surfel_quantizer.h):
+// surfel_position holds the 16 bit position inside the cluster grid and
+// the octahedral normal, surfel_color the RGB565 color and the log scale
+// radius. The cluster origin and minimum log radius come in cluster_origin,
+// the grid step and log radius step in cluster_step.
+void decodeSurfel(out vec3 position, out vec3 normal, out float radius, out vec3 color)
+{
+  if (quantized == 1) {
+    position = cluster_origin.xyz + (surfel_position.xyz + 32768.0) * cluster_step.xyz;
+
+    float packed_normal = surfel_position.w + 32768.0;
+    vec2 e = vec2(floor(packed_normal / 256.0), mod(packed_normal, 256.0)) / 255.0 * 2.0 - 1.0;
+    normal = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (normal.z < 0.0)
+      normal.xy = (1.0 - abs(normal.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    normal = normalize(normal);
+
+    vec4 bytes = floor(surfel_color * 255.0 + 0.5);
+    radius = exp2(cluster_origin.w + bytes.z * cluster_step.w);
+
+    float rgb565 = bytes.x * 256.0 + bytes.y;
+    color = vec3(floor(rgb565 / 2048.0) / 31.0, mod(floor(rgb565 / 32.0), 64.0) / 63.0, mod(rgb565, 32.0) / 31.0);
+  }
+  else {
+    position = surfel_position.xyz;
+    normal = surfel_normal;
+    radius = surfel_position.w;
+    color = surfel_color.rgb;
+  }
+}
+
 void main(void)
 {  
+  vec3 position, normal;
+  float radius;
+  vec3 color;
+  decodeSurfel(position, normal, radius, color);
 
-  float dot = (dot(normalize(eye - gl_Vertex.xyz), gl_Normal));
+  float dot = (dot(normalize(eye - position), normal));
 
   if ( (back_face_culling == 1) && ((dot < -0.0 ))) {
 	radius_depth_w.x = 0.0;
@@ -29,17 +79,16 @@ void main(void)
   else
     {
       // only rotate point and normal if not culled
-      vec4 v = gl_ModelViewProjectionMatrix * vec4(gl_Vertex.xyz, 1.0);
+      vec4 v = mvp * vec4(position, 1.0);
 
-	  normal_vec = normalize(gl_NormalMatrix * gl_Normal);
-      float radius = gl_Vertex.w;
+	  normal_vec = normalize(normal_matrix * normal);
 
-	  dist_to_eye = length(eye - gl_Vertex.xyz);
+	  dist_to_eye = length(eye - position);
 
       // compute depth value without projection matrix, only modelview
-      radius_depth_w = vec3(radius, -(gl_ModelViewMatrix * vec4(gl_Vertex.xyz, 1.0)).z, v.w);
+      radius_depth_w = vec3(radius, -(modelview * vec4(position, 1.0)).z, v.w);
       
       gl_Position = v;
     }
-  gl_FrontColor = gl_Color;
+  point_color = vec4(color, surfel_color.a);
 }
@@ -0,0 +1,31 @@
+/// GLSL CODE
+
+/// 1st Fragment Shader
+#version 120
+
+// Writes the projected ellipses to the level 0 buffers
+#extension GL_ARB_draw_buffers : enable
+
+uniform vec2 canvas_size;
+
+varying vec3 normal_vec;
+varying vec3 radius_depth_w;
+varying vec3 axes;
+
+void main(void)
+{ 
+  if (radius_depth_w.x <= 0.0)
+    discard;
+
+  float proj_radius = radius_depth_w.x;
+  float depth_interval = proj_radius;
+
+  vec2 screen_pos = (vec2(gl_FragCoord.xy) - vec2(0.5)) / canvas_size.xy;
+
+  // First buffer  : normal.x, normal.y, normal.z, major semi-axis
+  // Second buffer : minimum depth, depth interval, center.x, center.y
+  // Third buffer  : cos, sin of twice the major axis angle, minor semi-axis
+  gl_FragData[0] = vec4 (normal_vec, proj_radius );
+  gl_FragData[1] = vec4 (radius_depth_w.y, depth_interval, screen_pos);
+  gl_FragData[2] = vec4 (axes, 0.0);
+}
@@ -0,0 +1,109 @@
+// GLSL CODE
+
+/// 1st Vertex Shader
+#version 120
+
+// Projects elliptical surfels to screen space, rotates the normal
+// and computes the principal axes of the projected ellipse
+
+uniform vec3 eye;
+uniform int back_face_culling;
+uniform int quantized;
+uniform float scale;
+
+// camera, set by the renderer instead of the fixed function matrices
+uniform mat4 mvp;
+uniform mat4 modelview;
+uniform mat3 normal_matrix;
+
+// surfel and cluster attributes (see Object::render)
+attribute vec4 surfel_position;
+attribute vec3 surfel_normal;
+attribute vec4 surfel_color;
+attribute vec4 cluster_origin;
+attribute vec4 cluster_step;
+// major axis direction and minor/major ratio (see Object::setPyramidPointsArraysElipse)
+attribute vec4 surfel_axes;
+
+varying vec3 normal_vec;
+varying vec3 radius_depth_w;
+// (cos, sin) of twice the major axis angle and projected minor semi-axis
+varying vec3 axes;
+
+// Decodes the compressed surfel format (see surfel_quantizer.h),
+// as in shader_point_projection.vert.
+void decodeSurfel(out vec3 position, out vec3 normal, out float radius)
+{
+  if (quantized == 1) {
+    position = cluster_origin.xyz + (surfel_position.xyz + 32768.0) * cluster_step.xyz;
+
+    float packed_normal = surfel_position.w + 32768.0;
+    vec2 e = vec2(floor(packed_normal / 256.0), mod(packed_normal, 256.0)) / 255.0 * 2.0 - 1.0;
+    normal = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (normal.z < 0.0)
+      normal.xy = (1.0 - abs(normal.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    normal = normalize(normal);
+
+    vec4 bytes = floor(surfel_color * 255.0 + 0.5);
+    radius = exp2(cluster_origin.w + bytes.z * cluster_step.w);
+  }
+  else {
+    position = surfel_position.xyz;
+    normal = surfel_normal;
+    radius = surfel_position.w;
+  }
+}
+
+void main(void)
+{  
+  vec3 position, normal;
+  float radius;
+  decodeSurfel(position, normal, radius);
+
+  float facing = dot(normalize(eye - position), normal);
+
+  if ( (back_face_culling == 1) && (facing < 0.0) ) {
+
+    radius_depth_w.x = 0.0;
+    gl_Position = vec4(1.0);
+  }
+  else {
+    vec4 v = mvp * vec4(position, 1.0);           
+
+    normal_vec = normalize(normal_matrix * normal);
+
+    // major axis direction and minor/major ratio, both scaled by 32767
+    // (see Object::setPyramidPointsArraysElipse); zero for circular surfels
+    vec3 major_dir = surfel_axes.xyz / 32767.0;
+    float ratio = surfel_axes.w / 32767.0;
+
+    // tangent frame of the surfel, any frame for circles
+    vec3 t1 = major_dir - normal * dot(major_dir, normal);
+    if (dot(t1, t1) < 1.0e-8) {
+      t1 = cross(normal, abs(normal.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0));
+      ratio = 1.0;
+    }
+    t1 = normalize(t1);
+    vec3 t2 = cross(normal, t1);
+
+    // conjugate semi-axes of the projected ellipse, in canvas height units
+    float s = radius * scale / length(eye - position);
+    vec2 u = normalize(mat3(modelview) * t1).xy * s;
+    vec2 w = normalize(mat3(modelview) * t2).xy * (s * ratio);
+
+    // principal axes from the eigen decomposition of u u^t + w w^t
+    float a = u.x*u.x + w.x*w.x;
+    float b = u.x*u.y + w.x*w.y;
+    float c = u.y*u.y + w.y*w.y;
+    float m = 0.5 * (a + c);
+    float d = sqrt(0.25 * (a - c) * (a - c) + b * b);
+
+    axes.xy = (d > 0.0) ? vec2(0.5 * (a - c), b) / d : vec2(1.0, 0.0);
+    axes.z = sqrt(max(m - d, 0.0));
+
+    // projected major semi-axis, compared against surfels' radii by the pyramid
+    radius_depth_w = vec3(sqrt(m + d), -(modelview * vec4(position, 1.0)).z, v.w);
+
+    gl_Position = v;
+  }
+}
@@ -3,6 +3,13 @@
 
 #extension GL_ARB_draw_buffers : enable
 
+varying vec2 texcoord;
+
+// number of gathered pixels (4, 12 or 20), defined by the renderer
+#ifndef KERNEL_SIZE
+#define KERNEL_SIZE 12
+#endif
+
 // canvas_height / canvas_width
 uniform float canvas_ratio;
 
@@ -71,7 +78,7 @@ float pointInEllipse(in vec2 d, in float radius, in vec3 normal){
 void main (void) {
 
   // kernel size (number of pixels to use in gathering)
-  const int k = 12;
+  const int k = KERNEL_SIZE;
 
   // first buffer = (n.x, n.y, n.z, weight)
   vec4 bufferA = vec4(0.0, 0.0, 0.0, 0.0);
@@ -80,8 +87,8 @@ void main (void) {
   vec4 pixelA[k], pixelB[k];
 
   // retrieve pixel from analysis pyramid
-  bufferA = texture2DLod (textureA, gl_TexCoord[0].st, level).xyzw;
-  bufferB = texture2DLod (textureB, gl_TexCoord[0].st, level).xyzw;  
+  bufferA = texture2DLod (textureA, texcoord, level).xyzw;
+  bufferB = texture2DLod (textureB, texcoord, level).xyzw;  
 
   // Occlusion test - if this pixel is far behind this position
   // one level up in the pyramid, it is synthesized since it is
@@ -91,8 +98,8 @@ void main (void) {
 
   if (depth_test) {
     if  (bufferA.w != 0.0) {
-      vec4 up_pixelA = texture2DLod (textureA, gl_TexCoord[0].st, float(level+1)).xyzw;
-      vec4 up_pixelB = texture2DLod (textureB, gl_TexCoord[0].st, float(level+1)).xyzw;
+      vec4 up_pixelA = texture2DLod (textureA, texcoord, float(level+1)).xyzw;
+      vec4 up_pixelB = texture2DLod (textureB, texcoord, float(level+1)).xyzw;
 
       if ( (up_pixelA.w != 0.0) && (bufferB.x > up_pixelB.x + up_pixelB.y) ) {
 	occluded = true;
@@ -105,8 +112,8 @@ void main (void) {
   if ((bufferA.w == 0.0) || occluded)
     {		
       // first find coordinates for center of the four pixels in lower resolution level
-      // the level_ratio already compensates for non power of two mipmapping with floor strategy
-      vec2 center_coord = gl_TexCoord[0].st * level_ratio;
+      // level_ratio is 1, the padded levels halve exactly
+      vec2 center_coord = texcoord * level_ratio;
 
       vec2 tex_coord[k];
       //up-right
@@ -118,7 +125,8 @@ void main (void) {
       //down-left
       tex_coord[3].st = center_coord - half_pixel_size;
 
-      if (k == 12) {
+#if KERNEL_SIZE >= 12
+      {
 	//up-right-up
 	tex_coord[4].st = tex_coord[0].st + vec2(0.0, 2.0*half_pixel_size.t);
 	//up-right-right
@@ -139,9 +147,26 @@ void main (void) {
 	//down-left-left
 	tex_coord[11].st = tex_coord[3].st + vec2(-2.0*half_pixel_size.t, 0.0);
       }
+#endif
+
+#if KERNEL_SIZE == 20
+      {
+	//corners of the four by four block
+	tex_coord[12].st = tex_coord[0].st + 2.0*half_pixel_size;
+	tex_coord[13].st = tex_coord[1].st + vec2(-2.0*half_pixel_size.s, 2.0*half_pixel_size.t);
+	tex_coord[14].st = tex_coord[2].st + vec2(2.0*half_pixel_size.s, -2.0*half_pixel_size.t);
+	tex_coord[15].st = tex_coord[3].st - 2.0*half_pixel_size;
+
+	//one pixel further on each side, rotated to keep the fourfold symmetry
+	tex_coord[16].st = tex_coord[5].st + vec2(2.0*half_pixel_size.s, 0.0);
+	tex_coord[17].st = tex_coord[6].st + vec2(0.0, 2.0*half_pixel_size.t);
+	tex_coord[18].st = tex_coord[11].st - vec2(2.0*half_pixel_size.s, 0.0);
+	tex_coord[19].st = tex_coord[8].st - vec2(0.0, 2.0*half_pixel_size.t);
+      }
+#endif
 
       vec2 dist_to_pixel;
-      vec2 curr_coords = gl_TexCoord[0].st;
+      vec2 curr_coords = texcoord;
       float dist_test;
       float total_weight = 0.0;
       float weights[k];
@@ -3,6 +3,8 @@
 
 #extension GL_ARB_draw_buffers : enable
 
+varying vec2 texcoord;
+
 // flag for depth test on/off
 uniform bool depth_test;
 uniform bool elliptical_weight;
@@ -203,8 +205,8 @@ void main (void) {
   vec4 pixelA[4], pixelB[4];
 
   // retrieve pixel from analysis pyramid
-  bufferA = texture2DLod (textureA, gl_TexCoord[0].st, level).xyzw;
-  bufferB = texture2DLod (textureB, gl_TexCoord[0].st, level).xyzw;  
+  bufferA = texture2DLod (textureA, texcoord, level).xyzw;
+  bufferB = texture2DLod (textureB, texcoord, level).xyzw;  
 
   // Occlusion test - if this pixel is far behind this position
   // one level up in the pyramid it is synthesized since it is
@@ -214,8 +216,8 @@ void main (void) {
 
   if (depth_test) {
     if  (bufferA.w != 0.0) {
-      vec4 up_pixelA = texture2DLod (textureA, gl_TexCoord[0].st, float(level+1)).xyzw;
-      vec4 up_pixelB = texture2DLod (textureB, gl_TexCoord[0].st, float(level+1)).xyzw;
+      vec4 up_pixelA = texture2DLod (textureA, texcoord, float(level+1)).xyzw;
+      vec4 up_pixelB = texture2DLod (textureB, texcoord, float(level+1)).xyzw;
       
       if ( (up_pixelA.w != 0.0) && (bufferB.x > up_pixelB.x + up_pixelB.y) ) {
 		occluded = true;
@@ -228,13 +230,13 @@ void main (void) {
   if ((bufferA.w == 0.0) || occluded)
 	{
 
-	  vec2 curr_coords = gl_TexCoord[0].st * canvas_size;
+	  vec2 curr_coords = texcoord * canvas_size;
 
 	  // size of current level in pixels
 	  vec2 s = canvas_size / pow(2.0, float(level));
 	  
 	  // first find coordinates for center of the four pixels in lower resolution level
-	  vec2 center_coord = (ceil((gl_TexCoord[0].st * s) - vec2(0.5))) * (2.0/s);	 
+	  vec2 center_coord = (ceil((texcoord * s) - vec2(0.5))) * (2.0/s);	 
 
       //up-right
       tex_coord[0].st = center_coord + half_pixel_size.st;
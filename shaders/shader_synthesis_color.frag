@@ -3,6 +3,8 @@
 
 #extension GL_ARB_draw_buffers : enable
 
+varying vec2 texcoord;
+
 //  canvas_height / canvas_width
 uniform float canvas_ratio;
 
@@ -78,12 +80,12 @@ void main (void) {
   vec4 pixelA[4], pixelB[4], pixelC[4];
 
   // retrieve pixel from analysis pyramid
-  bufferA = texture2DLod (textureA, gl_TexCoord[0].st, level).xyzw;
+  bufferA = texture2DLod (textureA, texcoord, level).xyzw;
   
   if (bufferA.w != 0.0) 
 	{
-	  bufferB = texture2DLod (textureB, gl_TexCoord[0].st, level).xyzw;
-	  bufferC = texture2DLod (textureC, gl_TexCoord[0].st, level).xyzw;
+	  bufferB = texture2DLod (textureB, texcoord, level).xyzw;
+	  bufferC = texture2DLod (textureC, texcoord, level).xyzw;
 	}
 
   // Occlusion test - if this pixel is far behind this position
@@ -94,8 +96,8 @@ void main (void) {
 
   if (depth_test) {
     if  (bufferA.w != 0.0) {
-      vec4 up_pixelA = texture2DLod (textureA, gl_TexCoord[0].st, float(level+1)).xyzw;
-      vec4 up_pixelB = texture2DLod (textureB, gl_TexCoord[0].st, float(level+1)).xyzw;
+      vec4 up_pixelA = texture2DLod (textureA, texcoord, float(level+1)).xyzw;
+      vec4 up_pixelB = texture2DLod (textureB, texcoord, float(level+1)).xyzw;
       
       if ( (up_pixelA.w != 0.0) && (bufferB.x > up_pixelB.x + up_pixelB.y) ) {
 		occluded = true;
@@ -108,8 +110,8 @@ void main (void) {
   if ((bufferA.w == 0.0) || occluded)
 	{
 	// first find coordinates for center of the four pixels in lower resolution level
-	// the level_ratio already compensates for non power of two mipmapping with floor strategy
-	vec2 center_coord = gl_TexCoord[0].st * level_ratio;
+	// level_ratio is 1, the padded levels halve exactly
+	vec2 center_coord = texcoord * level_ratio;
 	
 	vec2 tex_coord[4];
 	//up-right
@@ -122,7 +124,7 @@ void main (void) {
 	tex_coord[3].st = center_coord - half_pixel_size;
 
 	vec2 dist_to_pixel;
-	vec2 curr_coords = gl_TexCoord[0].st;
+	vec2 curr_coords = texcoord;
 	float dist_test;
 	float total_weight = 0.0;
 	vec4 weights = vec4(0.0);
@@ -1,11 +1,12 @@
+#version 120
 
+attribute vec2 corner;
+
+varying vec2 texcoord;
+
+/// Full screen triangle, corners in clip coordinates
 void main(void)
 {
-  gl_TexCoord[0] = gl_MultiTexCoord0;
-  //gl_TexCoord[1] = gl_MultiTexCoord1;
-  //gl_TexCoord[3] = gl_MultiTexCoord2;
-  gl_TexCoord[3] = gl_MultiTexCoord3;
-
-  gl_Position = gl_ProjectionMatrix * gl_Vertex;
-  //gl_Position = ftransform();
+  texcoord = corner * 0.5 + 0.5;
+  gl_Position = vec4(corner, 0.0, 1.0);
 }
@@ -0,0 +1,285 @@
+/*
+** software_projector.cc Point projection on the CPU.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "software_projector.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+/// Key of pixels without surfels.
+static const unsigned long long empty_key = ~0ULL;
+
+/// Surfels transformed together by the inner loops.
+static const int batch_size = 256;
+
+/**
+ * Lowers the value at target to value, if smaller, atomically.
+ **/
+static inline void atomicMin ( unsigned long long *target, unsigned long long value ) {
+  unsigned long long current = *target;
+  while (value < current) {
+    unsigned long long previous = __sync_val_compare_and_swap(target, current, value);
+    if (previous == current)
+      break;
+    current = previous;
+  }
+}
+
+/**
+ * Creates the projector for the given canvas.
+ * @param w Canvas width.
+ * @param h Canvas height.
+ * @param count Number of level 0 buffers, 3 when colors are projected.
+ * @param texture_w Width of the level 0 textures.
+ * @param texture_h Height of the level 0 textures.
+ **/
+SoftwareProjector::SoftwareProjector(int w, int h, int count, int texture_w, int texture_h) :
+  canvas_width(w), canvas_height(h), buffers_count(std::min(count, 3)),
+  texture_width(texture_w), texture_height(texture_h), projected_count(0) {
+
+  keys.assign((size_t)w * h, empty_key);
+  for (int i = 0; i < buffers_count; ++i)
+    buffers[i].resize((size_t)w * h * 4);
+}
+
+/**
+ * Removes all projected surfels.
+ **/
+void SoftwareProjector::clear ( void ) {
+  std::fill(keys.begin(), keys.end(), empty_key);
+  projections.clear();
+  projected_count = 0;
+}
+
+/**
+ * Projects the surfels of an object with the given camera and the current viewport.
+ * Samples accumulate until clear is called.
+ * @param obj Object to be projected.
+ * @param skip Per cluster flags, nonzero clusters are not projected (NULL projects all).
+ * @param begin Start of the projected range of every cluster, as a fraction of its size.
+ * @param end End of the projected range of every cluster.
+ * @param eye Eye position in object coordinates.
+ * @param scale Scale factor of the projected radii.
+ * @param back_face_culling Drop surfels facing away from the eye.
+ * @param modelview Column major modelview.
+ * @param projection Column major projection.
+ **/
+void SoftwareProjector::project ( const Object * obj, const std::vector<unsigned char> *skip, float begin, float end,
+				  const Point3f &eye, float scale, bool back_face_culling,
+				  const GLdouble modelview[16], const GLdouble projection[16] ) {
+
+  const SurfelStore *store = obj->getStore();
+
+  Projection p;
+  p.object = obj;
+  p.eye = eye;
+  p.scale = scale;
+  p.back_face_culling = back_face_culling;
+
+  for (int i = 0; i < 16; ++i)
+    p.modelview[i] = modelview[i];
+  glGetIntegerv(GL_VIEWPORT, p.viewport);
+
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 4; ++r) {
+      p.mvp[c*4 + r] = 0.0;
+      for (int k = 0; k < 4; ++k)
+	p.mvp[c*4 + r] += projection[k*4 + r] * p.modelview[c*4 + k];
+    }
+
+  // inverse transpose of the rotation part, as gl_NormalMatrix
+  const GLdouble *m = p.modelview;
+  GLdouble cofactor[9] = {
+    m[5]*m[10] - m[9]*m[6], m[9]*m[2] - m[1]*m[10], m[1]*m[6] - m[5]*m[2],
+    m[8]*m[6] - m[4]*m[10], m[0]*m[10] - m[8]*m[2], m[4]*m[2] - m[0]*m[6],
+    m[4]*m[9] - m[8]*m[5], m[8]*m[1] - m[0]*m[9], m[0]*m[5] - m[4]*m[1] };
+  GLdouble det = m[0]*cofactor[0] + m[4]*cofactor[1] + m[8]*cofactor[2];
+  for (int k = 0; k < 9; ++k)
+    p.normal_matrix[k] = det != 0.0 ? cofactor[k] / det : 0.0;
+
+  // successive frames of the same camera (progressive refinement) share their indices
+  unsigned int offset = projected_count;
+  bool found = false;
+  for (unsigned int i = 0; i < projections.size() && !found; ++i) {
+    const Projection &q = projections[i];
+    if (q.object == obj && q.scale == scale && q.back_face_culling == back_face_culling &&
+	q.eye[0] == eye[0] && q.eye[1] == eye[1] && q.eye[2] == eye[2] &&
+	memcmp(q.mvp, p.mvp, sizeof(p.mvp)) == 0 && memcmp(q.viewport, p.viewport, sizeof(p.viewport)) == 0) {
+      offset = q.offset;
+      found = true;
+    }
+  }
+  if (!found) {
+    if ((unsigned long long)projected_count + store->size() > 0xffffffffULL) {
+      cerr << "software projection : too many surfels in one frame" << endl;
+      return;
+    }
+    p.offset = offset;
+    projected_count += store->size();
+    projections.push_back(p);
+  }
+
+  // a single range when the object has no clusters
+  std::vector<SurfelCluster> whole;
+  const std::vector<SurfelCluster> *clusters = &obj->getClusters();
+  if (clusters->empty()) {
+    SurfelCluster c;
+    c.first = 0;
+    c.count = store->size();
+    whole.push_back(c);
+    clusters = &whole;
+  }
+
+  float mvp[16];
+  for (int k = 0; k < 16; ++k)
+    mvp[k] = p.mvp[k];
+  const float ex = eye[0], ey = eye[1], ez = eye[2];
+  const float vx = p.viewport[0], vy = p.viewport[1], vw = p.viewport[2], vh = p.viewport[3];
+  const int x0 = std::max(p.viewport[0], 0), x1 = std::min(p.viewport[0] + p.viewport[2], canvas_width);
+  const int y0 = std::max(p.viewport[1], 0), y1 = std::min(p.viewport[1] + p.viewport[3], canvas_height);
+  const float *position = store->position.empty() ? NULL : &store->position[0];
+  const float *normal = store->normal.empty() ? NULL : &store->normal[0];
+  const float *radius = store->radius.empty() ? NULL : &store->radius[0];
+
+#pragma omp parallel for schedule(dynamic)
+  for (long c = 0; c < (long)clusters->size(); ++c) {
+    if (skip && (*skip)[c])
+      continue;
+    const SurfelCluster &cluster = (*clusters)[c];
+    size_t first = cluster.first + (size_t)(begin * cluster.count);
+    size_t last = cluster.first + (size_t)(end * cluster.count);
+
+    float cx[batch_size], cy[batch_size], cz[batch_size], cw[batch_size];
+    unsigned char visible[batch_size];
+
+    for (size_t b = first; b < last; b += batch_size) {
+      int n = (int)std::min((size_t)batch_size, last - b);
+      const float *v = position + 3*b;
+      const float *nv = normal + 3*b;
+      const float *rv = radius + b;
+
+      // transform to clip coordinates
+      for (int i = 0; i < n; ++i) {
+	float x = v[3*i], y = v[3*i+1], z = v[3*i+2];
+	cx[i] = mvp[0]*x + mvp[4]*y + mvp[8]*z + mvp[12];
+	cy[i] = mvp[1]*x + mvp[5]*y + mvp[9]*z + mvp[13];
+	cz[i] = mvp[2]*x + mvp[6]*y + mvp[10]*z + mvp[14];
+	cw[i] = mvp[3]*x + mvp[7]*y + mvp[11]*z + mvp[15];
+      }
+
+      // radius, clipping and back face tests
+      for (int i = 0; i < n; ++i) {
+	float facing = (ex - v[3*i])*nv[3*i] + (ey - v[3*i+1])*nv[3*i+1] + (ez - v[3*i+2])*nv[3*i+2];
+	visible[i] = rv[i] > 0.0f && (!back_face_culling || facing >= 0.0f) &&
+	  cx[i] >= -cw[i] && cx[i] <= cw[i] && cy[i] >= -cw[i] && cy[i] <= cw[i] &&
+	  cz[i] >= -cw[i] && cz[i] <= cw[i];
+      }
+
+      // depth test
+      for (int i = 0; i < n; ++i) {
+	if (!visible[i])
+	  continue;
+	float inv_w = 1.0f / cw[i];
+	int px = (int)floorf(vx + (cx[i] * inv_w * 0.5f + 0.5f) * vw);
+	int py = (int)floorf(vy + (cy[i] * inv_w * 0.5f + 0.5f) * vh);
+	if (px < x0 || px >= x1 || py < y0 || py >= y1)
+	  continue;
+	// window depth is in [0, 1], its bits order as the values do
+	float depth = cz[i] * inv_w * 0.5f + 0.5f;
+	unsigned int bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	unsigned long long key = ((unsigned long long)bits << 32) | (offset + (b + i));
+	atomicMin(&keys[(size_t)py * canvas_width + px], key);
+      }
+    }
+  }
+}
+
+/**
+ * Writes the attributes of the surfel that won a pixel, as the projection
+ * fragment shaders do.
+ * @param pixel Pixel index, row major from the bottom.
+ * @param p Projection the surfel belongs to.
+ * @param index Surfel index in the object store.
+ **/
+void SoftwareProjector::resolvePixel ( size_t pixel, const Projection &p, size_t index ) {
+
+  const SurfelStore *store = p.object->getStore();
+  const float *v = &store->position[3*index];
+  const float *n = &store->normal[3*index];
+  const GLdouble *nm = p.normal_matrix;
+  const GLdouble *mv = p.modelview;
+
+  double nx = nm[0]*n[0] + nm[1]*n[1] + nm[2]*n[2];
+  double ny = nm[3]*n[0] + nm[4]*n[1] + nm[5]*n[2];
+  double nz = nm[6]*n[0] + nm[7]*n[1] + nm[8]*n[2];
+  double length = sqrt(nx*nx + ny*ny + nz*nz);
+  if (length > 0.0) {
+    nx /= length; ny /= length; nz /= length;
+  }
+
+  double eye_depth = -(mv[2]*v[0] + mv[6]*v[1] + mv[10]*v[2] + mv[14]);
+  double dx = p.eye[0] - v[0], dy = p.eye[1] - v[1], dz = p.eye[2] - v[2];
+  double proj_radius = store->radius[index] * p.scale / sqrt(dx*dx + dy*dy + dz*dz);
+
+  float *a = &buffers[0][4*pixel];
+  a[0] = nx; a[1] = ny; a[2] = nz; a[3] = proj_radius;
+
+  float *b = &buffers[1][4*pixel];
+  b[0] = eye_depth;
+  // the color projection shader doubles the depth interval
+  b[1] = buffers_count > 2 ? 2.0 * proj_radius : proj_radius;
+  b[2] = (float)(pixel % canvas_width) / texture_width;
+  b[3] = (float)(pixel / canvas_width) / texture_height;
+
+  if (buffers_count > 2) {
+    const GLubyte *color = &store->color[4*index];
+    float *c = &buffers[2][4*pixel];
+    for (int k = 0; k < 4; ++k)
+      c[k] = color[k] / 255.0f;
+  }
+}
+
+/**
+ * Fills the level 0 buffers from the nearest surfel of every pixel.
+ **/
+void SoftwareProjector::resolve ( void ) {
+
+#pragma omp parallel for schedule(static)
+  for (long pixel = 0; pixel < (long)keys.size(); ++pixel) {
+    unsigned long long key = keys[pixel];
+    if (key == empty_key) {
+      for (int i = 0; i < buffers_count; ++i)
+	memset(&buffers[i][4*pixel], 0, 4 * sizeof(float));
+      continue;
+    }
+
+    // projections are ordered by offset
+    unsigned int index = (unsigned int)(key & 0xffffffffULL);
+    unsigned int j = projections.size() - 1;
+    while (projections[j].offset > index)
+      --j;
+    resolvePixel(pixel, projections[j], index - projections[j].offset);
+  }
+}
+
+/**
+ * Resolves the projected surfels and uploads them to level 0 of the
+ * pyramid textures.
+ * @param textures One texture per level 0 buffer.
+ **/
+void SoftwareProjector::upload ( const GLuint * textures ) {
+
+  resolve();
+
+  for (int i = 0; i < buffers_count; ++i) {
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, canvas_width, canvas_height, GL_RGBA, GL_FLOAT, &buffers[i][0]);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
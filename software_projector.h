@@ -0,0 +1,91 @@
+/*
+** software_projector.h Point projection on the CPU header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SOFTWARE_PROJECTOR_H__
+#define __SOFTWARE_PROJECTOR_H__
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "object.h"
+
+/**
+ * Multithreaded CPU replacement for the GL_POINTS projection pass.
+ *
+ * Surfels are transformed in batches (plain loops over arrays, so the
+ * compiler can vectorize them), back face culled and clipped exactly as
+ * in shader_point_projection.vert. Each surviving surfel competes for its
+ * pixel with an atomic minimum on a 64 bit key holding the window depth
+ * in the high word and the surfel index in the low word, so the result
+ * is the same for any number of threads. A resolve pass then writes the
+ * attributes of the winning surfels in the level 0 layout of the pyramid:
+ * (normal, projected radius), (eye depth, depth interval, screen x, y)
+ * and, for the color renderer, the surfel color.
+ *
+ * The camera (modelview and projection) is given to every project call and
+ * the viewport read from the OpenGL state, so views of stereo and atlas
+ * rendering are handled as on the GPU.
+ **/
+class SoftwareProjector
+{
+ public:
+
+  SoftwareProjector(int w, int h, int count, int texture_w, int texture_h);
+
+  void clear ( void );
+
+  void project ( const Object * obj, const std::vector<unsigned char> *skip, float begin, float end,
+		 const Point3f &eye, float scale, bool back_face_culling,
+		 const GLdouble modelview[16], const GLdouble projection[16] );
+
+  void resolve ( void );
+
+  void upload ( const GLuint * textures );
+
+  /// Level 0 buffer i after resolve: canvas sized RGBA floats, rows bottom-up.
+  const float * buffer ( int i ) const { return &buffers[i][0]; }
+
+  int width ( void ) const { return canvas_width; }
+  int height ( void ) const { return canvas_height; }
+
+ private:
+
+  /// Camera and parameters of one project call.
+  struct Projection {
+    const Object *object;
+    /// Index of the first surfel of the object in the keys.
+    unsigned int offset;
+    GLdouble mvp[16];
+    GLdouble modelview[16];
+    /// Inverse transpose of the modelview rotation, row major.
+    GLdouble normal_matrix[9];
+    GLint viewport[4];
+    Point3f eye;
+    float scale;
+    bool back_face_culling;
+  };
+
+  void resolvePixel ( size_t pixel, const Projection &p, size_t index );
+
+  int canvas_width, canvas_height;
+  int buffers_count;
+
+  /// Size of the level 0 textures, screen positions are normalized to it.
+  int texture_width, texture_height;
+
+  /// Depth and surfel index of the nearest surfel per pixel.
+  std::vector<unsigned long long> keys;
+
+  std::vector<Projection> projections;
+  unsigned int projected_count;
+
+  std::vector<float> buffers[3];
+};
+
+#endif
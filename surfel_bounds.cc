@@ -0,0 +1,185 @@
+/*
+** surfel_bounds.cc Bounding volumes of surfel sets.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "surfel_bounds.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+/**
+ * Eigenvectors of a symmetric 3x3 matrix by cyclic Jacobi rotations.
+ * @param a Matrix, destroyed.
+ * @param v Eigenvectors as columns.
+ **/
+static void jacobiEigenvectors ( double a[3][3], double v[3][3] ) {
+
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      v[i][j] = (i == j) ? 1.0 : 0.0;
+
+  for (int sweep = 0; sweep < 32; ++sweep) {
+    double off = fabs(a[0][1]) + fabs(a[0][2]) + fabs(a[1][2]);
+    if (off < 1.0e-30)
+      break;
+    for (int p = 0; p < 2; ++p)
+      for (int q = p + 1; q < 3; ++q) {
+	if (a[p][q] == 0.0)
+	  continue;
+	double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+	double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+	double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+	for (int k = 0; k < 3; ++k) {
+	  double akp = a[k][p], akq = a[k][q];
+	  a[k][p] = c * akp - s * akq;
+	  a[k][q] = s * akp + c * akq;
+	}
+	for (int k = 0; k < 3; ++k) {
+	  double apk = a[p][k], aqk = a[q][k];
+	  a[p][k] = c * apk - s * aqk;
+	  a[q][k] = s * apk + c * aqk;
+	}
+	for (int k = 0; k < 3; ++k) {
+	  double vkp = v[k][p], vkq = v[k][q];
+	  v[k][p] = c * vkp - s * vkq;
+	  v[k][q] = s * vkp + c * vkq;
+	}
+      }
+  }
+}
+
+/**
+ * Computes all bounds of a store with parallel min/max reductions.
+ * The sphere is centered at the box center. The oriented box follows
+ * the principal axes of the surfel centers.
+ * @param store Surfels.
+ * @param obb Also compute the oriented box (two more passes).
+ **/
+void SurfelBounds::compute ( const SurfelStore &store, bool obb ) {
+
+  box.SetNull();
+  radius = max_radius = 0.0f;
+  has_obb = false;
+
+  const long n = store.size();
+  if (n == 0)
+    return;
+
+  const float *p = &store.position[0];
+  const float *r = &store.radius[0];
+
+  float x0 = FLT_MAX, y0 = FLT_MAX, z0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX, z1 = -FLT_MAX, r1 = 0.0f;
+#pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1,r1)
+  for (long i = 0; i < n; ++i) {
+    x0 = std::min(x0, p[3*i]);  x1 = std::max(x1, p[3*i]);
+    y0 = std::min(y0, p[3*i+1]); y1 = std::max(y1, p[3*i+1]);
+    z0 = std::min(z0, p[3*i+2]); z1 = std::max(z1, p[3*i+2]);
+    r1 = std::max(r1, r[i]);
+  }
+  box.Add(Point3f(x0, y0, z0));
+  box.Add(Point3f(x1, y1, z1));
+  max_radius = r1;
+
+  center = box.Center();
+  const float cx = center[0], cy = center[1], cz = center[2];
+  float d2 = 0.0f;
+#pragma omp parallel for reduction(max:d2)
+  for (long i = 0; i < n; ++i) {
+    float dx = p[3*i] - cx, dy = p[3*i+1] - cy, dz = p[3*i+2] - cz;
+    d2 = std::max(d2, dx*dx + dy*dy + dz*dz);
+  }
+  radius = sqrtf(d2);
+
+  if (!obb)
+    return;
+
+  // covariance of the centers, relative to the box center for precision
+  double sx = 0, sy = 0, sz = 0, sxx = 0, sxy = 0, sxz = 0, syy = 0, syz = 0, szz = 0;
+#pragma omp parallel for reduction(+:sx,sy,sz,sxx,sxy,sxz,syy,syz,szz)
+  for (long i = 0; i < n; ++i) {
+    double dx = p[3*i] - cx, dy = p[3*i+1] - cy, dz = p[3*i+2] - cz;
+    sx += dx; sy += dy; sz += dz;
+    sxx += dx*dx; sxy += dx*dy; sxz += dx*dz;
+    syy += dy*dy; syz += dy*dz; szz += dz*dz;
+  }
+  double mx = sx / n, my = sy / n, mz = sz / n;
+  double cov[3][3] = { { sxx/n - mx*mx, sxy/n - mx*my, sxz/n - mx*mz },
+		       { sxy/n - mx*my, syy/n - my*my, syz/n - my*mz },
+		       { sxz/n - mx*mz, syz/n - my*mz, szz/n - mz*mz } };
+  double v[3][3];
+  jacobiEigenvectors(cov, v);
+
+  float a[3][3];
+  for (int k = 0; k < 3; ++k)
+    for (int j = 0; j < 3; ++j)
+      a[k][j] = v[j][k];
+
+  float l0 = FLT_MAX, l1 = FLT_MAX, l2 = FLT_MAX, h0 = -FLT_MAX, h1 = -FLT_MAX, h2 = -FLT_MAX;
+#pragma omp parallel for reduction(min:l0,l1,l2) reduction(max:h0,h1,h2)
+  for (long i = 0; i < n; ++i) {
+    float dx = p[3*i] - cx, dy = p[3*i+1] - cy, dz = p[3*i+2] - cz;
+    float e0 = a[0][0]*dx + a[0][1]*dy + a[0][2]*dz;
+    float e1 = a[1][0]*dx + a[1][1]*dy + a[1][2]*dz;
+    float e2 = a[2][0]*dx + a[2][1]*dy + a[2][2]*dz;
+    l0 = std::min(l0, e0); h0 = std::max(h0, e0);
+    l1 = std::min(l1, e1); h1 = std::max(h1, e1);
+    l2 = std::min(l2, e2); h2 = std::max(h2, e2);
+  }
+
+  float low[3] = {l0, l1, l2}, high[3] = {h0, h1, h2};
+  obb_center = center;
+  for (int k = 0; k < 3; ++k) {
+    obb_axis[k] = Point3f(a[k][0], a[k][1], a[k][2]);
+    obb_half[k] = 0.5f * (high[k] - low[k]);
+    obb_center += obb_axis[k] * (0.5f * (high[k] + low[k]));
+  }
+  has_obb = true;
+}
+
+/**
+ * Grows the bounds to include other bounds. The oriented box is dropped,
+ * it cannot be merged without the surfels.
+ * @param b Bounds to be added.
+ **/
+void SurfelBounds::add ( const SurfelBounds &b ) {
+
+  if (b.empty())
+    return;
+  if (empty()) {
+    *this = b;
+    return;
+  }
+
+  box.Add(b.box);
+  Point3f c = box.Center();
+  radius = std::max((center - c).Norm() + radius, (b.center - c).Norm() + b.radius);
+  center = c;
+  max_radius = std::max(max_radius, b.max_radius);
+  has_obb = false;
+}
+
+/**
+ * Corners of the tightest box, the oriented one if present.
+ * @param grow Distance added on every side.
+ * @param corners Resulting corners, bit k of the index selects the high side of axis k.
+ **/
+void SurfelBounds::corners ( float grow, float corners[8][3] ) const {
+
+  for (int i = 0; i < 8; ++i) {
+    Point3f q;
+    if (has_obb) {
+      q = obb_center;
+      for (int k = 0; k < 3; ++k)
+	q += obb_axis[k] * ((i & (1 << k)) ? obb_half[k] + grow : -obb_half[k] - grow);
+    }
+    else
+      for (int k = 0; k < 3; ++k)
+	q[k] = (i & (1 << k)) ? box.max[k] + grow : box.min[k] - grow;
+    for (int k = 0; k < 3; ++k)
+      corners[i][k] = q[k];
+  }
+}
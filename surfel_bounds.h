@@ -0,0 +1,49 @@
+/*
+** surfel_bounds.h Bounding volumes of surfel sets header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SURFEL_BOUNDS_H__
+#define __SURFEL_BOUNDS_H__
+
+#include <vcg/space/box3.h>
+
+#include "surfel_store.h"
+
+/**
+ * Bounding volumes of a set of surfels, computed once after loading
+ * and stored with the object (and in surfel caches).
+ * All volumes bound the surfel centers; max_radius is the largest
+ * surfel radius, to grow them where the splat extent matters.
+ **/
+struct SurfelBounds
+{
+  SurfelBounds() : radius(0.0f), max_radius(0.0f), has_obb(false) {}
+
+  /// Axis aligned box.
+  Box3f box;
+
+  /// Bounding sphere.
+  Point3f center;
+  float radius;
+
+  float max_radius;
+
+  /// Oriented box along the principal axes, only if has_obb.
+  bool has_obb;
+  Point3f obb_center;
+  Point3f obb_axis[3];
+  float obb_half[3];
+
+  void compute ( const SurfelStore &store, bool obb = true );
+  void add ( const SurfelBounds &b );
+
+  void corners ( float grow, float corners[8][3] ) const;
+
+  bool empty ( void ) const { return box.IsNull(); }
+};
+
+#endif
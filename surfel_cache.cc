@@ -0,0 +1,219 @@
+/*
+** surfel_cache.cc Binary surfel cache.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "surfel_cache.h"
+
+#include <cstring>
+
+static const char cache_magic[8] = {'P', 'P', 'R', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t cache_version = 1;
+static const uint32_t cache_byte_order = 0x01020304;
+
+void SurfelCache::fillHeader ( Header &header ) {
+  memset(&header, 0, sizeof(Header));
+  memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.byte_order = cache_byte_order;
+}
+
+/**
+ * Writes a block of data, skipping empty arrays.
+ **/
+template <class T> static bool writeArray ( FILE *fp, const std::vector<T> &v ) {
+  return v.empty() || fwrite(&v[0], sizeof(T), v.size(), fp) == v.size();
+}
+
+/**
+ * Reads n elements into v starting at element offset.
+ **/
+template <class T> static bool readArray ( FILE *fp, std::vector<T> &v, size_t offset, size_t n ) {
+  return n == 0 || fread(&v[offset], sizeof(T), n, fp) == n;
+}
+
+/**
+ * Creates the cache file, the header is completed on close.
+ * @param filename Given file name.
+ * @param attributes Attributes of the stores that will be written.
+ * @return False if the file cannot be created.
+ **/
+bool SurfelCache::open ( const char * filename, int attributes ) {
+
+  close();
+
+  fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+
+  attribs = attributes;
+  segments = 0;
+  count = 0;
+
+  Header header;
+  fillHeader(header);
+  return fwrite(&header, sizeof(Header), 1, fp) == 1;
+}
+
+/**
+ * Appends a store as a new segment.
+ * @param store Surfels to be written, must have the attributes given to open.
+ * @param bounds Bounds of the store, computed if NULL.
+ * @return False on write errors.
+ **/
+bool SurfelCache::write ( const SurfelStore &store, const SurfelBounds *bounds ) {
+
+  // optional arrays must be present in the store
+  const int optional = SurfelStore::AXES | SurfelStore::ERRORS;
+  if (fp == NULL || (attribs & optional & ~store.attributes()) != 0)
+    return false;
+
+  uint64_t n = store.size();
+  bool ok = fwrite(&n, sizeof(n), 1, fp) == 1 &&
+    writeArray(fp, store.position) && writeArray(fp, store.normal) &&
+    writeArray(fp, store.radius) && writeArray(fp, store.color);
+  if (attribs & SurfelStore::AXES)
+    ok = ok && writeArray(fp, store.major_axis) && writeArray(fp, store.minor_axis);
+  if (attribs & SurfelStore::ERRORS)
+    ok = ok && writeArray(fp, store.error);
+
+  SurfelBounds computed;
+  if (bounds == NULL) {
+    computed.compute(store);
+    bounds = &computed;
+  }
+  Bounds b;
+  memset(&b, 0, sizeof(Bounds));
+  if (!bounds->empty())
+    for (int k = 0; k < 3; ++k) {
+      b.box_min[k] = bounds->box.min[k];
+      b.box_max[k] = bounds->box.max[k];
+      b.center[k] = bounds->center[k];
+      b.obb_center[k] = bounds->obb_center[k];
+      b.obb_half[k] = bounds->obb_half[k];
+      for (int j = 0; j < 3; ++j)
+	b.obb_axis[k][j] = bounds->obb_axis[k][j];
+    }
+  b.radius = bounds->radius;
+  b.max_radius = bounds->max_radius;
+  b.has_obb = bounds->has_obb;
+  ok = ok && fwrite(&b, sizeof(Bounds), 1, fp) == 1;
+
+  ++segments;
+  count += n;
+  return ok;
+}
+
+/**
+ * Completes the header and closes the file.
+ * @return False on write errors.
+ **/
+bool SurfelCache::close ( void ) {
+  if (fp == NULL)
+    return true;
+
+  Header header;
+  fillHeader(header);
+  header.attributes = attribs;
+  header.segments = segments;
+  header.count = count;
+
+  bool ok = fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(Header), 1, fp) == 1;
+  ok = (fclose(fp) == 0) && ok;
+  fp = NULL;
+  return ok;
+}
+
+/**
+ * Writes a whole store to a cache file.
+ * @return False on errors.
+ **/
+bool SurfelCache::save ( const char * filename, const SurfelStore &store ) {
+  SurfelCache cache;
+  return cache.open(filename, store.attributes()) && cache.write(store) && cache.close();
+}
+
+/**
+ * Tests whether the file starts with the cache magic.
+ * @param filename Given file name.
+ **/
+bool SurfelCache::isCache ( const char * filename ) {
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+  char magic[8];
+  bool is_cache = fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, cache_magic, sizeof(magic)) == 0;
+  fclose(fp);
+  return is_cache;
+}
+
+/**
+ * Loads a cache file, concatenating all segments into the store.
+ * @param filename Given file name.
+ * @param store Store to be filled.
+ * @param bounds Filled with the union of the segment bounds if not NULL.
+ * @return Number of surfels read, -1 if the file is not a valid cache
+ *         of this version and byte order.
+ **/
+long SurfelCache::read ( const char * filename, SurfelStore &store, SurfelBounds *bounds ) {
+
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return -1;
+
+  Header header;
+  if (fread(&header, sizeof(Header), 1, fp) != 1 ||
+      memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+      header.version != cache_version || header.byte_order != cache_byte_order) {
+    fclose(fp);
+    return -1;
+  }
+
+  store.resize(header.count, header.attributes);
+  if (bounds)
+    *bounds = SurfelBounds();
+
+  bool ok = true;
+  size_t offset = 0;
+  for (uint32_t s = 0; s < header.segments && ok; ++s) {
+    uint64_t n;
+    ok = fread(&n, sizeof(n), 1, fp) == 1 && offset + n <= header.count &&
+      readArray(fp, store.position, 3*offset, 3*n) && readArray(fp, store.normal, 3*offset, 3*n) &&
+      readArray(fp, store.radius, offset, n) && readArray(fp, store.color, 4*offset, 4*n);
+    if (ok && store.has(SurfelStore::AXES))
+      ok = readArray(fp, store.major_axis, 4*offset, 4*n) && readArray(fp, store.minor_axis, 4*offset, 4*n);
+    if (ok && store.has(SurfelStore::ERRORS))
+      ok = readArray(fp, store.error, 2*offset, 2*n);
+    if (ok) {
+      Bounds b;
+      ok = fread(&b, sizeof(Bounds), 1, fp) == 1;
+      if (ok && bounds && n > 0) {
+	SurfelBounds segment;
+	segment.box.Add(Point3f(b.box_min[0], b.box_min[1], b.box_min[2]));
+	segment.box.Add(Point3f(b.box_max[0], b.box_max[1], b.box_max[2]));
+	segment.center = Point3f(b.center[0], b.center[1], b.center[2]);
+	segment.radius = b.radius;
+	segment.max_radius = b.max_radius;
+	segment.has_obb = b.has_obb != 0;
+	segment.obb_center = Point3f(b.obb_center[0], b.obb_center[1], b.obb_center[2]);
+	for (int k = 0; k < 3; ++k) {
+	  segment.obb_axis[k] = Point3f(b.obb_axis[k][0], b.obb_axis[k][1], b.obb_axis[k][2]);
+	  segment.obb_half[k] = b.obb_half[k];
+	}
+	bounds->add(segment);
+      }
+    }
+    offset += ok ? n : 0;
+  }
+  fclose(fp);
+
+  if (!ok || offset != header.count) {
+    store.clear();
+    if (bounds)
+      *bounds = SurfelBounds();
+    return -1;
+  }
+  return header.count;
+}
@@ -0,0 +1,75 @@
+/*
+** surfel_cache.h Binary surfel cache header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SURFEL_CACHE_H__
+#define __SURFEL_CACHE_H__
+
+#include <cstdio>
+#include <stdint.h>
+
+#include "surfel_store.h"
+#include "surfel_bounds.h"
+
+/**
+ * Native binary dump of surfel arrays, loaded with one read per array.
+ *
+ * Layout: header (magic "PPRCACHE", version, byte order mark, attributes,
+ * number of segments, total count) followed by segments, each one holding
+ * its surfel count and then the arrays of the store in order: position,
+ * normal, radius, color, major and minor axes (if AXES), errors (if ERRORS),
+ * and its bounding volumes.
+ * Segments allow several stores to be appended to the same file.
+ **/
+class SurfelCache
+{
+ public:
+
+  SurfelCache() : fp(NULL), attribs(0), segments(0), count(0) {}
+  ~SurfelCache() { close(); }
+
+  bool open ( const char * filename, int attributes );
+  bool write ( const SurfelStore &store, const SurfelBounds *bounds = NULL );
+  bool close ( void );
+
+  static bool save ( const char * filename, const SurfelStore &store );
+  static long read ( const char * filename, SurfelStore &store, SurfelBounds *bounds = NULL );
+  static bool isCache ( const char * filename );
+
+ private:
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t attributes;
+    uint32_t segments;
+    uint64_t count;
+  };
+
+  /// Bounding volumes of a segment as written to the file.
+  struct Bounds {
+    float box_min[3];
+    float box_max[3];
+    float center[3];
+    float radius;
+    float max_radius;
+    uint32_t has_obb;
+    float obb_center[3];
+    float obb_axis[3][3];
+    float obb_half[3];
+  };
+
+  static void fillHeader ( Header &header );
+
+  FILE *fp;
+  int attribs;
+  uint32_t segments;
+  uint64_t count;
+};
+
+#endif
@@ -0,0 +1,289 @@
+/*
+** surfel_preprocessor.cc Cleaning of raw scans.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "surfel_preprocessor.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <queue>
+#include <algorithm>
+
+/// Neighbor entries of surfels with fewer than k neighbors.
+static const size_t no_neighbor = size_t(-1);
+
+/// Cells per axis of the search grid, to fit three indices in a key.
+static const unsigned long long grid_size = 1ULL << 21;
+
+/// Rings of cells searched around a surfel before giving up.
+static const int max_ring = 4;
+
+/**
+ * Centers sorted by grid cell, for neighbor queries.
+ **/
+class NeighborGrid
+{
+ public:
+
+  NeighborGrid ( const SurfelStore &s ) : store(s) {
+
+    const long n = store.size();
+    const float *p = &store.position[0];
+
+    float x0 = FLT_MAX, y0 = FLT_MAX, z0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX, z1 = -FLT_MAX;
+#pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1)
+    for (long i = 0; i < n; ++i) {
+      x0 = std::min(x0, p[3*i]); x1 = std::max(x1, p[3*i]);
+      y0 = std::min(y0, p[3*i+1]); y1 = std::max(y1, p[3*i+1]);
+      z0 = std::min(z0, p[3*i+2]); z1 = std::max(z1, p[3*i+2]);
+    }
+    origin[0] = x0; origin[1] = y0; origin[2] = z0;
+
+    // about four surfels per cell for a surface filling the box faces
+    float dx = x1 - x0, dy = y1 - y0, dz = z1 - z0;
+    float area = 2.0f * (dx*dy + dy*dz + dz*dx);
+    float diagonal = sqrtf(dx*dx + dy*dy + dz*dz);
+    cell_size = std::max(2.0f * sqrtf(area / n), diagonal / (grid_size - 1));
+    if (cell_size <= 0.0f)
+      cell_size = 1.0f;
+
+    keys.resize(n);
+#pragma omp parallel for
+    for (long i = 0; i < n; ++i) {
+      int c[3];
+      cell(&p[3*i], c);
+      keys[i] = std::make_pair(key(c[0], c[1], c[2]), (size_t)i);
+    }
+    std::sort(keys.begin(), keys.end());
+  }
+
+  /**
+   * Finds the k nearest surfels of surfel i, closest first.
+   * @param result Distances and indices, fewer than k if none are near enough.
+   **/
+  void query ( size_t i, int k, std::vector< std::pair<float, size_t> > &result ) const {
+
+    result.clear();
+    const float *q = &store.position[3*i];
+    int c[3];
+    cell(q, c);
+
+    // result is a max heap of the best candidates until sorted
+    for (int r = 0; r <= max_ring; ++r) {
+      for (int x = c[0] - r; x <= c[0] + r; ++x)
+	for (int y = c[1] - r; y <= c[1] + r; ++y)
+	  for (int z = c[2] - r; z <= c[2] + r; ++z) {
+	    if (std::max(std::max(abs(x - c[0]), abs(y - c[1])), abs(z - c[2])) != r)
+	      continue;
+	    if (x < 0 || y < 0 || z < 0 || x >= (int)grid_size || y >= (int)grid_size || z >= (int)grid_size)
+	      continue;
+	    visit(key(x, y, z), i, q, k, result);
+	  }
+      // unvisited cells are at least r cells away
+      if ((int)result.size() == k && result.front().first <= r * cell_size)
+	break;
+    }
+    std::sort_heap(result.begin(), result.end());
+  }
+
+ private:
+
+  void cell ( const float *p, int *c ) const {
+    for (int j = 0; j < 3; ++j)
+      c[j] = (int)std::min((unsigned long long)((p[j] - origin[j]) / cell_size), grid_size - 1);
+  }
+
+  static unsigned long long key ( unsigned long long x, unsigned long long y, unsigned long long z ) {
+    return (x << 42) | (y << 21) | z;
+  }
+
+  void visit ( unsigned long long cell_key, size_t i, const float *q, int k,
+	       std::vector< std::pair<float, size_t> > &result ) const {
+    std::vector< std::pair<unsigned long long, size_t> >::const_iterator it =
+      std::lower_bound(keys.begin(), keys.end(), std::make_pair(cell_key, (size_t)0));
+    for (; it != keys.end() && it->first == cell_key; ++it) {
+      size_t j = it->second;
+      if (j == i)
+	continue;
+      const float *p = &store.position[3*j];
+      float d = sqrtf((p[0]-q[0])*(p[0]-q[0]) + (p[1]-q[1])*(p[1]-q[1]) + (p[2]-q[2])*(p[2]-q[2]));
+      if ((int)result.size() < k) {
+	result.push_back(std::make_pair(d, j));
+	std::push_heap(result.begin(), result.end());
+      }
+      else if (d < result.front().first) {
+	std::pop_heap(result.begin(), result.end());
+	result.back() = std::make_pair(d, j);
+	std::push_heap(result.begin(), result.end());
+      }
+    }
+  }
+
+  const SurfelStore &store;
+  float origin[3];
+  float cell_size;
+  std::vector< std::pair<unsigned long long, size_t> > keys;
+};
+
+/**
+ * Computes the k nearest neighbors of all surfels.
+ * @param store Surfels.
+ * @param k Number of neighbors.
+ * @param neighbors k entries per surfel, closest first, no_neighbor where missing.
+ * @param distances Distances to the neighbors, FLT_MAX where missing.
+ **/
+void SurfelPreprocessor::findNeighbors ( const SurfelStore &store, int k, std::vector<size_t> &neighbors,
+					 std::vector<float> &distances ) {
+
+  const long n = store.size();
+  neighbors.assign((size_t)n * k, no_neighbor);
+  distances.assign((size_t)n * k, FLT_MAX);
+
+  NeighborGrid grid (store);
+
+#pragma omp parallel
+  {
+    std::vector< std::pair<float, size_t> > result;
+#pragma omp for schedule(dynamic, 4096)
+    for (long i = 0; i < n; ++i) {
+      grid.query(i, k, result);
+      for (unsigned int j = 0; j < result.size(); ++j) {
+	distances[(size_t)i*k + j] = result[j].first;
+	neighbors[(size_t)i*k + j] = result[j].second;
+      }
+    }
+  }
+}
+
+/**
+ * Statistical outlier removal.
+ * @param store Surfels, filtered in place.
+ * @param k Number of neighbors averaged.
+ * @param std_ratio Allowed standard deviations above the mean distance.
+ * @return Number of removed surfels.
+ **/
+size_t SurfelPreprocessor::removeOutliers ( SurfelStore &store, int k, float std_ratio ) {
+
+  const long n = store.size();
+  if (n <= k)
+    return 0;
+
+  std::vector<size_t> neighbors;
+  std::vector<float> distances;
+  findNeighbors(store, k, neighbors, distances);
+  std::vector<size_t>().swap(neighbors);
+
+  // mean neighbor distance of every surfel, FLT_MAX if it is isolated
+  std::vector<float> mean (n);
+  double sum = 0.0, sum2 = 0.0;
+  long valid = 0;
+#pragma omp parallel for reduction(+:sum,sum2,valid)
+  for (long i = 0; i < n; ++i) {
+    const float *d = &distances[(size_t)i*k];
+    if (d[k-1] == FLT_MAX) {
+      mean[i] = FLT_MAX;
+      continue;
+    }
+    double m = 0.0;
+    for (int j = 0; j < k; ++j)
+      m += d[j];
+    m /= k;
+    mean[i] = m;
+    sum += m;
+    sum2 += m*m;
+    ++valid;
+  }
+  std::vector<float>().swap(distances);
+
+  double average = valid > 0 ? sum / valid : 0.0;
+  double deviation = valid > 0 ? sqrt(std::max(sum2 / valid - average * average, 0.0)) : 0.0;
+  float threshold = average + std_ratio * deviation;
+
+  std::vector<unsigned char> keep (n);
+  size_t removed = 0;
+#pragma omp parallel for reduction(+:removed)
+  for (long i = 0; i < n; ++i) {
+    keep[i] = mean[i] <= threshold;
+    removed += !keep[i];
+  }
+
+  if (removed > 0)
+    store.filter(keep);
+  return removed;
+}
+
+/**
+ * Consistent normal orientation over the kNN graph.
+ * @param store Surfels, normals flipped in place.
+ * @param k Number of neighbors in the graph.
+ * @return Number of flipped normals.
+ **/
+size_t SurfelPreprocessor::orientNormals ( SurfelStore &store, int k ) {
+
+  const size_t n = store.size();
+  if (n == 0)
+    return 0;
+
+  std::vector<size_t> neighbors;
+  std::vector<float> distances;
+  findNeighbors(store, k, neighbors, distances);
+  std::vector<float>().swap(distances);
+
+  // seeds from the top down
+  std::vector< std::pair<float, size_t> > heights (n);
+  for (size_t i = 0; i < n; ++i)
+    heights[i] = std::make_pair(-store.position[3*i+2], i);
+  std::sort(heights.begin(), heights.end());
+
+  std::vector<unsigned char> visited (n, 0);
+  size_t flipped = 0;
+
+  // (cost, (surfel, oriented neighbor it was reached from))
+  typedef std::pair<float, std::pair<size_t, size_t> > Edge;
+  std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge> > front;
+
+  for (size_t s = 0; s < n; ++s) {
+    size_t seed = heights[s].second;
+    if (visited[seed])
+      continue;
+
+    float *normal = &store.normal[3*seed];
+    if (normal[2] < 0.0f) {
+      for (int j = 0; j < 3; ++j)
+	normal[j] = -normal[j];
+      ++flipped;
+    }
+    front.push(Edge(0.0f, std::make_pair(seed, seed)));
+
+    while (!front.empty()) {
+      size_t i = front.top().second.first, from = front.top().second.second;
+      front.pop();
+      if (visited[i])
+	continue;
+      visited[i] = 1;
+
+      float *ni = &store.normal[3*i];
+      const float *nf = &store.normal[3*from];
+      if (ni[0]*nf[0] + ni[1]*nf[1] + ni[2]*nf[2] < 0.0f) {
+	for (int j = 0; j < 3; ++j)
+	  ni[j] = -ni[j];
+	++flipped;
+      }
+
+      for (int j = 0; j < k; ++j) {
+	size_t m = neighbors[i*k + j];
+	if (m == no_neighbor || visited[m])
+	  continue;
+	const float *nm = &store.normal[3*m];
+	float cost = 1.0f - fabsf(ni[0]*nm[0] + ni[1]*nm[1] + ni[2]*nm[2]);
+	front.push(Edge(cost, std::make_pair(m, i)));
+      }
+    }
+  }
+
+  return flipped;
+}
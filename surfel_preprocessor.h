@@ -0,0 +1,46 @@
+/*
+** surfel_preprocessor.h Cleaning of raw scans header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SURFEL_PREPROCESSOR_H__
+#define __SURFEL_PREPROCESSOR_H__
+
+#include <vector>
+
+#include "surfel_store.h"
+
+/**
+ * Preprocessing of raw scans, run at load or before writing a cache.
+ *
+ * Both steps work on the k nearest neighbors of every surfel, found in
+ * parallel through a sorted grid of the centers.
+ *
+ * Outlier removal is statistical: surfels whose mean distance to their
+ * neighbors is more than std_ratio standard deviations above the mean
+ * of all surfels are removed, as are surfels with fewer than k
+ * neighbors nearby.
+ *
+ * Normal orientation propagates from one surfel to its neighbors along
+ * a minimum spanning tree of the kNN graph, weighted by 1 - |ni . nj|,
+ * so that flips cross the flattest regions first (Hoppe et al. 92).
+ * Every connected part is seeded at its highest surfel, oriented up.
+ **/
+class SurfelPreprocessor
+{
+ public:
+
+  static size_t removeOutliers ( SurfelStore &store, int k = 16, float std_ratio = 2.0f );
+
+  static size_t orientNormals ( SurfelStore &store, int k = 8 );
+
+ private:
+
+  static void findNeighbors ( const SurfelStore &store, int k, std::vector<size_t> &neighbors,
+			      std::vector<float> &distances );
+};
+
+#endif
@@ -0,0 +1,284 @@
+/*
+** surfel_quantizer.cc Surfel clustering and quantization.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "surfel_quantizer.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <algorithm>
+
+/**
+ * Spreads the lower 21 bits of v so that there are two zero bits between each.
+ **/
+static inline unsigned long long spreadBits ( unsigned long long v ) {
+  v &= 0x1fffffULL;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+/**
+ * Gathers the elements of an array with c components per surfel in the given order.
+ **/
+template <class T> static void permute ( std::vector<T> &v, const std::vector<unsigned int> &order, int c ) {
+  if (v.empty())
+    return;
+  std::vector<T> sorted (v.size());
+#pragma omp parallel for
+  for (long i = 0; i < (long)order.size(); ++i)
+    for (int k = 0; k < c; ++k)
+      sorted[c*i + k] = v[c*(size_t)order[i] + k];
+  v.swap(sorted);
+}
+
+/**
+ * Reorders the store along a Morton curve over the given box.
+ * @param store Surfels to be reordered.
+ * @param box Bounding box of the surfels.
+ **/
+void SurfelQuantizer::sortSpatially ( SurfelStore &store, const Box3f &box ) {
+
+  const size_t n = store.size();
+  std::vector<std::pair<unsigned long long, unsigned int> > codes (n);
+
+  float extent = std::max(std::max(box.max[0] - box.min[0], box.max[1] - box.min[1]), box.max[2] - box.min[2]);
+  float scale = extent > 0.0f ? 2097151.0f / extent : 0.0f;
+
+#pragma omp parallel for
+  for (long i = 0; i < (long)n; ++i) {
+    unsigned long long code = 0;
+    for (int k = 0; k < 3; ++k) {
+      float q = (store.position[3*i + k] - box.min[k]) * scale;
+      code |= spreadBits((unsigned long long)std::min(std::max(q, 0.0f), 2097151.0f)) << k;
+    }
+    codes[i] = std::make_pair(code, (unsigned int)i);
+  }
+
+  std::sort(codes.begin(), codes.end());
+
+  std::vector<unsigned int> order (n);
+  for (size_t i = 0; i < n; ++i)
+    order[i] = codes[i].second;
+  std::vector<std::pair<unsigned long long, unsigned int> >().swap(codes);
+
+  permute(store.position, order, 3);
+  permute(store.normal, order, 3);
+  permute(store.radius, order, 1);
+  permute(store.color, order, 4);
+  permute(store.major_axis, order, 4);
+  permute(store.minor_axis, order, 4);
+  permute(store.error, order, 2);
+}
+
+/**
+ * Shuffles the surfels inside every cluster, with a fixed seed so that
+ * the order is the same for every run.
+ **/
+void SurfelQuantizer::shuffleClusters ( SurfelStore &store, const std::vector<SurfelCluster> &clusters ) {
+
+  std::vector<unsigned int> order (store.size());
+
+#pragma omp parallel for schedule(dynamic)
+  for (long c = 0; c < (long)clusters.size(); ++c) {
+    const SurfelCluster &cluster = clusters[c];
+    // Fisher-Yates with a linear congruential generator seeded per cluster
+    unsigned long long state = 0x9e3779b97f4a7c15ULL * (c + 1);
+    for (size_t i = 0; i < cluster.count; ++i)
+      order[cluster.first + i] = cluster.first + i;
+    for (size_t i = cluster.count; i > 1; --i) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      size_t j = (size_t)((state >> 33) % i);
+      std::swap(order[cluster.first + i - 1], order[cluster.first + j]);
+    }
+  }
+
+  permute(store.position, order, 3);
+  permute(store.normal, order, 3);
+  permute(store.radius, order, 1);
+  permute(store.color, order, 4);
+  permute(store.major_axis, order, 4);
+  permute(store.minor_axis, order, 4);
+  permute(store.error, order, 2);
+}
+
+/**
+ * Adds a range of sorted surfels as a cluster, halving it while it is too
+ * large or while its quantization step is coarser than allowed.
+ **/
+void SurfelQuantizer::splitCluster ( const SurfelStore &store, size_t first, size_t count, float max_step,
+				     std::vector<SurfelCluster> &clusters ) {
+
+  float x0 = FLT_MAX, y0 = FLT_MAX, z0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX, z1 = -FLT_MAX;
+  const float *p = &store.position[3*first];
+
+#pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1) if (count > 262144)
+  for (long i = 0; i < (long)count; ++i) {
+    x0 = std::min(x0, p[3*i]);  x1 = std::max(x1, p[3*i]);
+    y0 = std::min(y0, p[3*i+1]); y1 = std::max(y1, p[3*i+1]);
+    z0 = std::min(z0, p[3*i+2]); z1 = std::max(z1, p[3*i+2]);
+  }
+
+  float extent = std::max(std::max(x1 - x0, y1 - y0), z1 - z0);
+  if (count > max_cluster_size || (extent / 65535.0f > max_step && count > min_cluster_size)) {
+    size_t half = count / 2;
+    splitCluster(store, first, half, max_step, clusters);
+    splitCluster(store, first + half, count - half, max_step, clusters);
+    return;
+  }
+
+  SurfelCluster c;
+  c.first = first;
+  c.count = count;
+  c.box_min[0] = x0; c.box_min[1] = y0; c.box_min[2] = z0;
+  c.box_max[0] = x1; c.box_max[1] = y1; c.box_max[2] = z1;
+  for (int k = 0; k < 3; ++k) {
+    c.origin[k] = c.box_min[k];
+    c.step[k] = std::max((c.box_max[k] - c.box_min[k]) / 65535.0f, FLT_MIN);
+  }
+
+  float r0 = FLT_MAX, r1 = 0.0f;
+  for (size_t i = first; i < first + count; ++i) {
+    float r = std::max(store.radius[i], FLT_MIN);
+    r0 = std::min(r0, r);
+    r1 = std::max(r1, r);
+  }
+  c.log_radius_min = log2f(r0);
+  c.log_radius_step = (log2f(r1) - c.log_radius_min) / 255.0f;
+  c.max_radius = r1;
+
+  clusters.push_back(c);
+}
+
+/**
+ * Sorts the store spatially and splits it in clusters.
+ * Clusters hold at most max_cluster_size surfels and are made smaller (down
+ * to min_cluster_size) until their 16 bit quantization step is below
+ * tolerance times the diagonal of the full bounding box.
+ * Finally the surfels of each cluster are shuffled, so that drawing the
+ * same fraction of every cluster gives a stratified subset of the store.
+ * @param store Surfels, reordered in place.
+ * @param full_box Bounding box of the whole scene.
+ * @param tolerance Quantization step relative to the scene diagonal.
+ * @param clusters Resulting clusters, covering the whole store in order.
+ **/
+void SurfelQuantizer::buildClusters ( SurfelStore &store, const Box3f &full_box, float tolerance,
+				      std::vector<SurfelCluster> &clusters ) {
+  clusters.clear();
+  if (store.size() == 0)
+    return;
+
+  Box3f box;
+  for (size_t i = 0; i < store.size(); ++i)
+    box.Add(Point3f(store.position[3*i], store.position[3*i+1], store.position[3*i+2]));
+
+  sortSpatially(store, box);
+  splitCluster(store, 0, store.size(), tolerance * full_box.Diag(), clusters);
+  shuffleClusters(store, clusters);
+}
+
+/**
+ * Octahedral mapping of a unit normal to two bytes.
+ **/
+static inline void encodeNormal ( const float *n, GLubyte &u, GLubyte &v ) {
+  float l = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+  float x = l > 0.0f ? n[0] / l : 0.0f;
+  float y = l > 0.0f ? n[1] / l : 0.0f;
+  if (n[2] < 0.0f) {
+    float ox = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float oy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = ox;
+    y = oy;
+  }
+  u = (GLubyte)floorf((x * 0.5f + 0.5f) * 255.0f + 0.5f);
+  v = (GLubyte)floorf((y * 0.5f + 0.5f) * 255.0f + 0.5f);
+}
+
+/**
+ * Inverse of encodeNormal, as done in the projection vertex shaders.
+ **/
+static inline void decodeNormal ( GLubyte u, GLubyte v, float *n ) {
+  float x = u / 255.0f * 2.0f - 1.0f;
+  float y = v / 255.0f * 2.0f - 1.0f;
+  float z = 1.0f - fabsf(x) - fabsf(y);
+  if (z < 0.0f) {
+    float ox = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float oy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = ox;
+    y = oy;
+  }
+  float l = sqrtf(x*x + y*y + z*z);
+  n[0] = x / l; n[1] = y / l; n[2] = z / l;
+}
+
+/**
+ * Encodes the store in the compact format and measures the error.
+ * @param store Surfels, ordered as the clusters.
+ * @param clusters Clusters built by buildClusters.
+ * @param quantized Resulting compact surfels.
+ **/
+void SurfelQuantizer::quantize ( const SurfelStore &store, const std::vector<SurfelCluster> &clusters,
+				 QuantizedSurfels &quantized ) {
+
+  const size_t n = store.size();
+  quantized.position.resize(4*n);
+  quantized.attributes.resize(4*n);
+  quantized.clusters = clusters;
+
+  float position_error = 0.0f, normal_error = 0.0f, radius_error = 0.0f, color_error = 0.0f;
+
+#pragma omp parallel for schedule(dynamic) reduction(max:position_error,normal_error,radius_error,color_error)
+  for (long c = 0; c < (long)clusters.size(); ++c) {
+    const SurfelCluster &cluster = clusters[c];
+    for (size_t i = cluster.first; i < cluster.first + cluster.count; ++i) {
+
+      for (int k = 0; k < 3; ++k) {
+	float q = floorf((store.position[3*i+k] - cluster.origin[k]) / cluster.step[k] + 0.5f);
+	q = std::min(std::max(q, 0.0f), 65535.0f);
+	quantized.position[4*i+k] = (GLshort)((int)q - 32768);
+	position_error = std::max(position_error, fabsf(cluster.origin[k] + q * cluster.step[k] - store.position[3*i+k]));
+      }
+
+      GLubyte u, v;
+      float decoded[3];
+      const float *normal = &store.normal[3*i];
+      encodeNormal(normal, u, v);
+      quantized.position[4*i+3] = (GLshort)((int)(u * 256 + v) - 32768);
+      decodeNormal(u, v, decoded);
+      float length = sqrtf(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+      if (length > 0.0f) {
+	float d = (decoded[0]*normal[0] + decoded[1]*normal[1] + decoded[2]*normal[2]) / length;
+	normal_error = std::max(normal_error, acosf(std::min(d, 1.0f)) * 180.0f / (float)M_PI);
+      }
+
+      const GLubyte *color = &store.color[4*i];
+      int r = (color[0] * 31 + 127) / 255, g = (color[1] * 63 + 127) / 255, b = (color[2] * 31 + 127) / 255;
+      int rgb565 = (r << 11) | (g << 5) | b;
+      quantized.attributes[4*i] = (GLubyte)(rgb565 >> 8);
+      quantized.attributes[4*i+1] = (GLubyte)(rgb565 & 0xff);
+      color_error = std::max(color_error, (float)std::max(abs(r * 255 / 31 - color[0]),
+							  std::max(abs(g * 255 / 63 - color[1]), abs(b * 255 / 31 - color[2]))));
+
+      float radius = std::max(store.radius[i], FLT_MIN);
+      float q = cluster.log_radius_step > 0.0f ?
+	floorf((log2f(radius) - cluster.log_radius_min) / cluster.log_radius_step + 0.5f) : 0.0f;
+      q = std::min(std::max(q, 0.0f), 255.0f);
+      quantized.attributes[4*i+2] = (GLubyte)q;
+      quantized.attributes[4*i+3] = 0;
+      float decoded_radius = exp2f(cluster.log_radius_min + q * cluster.log_radius_step);
+      radius_error = std::max(radius_error, fabsf(decoded_radius - radius) / radius);
+    }
+  }
+
+  quantized.max_position_error = position_error;
+  quantized.max_normal_error = normal_error;
+  quantized.max_radius_error = radius_error;
+  quantized.max_color_error = color_error;
+}
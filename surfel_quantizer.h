@@ -0,0 +1,92 @@
+/*
+** surfel_quantizer.h Surfel clustering and quantization header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SURFEL_QUANTIZER_H__
+#define __SURFEL_QUANTIZER_H__
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <vcg/space/box3.h>
+
+#include "surfel_store.h"
+
+/**
+ * Range of spatially coherent surfels of a store.
+ * The quantization grid of the range is origin + q * step (q in 0..65535)
+ * and radii are 2^(log_radius_min + q * log_radius_step) (q in 0..255).
+ * The box bounds the surfel centers, max_radius is the largest radius.
+ * Surfels are in random order inside the range, so any prefix of it
+ * is a uniform sample of the cluster.
+ **/
+struct SurfelCluster
+{
+  size_t first;
+  size_t count;
+
+  float box_min[3];
+  float box_max[3];
+
+  float origin[3];
+  float step[3];
+  float log_radius_min;
+  float log_radius_step;
+
+  float max_radius;
+};
+
+/**
+ * Compressed surfels, 12 bytes each.
+ * position holds x, y, z quantized to 16 bits relative to the cluster box
+ * (stored signed, offset by 32768) and the octahedral normal with 8 bits per
+ * coordinate packed in the fourth short.
+ * attributes holds the RGB565 color (high and low byte), the log scale radius
+ * and one unused byte.
+ **/
+struct QuantizedSurfels
+{
+  std::vector<GLshort> position;
+  std::vector<GLubyte> attributes;
+  std::vector<SurfelCluster> clusters;
+
+  /// Largest errors introduced by the quantization.
+  float max_position_error;
+  float max_normal_error;
+  float max_radius_error;
+  float max_color_error;
+
+  size_t size ( void ) const { return attributes.size() / 4; }
+};
+
+/**
+ * Splits a store into spatially coherent clusters and encodes it
+ * in the compact format decoded by the projection vertex shaders.
+ **/
+class SurfelQuantizer
+{
+ public:
+
+  static void buildClusters ( SurfelStore &store, const Box3f &full_box, float tolerance,
+			      std::vector<SurfelCluster> &clusters );
+
+  static void quantize ( const SurfelStore &store, const std::vector<SurfelCluster> &clusters,
+			 QuantizedSurfels &quantized );
+
+  /// Largest and smallest number of surfels in a cluster.
+  static const size_t max_cluster_size = 65536;
+  static const size_t min_cluster_size = 1024;
+
+ private:
+
+  static void sortSpatially ( SurfelStore &store, const Box3f &box );
+  static void shuffleClusters ( SurfelStore &store, const std::vector<SurfelCluster> &clusters );
+  static void splitCluster ( const SurfelStore &store, size_t first, size_t count, float max_step,
+			     std::vector<SurfelCluster> &clusters );
+};
+
+#endif
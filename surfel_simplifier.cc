@@ -0,0 +1,284 @@
+/*
+** surfel_simplifier.cc Surfel simplification.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "surfel_simplifier.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+/// Cells per axis of the clustering grid, to fit three indices in a key.
+static const unsigned long long grid_size = 1ULL << 21;
+
+static inline float dot3 ( const float *a, const float *b ) {
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static inline void cross3 ( const float *a, const float *b, float *c ) {
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static inline void normalize3 ( float *a ) {
+  float l = sqrtf(dot3(a, a));
+  if (l > 0.0f)
+    for (int k = 0; k < 3; ++k)
+      a[k] /= l;
+}
+
+/**
+ * Predicate of the surfels facing the same side as a reference normal.
+ **/
+struct FacingSide {
+  FacingSide ( const SurfelStore &s, const float *r ) : store(s), reference(r) {}
+  bool operator() ( size_t i ) const { return dot3(&store.normal[3*i], reference) >= 0.0f; }
+  const SurfelStore &store;
+  const float *reference;
+};
+
+/**
+ * Area of a surfel, up to a constant factor.
+ **/
+static inline double surfelArea ( const SurfelStore &store, size_t i ) {
+  if (store.has(SurfelStore::AXES))
+    return (double)store.major_axis[4*i+3] * store.minor_axis[4*i+3];
+  return (double)store.radius[i] * store.radius[i];
+}
+
+/**
+ * Half length of the projection of a surfel onto a direction.
+ * @param e Unit direction.
+ **/
+static inline float surfelExtent ( const SurfelStore &store, size_t i, const float *e ) {
+  if (store.has(SurfelStore::AXES)) {
+    float major[3] = {store.major_axis[4*i], store.major_axis[4*i+1], store.major_axis[4*i+2]};
+    float minor[3] = {store.minor_axis[4*i], store.minor_axis[4*i+1], store.minor_axis[4*i+2]};
+    normalize3(major);
+    normalize3(minor);
+    float a = store.major_axis[4*i+3] * dot3(major, e);
+    float b = store.minor_axis[4*i+3] * dot3(minor, e);
+    return sqrtf(a*a + b*b);
+  }
+  float d = dot3(&store.normal[3*i], e);
+  return store.radius[i] * sqrtf(std::max(1.0f - d*d, 0.0f));
+}
+
+/**
+ * Merges a group of surfels into one elliptical surfel.
+ * @param store Source surfels.
+ * @param members Indices of the group in the store.
+ * @param n Number of members.
+ * @param simplified Destination store, with AXES and ERRORS.
+ * @param out Index of the merged surfel in the destination.
+ **/
+void SurfelSimplifier::merge ( const SurfelStore &store, const size_t *members, size_t n,
+			       SurfelStore &simplified, size_t out ) {
+
+  // area weighted center, normal and color
+  double weight = 0.0, center[3] = {0.0, 0.0, 0.0}, normal[3] = {0.0, 0.0, 0.0}, color[4] = {0.0, 0.0, 0.0, 0.0};
+  for (size_t j = 0; j < n; ++j) {
+    size_t i = members[j];
+    double w = std::max(surfelArea(store, i), 1.0e-30);
+    weight += w;
+    for (int k = 0; k < 3; ++k) {
+      center[k] += w * store.position[3*i+k];
+      normal[k] += w * store.normal[3*i+k];
+    }
+    for (int k = 0; k < 4; ++k)
+      color[k] += w * store.color[4*i+k];
+  }
+
+  float c[3], nm[3];
+  for (int k = 0; k < 3; ++k) {
+    c[k] = center[k] / weight;
+    nm[k] = normal[k];
+  }
+  normalize3(nm);
+  if (dot3(nm, nm) == 0.0f)
+    for (int k = 0; k < 3; ++k)
+      nm[k] = store.normal[3*members[0]+k];
+
+  // tangent frame
+  float t1[3], t2[3];
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  axis[fabsf(nm[0]) < 0.9f ? 0 : 1] = 1.0f;
+  cross3(nm, axis, t1);
+  normalize3(t1);
+  cross3(nm, t1, t2);
+
+  // principal directions of the member centers in the tangent plane
+  double sxx = 0.0, sxy = 0.0, syy = 0.0;
+  for (size_t j = 0; j < n; ++j) {
+    size_t i = members[j];
+    float d[3] = {store.position[3*i] - c[0], store.position[3*i+1] - c[1], store.position[3*i+2] - c[2]};
+    double w = std::max(surfelArea(store, i), 1.0e-30);
+    double u = dot3(d, t1), v = dot3(d, t2);
+    sxx += w*u*u; sxy += w*u*v; syy += w*v*v;
+  }
+  float angle = 0.5f * atan2f(2.0f * sxy, sxx - syy);
+  float e1[3], e2[3];
+  for (int k = 0; k < 3; ++k)
+    e1[k] = cosf(angle) * t1[k] + sinf(angle) * t2[k];
+  cross3(nm, e1, e2);
+
+  // half sizes of the rectangle bounding the members, error bounds along the normal
+  float a = 0.0f, b = 0.0f, high = -FLT_MAX, low = FLT_MAX;
+  for (size_t j = 0; j < n; ++j) {
+    size_t i = members[j];
+    float d[3] = {store.position[3*i] - c[0], store.position[3*i+1] - c[1], store.position[3*i+2] - c[2]};
+    a = std::max(a, fabsf(dot3(d, e1)) + surfelExtent(store, i, e1));
+    b = std::max(b, fabsf(dot3(d, e2)) + surfelExtent(store, i, e2));
+
+    float offset = dot3(d, nm);
+    float tilt = surfelExtent(store, i, nm);
+    float max_error = store.has(SurfelStore::ERRORS) ? store.error[2*i] : 0.0f;
+    float min_error = store.has(SurfelStore::ERRORS) ? store.error[2*i+1] : 0.0f;
+    high = std::max(high, offset + tilt + max_error);
+    low = std::min(low, offset - tilt + min_error);
+  }
+
+  // grow the ellipse inscribed in the rectangle until it holds the corners of
+  // every member's own bounding rectangle, (u/a)^2 + (v/b)^2 <= 1, at most by sqrt(2)
+  a = std::max(a, FLT_MIN);
+  b = std::max(b, FLT_MIN);
+  float grow = 0.0f;
+  for (size_t j = 0; j < n; ++j) {
+    size_t i = members[j];
+    float d[3] = {store.position[3*i] - c[0], store.position[3*i+1] - c[1], store.position[3*i+2] - c[2]};
+    float u = (fabsf(dot3(d, e1)) + surfelExtent(store, i, e1)) / a;
+    float v = (fabsf(dot3(d, e2)) + surfelExtent(store, i, e2)) / b;
+    grow = std::max(grow, u*u + v*v);
+  }
+  grow = sqrtf(std::max(grow, 1.0f));
+  a *= grow;
+  b *= grow;
+
+  if (b > a) {
+    std::swap(a, b);
+    for (int k = 0; k < 3; ++k)
+      std::swap(e1[k], e2[k]);
+  }
+
+  for (int k = 0; k < 3; ++k) {
+    simplified.position[3*out+k] = c[k];
+    simplified.normal[3*out+k] = nm[k];
+    simplified.major_axis[4*out+k] = e1[k];
+    simplified.minor_axis[4*out+k] = e2[k];
+  }
+  for (int k = 0; k < 4; ++k)
+    simplified.color[4*out+k] = (unsigned char)floor(color[k] / weight + 0.5);
+  simplified.radius[out] = a;
+  simplified.major_axis[4*out+3] = a;
+  simplified.minor_axis[4*out+3] = b;
+  simplified.error[2*out] = high;
+  simplified.error[2*out+1] = low;
+}
+
+/**
+ * Merges the surfels of every grid cell, one surfel per cell and orientation.
+ * @param store Surfels to be simplified.
+ * @param cell_size Edge of the grid cells.
+ * @param simplified Resulting elliptical surfels with error bounds.
+ **/
+void SurfelSimplifier::simplify ( const SurfelStore &store, float cell_size, SurfelStore &simplified ) {
+
+  const int attributes = SurfelStore::NORMAL | SurfelStore::COLOR | SurfelStore::RADIUS |
+    SurfelStore::AXES | SurfelStore::ERRORS;
+
+  const long n = store.size();
+  if (n == 0 || cell_size <= 0.0f) {
+    simplified.resize(0, attributes);
+    return;
+  }
+
+  const float *p = &store.position[0];
+  float x0 = FLT_MAX, y0 = FLT_MAX, z0 = FLT_MAX;
+#pragma omp parallel for reduction(min:x0,y0,z0)
+  for (long i = 0; i < n; ++i) {
+    x0 = std::min(x0, p[3*i]);
+    y0 = std::min(y0, p[3*i+1]);
+    z0 = std::min(z0, p[3*i+2]);
+  }
+
+  // sort the surfels by cell
+  std::vector< std::pair<unsigned long long, size_t> > keys (n);
+#pragma omp parallel for
+  for (long i = 0; i < n; ++i) {
+    unsigned long long ix = std::min((unsigned long long)((p[3*i] - x0) / cell_size), grid_size - 1);
+    unsigned long long iy = std::min((unsigned long long)((p[3*i+1] - y0) / cell_size), grid_size - 1);
+    unsigned long long iz = std::min((unsigned long long)((p[3*i+2] - z0) / cell_size), grid_size - 1);
+    keys[i] = std::make_pair((ix << 42) | (iy << 21) | iz, (size_t)i);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<size_t> order (n), cells;
+  for (long i = 0; i < n; ++i) {
+    order[i] = keys[i].second;
+    if (i == 0 || keys[i].first != keys[i-1].first)
+      cells.push_back(i);
+  }
+  cells.push_back(n);
+  std::vector< std::pair<unsigned long long, size_t> >().swap(keys);
+
+  // split every cell by orientation, against its first surfel
+  const long cell_count = cells.size() - 1;
+  std::vector<size_t> split (cell_count), first (cell_count + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (long c = 0; c < cell_count; ++c) {
+    const float *reference = &store.normal[3*order[cells[c]]];
+    size_t *middle = std::partition(&order[0] + cells[c], &order[0] + cells[c+1],
+				    FacingSide(store, reference));
+    split[c] = middle - &order[0];
+  }
+  for (long c = 0; c < cell_count; ++c)
+    first[c+1] = first[c] + (split[c] < cells[c+1] ? 2 : 1);
+
+  simplified.resize(first[cell_count], attributes);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (long c = 0; c < cell_count; ++c) {
+    merge(store, &order[cells[c]], split[c] - cells[c], simplified, first[c]);
+    if (split[c] < cells[c+1])
+      merge(store, &order[split[c]], cells[c+1] - split[c], simplified, first[c] + 1);
+  }
+}
+
+/**
+ * Builds successively coarser levels, each one from the previous one
+ * with cells twice as large. The first cells are twice the mean radius.
+ * @param store Full resolution surfels.
+ * @param count Number of levels.
+ * @param levels Resulting levels, from fine to coarse.
+ **/
+void SurfelSimplifier::buildLevels ( const SurfelStore &store, int count, std::vector<SurfelStore> &levels ) {
+
+  levels.clear();
+  levels.resize(std::max(count, 0));
+
+  float cell_size = 2.0f * meanRadius(store);
+  for (int l = 0; l < count; ++l) {
+    simplify(l == 0 ? store : levels[l-1], cell_size, levels[l]);
+    cell_size *= 2.0f;
+  }
+}
+
+/**
+ * Mean surfel radius (major axis length for elliptical surfels).
+ **/
+float SurfelSimplifier::meanRadius ( const SurfelStore &store ) {
+
+  const long n = store.size();
+  if (n == 0)
+    return 0.0f;
+
+  double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+  for (long i = 0; i < n; ++i)
+    sum += store.radius[i];
+  return sum / n;
+}
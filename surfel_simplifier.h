@@ -0,0 +1,49 @@
+/*
+** surfel_simplifier.h Surfel simplification header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SURFEL_SIMPLIFIER_H__
+#define __SURFEL_SIMPLIFIER_H__
+
+#include <vector>
+
+#include "surfel_store.h"
+
+/**
+ * Builds coarser versions of a store by clustering surfels on a regular
+ * grid and merging every cluster into one elliptical surfel.
+ *
+ * The surfels of a cell are split in two groups by normal orientation,
+ * so that both sides of thin parts survive. A merged surfel is centered
+ * at the area weighted mean of its members, its axes follow the principal
+ * directions of the member centers in the tangent plane, and the axis
+ * lengths keep the aspect of the rectangle bounding the member extents,
+ * grown (by at most sqrt(2)) until the ellipse holds the bounding
+ * rectangle of every member, so that it covers its members.
+ *
+ * The error bounds (ERRORS) of a merged surfel are the highest and the
+ * lowest offset of its members along the merged normal, including their
+ * tilt and their own bounds, so they hold against the original surfels
+ * at every level.
+ **/
+class SurfelSimplifier
+{
+ public:
+
+  static void simplify ( const SurfelStore &store, float cell_size, SurfelStore &simplified );
+
+  static void buildLevels ( const SurfelStore &store, int count, std::vector<SurfelStore> &levels );
+
+  static float meanRadius ( const SurfelStore &store );
+
+ private:
+
+  static void merge ( const SurfelStore &store, const size_t *members, size_t n,
+		      SurfelStore &simplified, size_t out );
+};
+
+#endif
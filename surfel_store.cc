@@ -0,0 +1,122 @@
+/*
+** surfel_store.cc Structure of arrays storage for surfels.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+#include "surfel_store.h"
+
+/**
+ * Resizes all arrays for n surfels.
+ * Position, normal, radius and color are always allocated since they are
+ * needed for rendering, missing ones get the same defaults as the mesh loaders
+ * (alpha is opaque unless the source overwrites it).
+ * @param n Number of surfels.
+ * @param attributes Attributes present in the source (NORMAL, COLOR ...).
+ **/
+void SurfelStore::resize ( size_t n, int attributes ) {
+  count = n;
+  attribs = attributes;
+
+  position.resize(3*n);
+  normal.resize(3*n, 0.0f);
+  radius.resize(n, 0.25f);
+  color.resize(4*n, 0);
+  for (size_t i = 0; i < n; ++i)
+    color[4*i+3] = 255;
+
+  if (has(AXES)) {
+    major_axis.resize(4*n);
+    minor_axis.resize(4*n);
+  }
+  else {
+    major_axis.clear();
+    minor_axis.clear();
+  }
+
+  if (has(ERRORS))
+    error.resize(2*n);
+  else
+    error.clear();
+}
+
+/**
+ * Releases all arrays.
+ **/
+void SurfelStore::clear ( void ) {
+  std::vector<float>().swap(position);
+  std::vector<float>().swap(normal);
+  std::vector<float>().swap(radius);
+  std::vector<unsigned char>().swap(color);
+  std::vector<float>().swap(major_axis);
+  std::vector<float>().swap(minor_axis);
+  std::vector<float>().swap(error);
+  count = 0;
+  attribs = 0;
+}
+
+/**
+ * Converts the store to a surfel vector, appending to it.
+ * @param surfels Vector to be filled.
+ **/
+void SurfelStore::toSurfels ( std::vector<Surfel<double> > &surfels ) const {
+
+  surfels.reserve(surfels.size() + count);
+
+  for (size_t i = 0; i < count; ++i) {
+    Surfel<double> s (Point3f(position[3*i], position[3*i+1], position[3*i+2]),
+		      Point3f(normal[3*i], normal[3*i+1], normal[3*i+2]),
+		      Color4b(color[4*i], color[4*i+1], color[4*i+2], color[4*i+3]),
+		      radius[i], i);
+    if (has(AXES)) {
+      s.SetMajorAxis(std::make_pair((double)major_axis[4*i+3],
+				    Point3f(major_axis[4*i], major_axis[4*i+1], major_axis[4*i+2])));
+      s.SetMinorAxis(std::make_pair((double)minor_axis[4*i+3],
+				    Point3f(minor_axis[4*i], minor_axis[4*i+1], minor_axis[4*i+2])));
+    }
+    if (has(ERRORS)) {
+      s.SetMaxError(error[2*i]);
+      s.SetMinError(error[2*i+1]);
+    }
+    surfels.push_back(s);
+  }
+}
+
+/**
+ * Removes surfels in place, keeping the order of the others.
+ * @param keep Per surfel flags, surfels with a zero entry are removed.
+ **/
+void SurfelStore::filter ( const std::vector<unsigned char> &keep ) {
+
+  size_t j = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (!keep[i])
+      continue;
+    if (j != i) {
+      std::copy(&position[3*i], &position[3*i] + 3, &position[3*j]);
+      std::copy(&normal[3*i], &normal[3*i] + 3, &normal[3*j]);
+      radius[j] = radius[i];
+      std::copy(&color[4*i], &color[4*i] + 4, &color[4*j]);
+      if (has(AXES)) {
+	std::copy(&major_axis[4*i], &major_axis[4*i] + 4, &major_axis[4*j]);
+	std::copy(&minor_axis[4*i], &minor_axis[4*i] + 4, &minor_axis[4*j]);
+      }
+      if (has(ERRORS))
+	std::copy(&error[2*i], &error[2*i] + 2, &error[2*j]);
+    }
+    ++j;
+  }
+
+  count = j;
+  position.resize(3*j);
+  normal.resize(3*j);
+  radius.resize(j);
+  color.resize(4*j);
+  if (has(AXES)) {
+    major_axis.resize(4*j);
+    minor_axis.resize(4*j);
+  }
+  if (has(ERRORS))
+    error.resize(2*j);
+}
@@ -0,0 +1,108 @@
+/*
+** surfel_store.h Structure of arrays storage for surfels header.
+**
+**
+**   history:	created  19-Oct-26
+*/
+
+
+#ifndef __SURFEL_STORE_H__
+#define __SURFEL_STORE_H__
+
+#include "surfel.hpp"
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * Surfel attributes stored as one array per attribute,
+ * the layout used for decoding files and uploading to the GPU.
+ * Positions and normals are packed xyz, colors rgba,
+ * axes are direction xyz plus size.
+ **/
+class SurfelStore
+{
+ public:
+
+  /// Attributes present in the store besides position.
+  enum {
+    NORMAL = 0x01,
+    COLOR = 0x02,
+    RADIUS = 0x04,
+    AXES = 0x08,
+    ERRORS = 0x10
+  };
+
+  SurfelStore() : count(0), attribs(0) {}
+
+  void resize ( size_t n, int attributes );
+  void clear ( void );
+
+  size_t size ( void ) const { return count; }
+  int attributes ( void ) const { return attribs; }
+  bool has ( int a ) const { return (attribs & a) != 0; }
+
+  template <class Real>
+  void fromSurfels ( const std::vector<Surfel<Real> > &surfels, int attributes = NORMAL | COLOR | RADIUS,
+		     size_t first = 0, size_t n = size_t(-1) );
+  void toSurfels ( std::vector<Surfel<double> > &surfels ) const;
+
+  void filter ( const std::vector<unsigned char> &keep );
+
+  std::vector<float> position;
+  std::vector<float> normal;
+  std::vector<float> radius;
+  std::vector<unsigned char> color;
+  std::vector<float> major_axis;
+  std::vector<float> minor_axis;
+  std::vector<float> error;
+
+ private:
+
+  size_t count;
+  int attribs;
+};
+
+/**
+ * Fills the store from a surfel vector, or from a range of it.
+ * @param surfels Given surfels.
+ * @param attributes Attributes to be copied (AXES and ERRORS are optional).
+ * @param first First surfel of the range.
+ * @param n Number of surfels in the range, clamped to the vector size.
+ **/
+template <class Real>
+void SurfelStore::fromSurfels ( const std::vector<Surfel<Real> > &surfels, int attributes,
+				size_t first, size_t n ) {
+
+  first = std::min(first, surfels.size());
+  n = std::min(n, surfels.size() - first);
+  resize(n, attributes);
+
+#pragma omp parallel for
+  for (long i = 0; i < (long)n; ++i) {
+    const Surfel<Real> &s = surfels[first + i];
+    for (int k = 0; k < 3; ++k) {
+      position[3*i+k] = s.Center()[k];
+      normal[3*i+k] = s.Normal()[k];
+    }
+    radius[i] = s.Radius();
+    Color4b c = s.Color();
+    for (int k = 0; k < 4; ++k)
+      color[4*i+k] = c[k];
+    if (has(AXES)) {
+      std::pair<Real, Point3f> major = s.MajorAxis(), minor = s.MinorAxis();
+      for (int k = 0; k < 3; ++k) {
+	major_axis[4*i+k] = major.second[k];
+	minor_axis[4*i+k] = minor.second[k];
+      }
+      major_axis[4*i+3] = major.first;
+      minor_axis[4*i+3] = minor.first;
+    }
+    if (has(ERRORS)) {
+      error[2*i] = s.MaxError();
+      error[2*i+1] = s.MinError();
+    }
+  }
+}
+
+#endif